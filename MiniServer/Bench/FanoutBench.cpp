@@ -0,0 +1,95 @@
+#include <iostream>
+#include <string>
+#include "Server.hpp"
+#include "MemoryTransport.hpp"
+
+// Simulated clients connected through MemoryTransport, each sending a PlayerUpdate every tick, with the server
+// relaying them on to everyone else within their budgets. Nothing touches the kernel and the ticks run on a made up
+// clock as fast as they'll go, so this is the server's receive-tick-fan-out path and nothing else, and the traffic
+// counts come out the same every run.
+// Usage: FanoutBench [clients] [seconds of play] [update bytes per second per client] [trace json]
+// With a trace file every tick is traced (see Trace.hpp) and written out at the end, the ns per tick against an
+// untraced run is what tracing costs.
+// Built with MINISERVER_COUNT_ALLOCATIONS it's also the check that steady state ticks don't allocate, the server
+// aborts with a report of who did if one does after the first second.
+// Exits non-zero if a client never connected or anything was sent somewhere nobody is
+
+int main(int argc, char *argv[])
+{
+    const uint32_t clients = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 16;
+    const uint32_t seconds = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 600;
+    const uint64_t tickUs = 16000;
+    const uint64_t ticks = static_cast<uint64_t>(seconds) * 1000000 / tickUs;
+
+    boost::asio::io_service io_service;
+    ServerConfig config;
+    if (argc > 3)
+    {
+        config.updateBytesPerSecond = static_cast<uint32_t>(std::stoul(argv[3]));
+    }
+    const std::string tracePath = argc > 4 ? argv[4] : "";
+    if (!tracePath.empty())
+    {
+        Trace::Enable(true);
+    }
+    if (AllocationTracker::Enabled)
+    {
+        config.allocationFreeAfterTicks = static_cast<uint32_t>(1000000 / tickUs);
+    }
+    MemoryTransport transport(clients);
+    pServer server = MakeUnique<Server>(io_service, config, &transport);
+
+    for (uint32_t client = 0; client < clients; client++)
+    {
+        transport.Connect(client);
+    }
+    const uint64_t timeBase = MonotonicMicroseconds();
+    server->Tick(timeBase); // Takes the connections and where to send each client's datagrams
+    uint32_t connected = 0;
+    for (uint32_t client = 0; client < clients; client++)
+    {
+        connected += transport.GetClient(client).IsConnected() ? 1 : 0;
+    }
+
+    UDPMessage update;
+    memset(static_cast<void*>(&update), 0, sizeof(update));
+    update.type = UDPMessageType::PlayerUpdate;
+    update.data.playerUpdateData.sender = UDPMessageSender::Client;
+
+    uint64_t sent = 0;
+    const uint64_t start = MonotonicMicroseconds();
+    for (uint64_t tick = 1; tick <= ticks; tick++)
+    {
+        for (uint32_t client = 0; client < clients; client++)
+        {
+            const MemoryClient &memoryClient = transport.GetClient(client);
+            if (!memoryClient.IsConnected())
+            {
+                continue;
+            }
+            update.sequence = static_cast<uint16_t>(tick);
+            update.data.playerUpdateData.playerData.id = memoryClient.GetId();
+            update.data.playerUpdateData.playerData.transform.SetPosition(Vector3(static_cast<float>(tick % 1000), static_cast<float>(client * 10), 0.f));
+            sent += transport.SendDatagram(client, update) ? 1 : 0;
+        }
+        server->Tick(timeBase + tick * tickUs);
+    }
+    const uint64_t elapsed = MonotonicMicroseconds() - start;
+
+    const Server::ReceiveStats stats = server->GetReceiveStats();
+    std::cout << connected << " of " << clients << " clients connected, " << ticks << " ticks in " << elapsed << "us ("
+        << (elapsed > 0 ? ticks * 1000000 / elapsed : 0) << " ticks/s, " << (ticks > 0 ? elapsed * 1000 / ticks : 0) << "ns per tick)" << std::endl;
+    std::cout << "In: " << sent << " updates accepted, " << stats.dropped << " dropped" << std::endl;
+    std::cout << "Out: " << transport.GetDatagramsDelivered() << " datagrams, " << transport.GetBytesDelivered() << " bytes ("
+        << (elapsed > 0 ? transport.GetDatagramsDelivered() * 1000000 / elapsed : 0) << " datagrams/s), "
+        << transport.GetDatagramsLost() << " to unknown endpoints" << std::endl;
+    if (AllocationTracker::Enabled)
+    {
+        AllocationTracker::Report(std::cout);
+    }
+    if (!tracePath.empty())
+    {
+        std::cout << (Trace::WriteChromeJson(tracePath) ? "Trace written to " : "Error: couldn't write trace to ") << tracePath << std::endl;
+    }
+    return connected == clients && transport.GetDatagramsLost() == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+#include "Server.hpp"
+#include "HandlerAllocator.hpp"
+#include "Trace.hpp"
+
+// Operations started on one thread and completed on another, the way the tick's UDP sends are, with asio's own
+// handler allocation and then with each slot's HandlerMemory (see HandlerAllocator.hpp). post on its own is the
+// allocation and nothing else, async_send_to adds a sendto to a socket on loopback nobody reads.
+// Usage: HandlerBench [operations] [in flight]
+// Built with MINISERVER_COUNT_ALLOCATIONS it also counts the starting thread's heap allocations per operation
+
+static uint64_t CpuMicroseconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+enum class Operation
+{
+    Post,
+    UdpSend
+};
+
+// One operation in flight per slot at a time, like a UDPSendBuffer
+struct Slot
+{
+    std::atomic<bool> busy;
+    HandlerMemory handlerMemory;
+};
+
+struct Completion
+{
+    Slot *slot;
+
+    void operator()() { slot->busy.store(false, std::memory_order_release); }
+    void operator()(const boost::system::error_code&, std::size_t) { slot->busy.store(false, std::memory_order_release); }
+};
+
+static void Run(Operation operation, bool recycled, uint64_t count, uint32_t inFlight)
+{
+    boost::asio::io_service io_service;
+    UniquePtr<boost::asio::io_service::work> work = MakeUnique<boost::asio::io_service::work>(io_service);
+    udp::socket socket(io_service, udp::endpoint(udp::v4(), 0));
+    udp::socket sink(io_service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    const udp::endpoint to = sink.local_endpoint();
+    std::thread ioThread([&io_service]() { io_service.run(); });
+
+    std::vector<std::unique_ptr<Slot>> slots;
+    for (uint32_t i = 0; i < inFlight; i++)
+    {
+        slots.emplace_back(new Slot());
+        slots.back()->busy.store(false, std::memory_order_relaxed);
+    }
+    uint8_t datagram[WireSize<UDPMessage>::value] = {};
+
+    const uint64_t allocationsStart = HeapAllocationCount();
+    const uint64_t cpuStart = CpuMicroseconds();
+    const uint64_t ticksStart = TraceNow();
+    const uint64_t start = MonotonicMicroseconds();
+    for (uint64_t i = 0; i < count; i++)
+    {
+        Slot &slot = *slots[i % inFlight];
+        while (slot.busy.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+        slot.busy.store(true, std::memory_order_relaxed);
+        const Completion completion = { &slot };
+        if (operation == Operation::Post)
+        {
+            if (recycled)
+            {
+                io_service.post(MakeAllocatingHandler(slot.handlerMemory, completion));
+            }
+            else
+            {
+                io_service.post(completion);
+            }
+        }
+        else
+        {
+            if (recycled)
+            {
+                socket.async_send_to(boost::asio::buffer(datagram), to, MakeAllocatingHandler(slot.handlerMemory, completion));
+            }
+            else
+            {
+                socket.async_send_to(boost::asio::buffer(datagram), to, completion);
+            }
+        }
+    }
+    for (auto &slot : slots)
+    {
+        while (slot->busy.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+    }
+    const uint64_t elapsed = MonotonicMicroseconds() - start;
+    const uint64_t ticks = TraceNow() - ticksStart;
+    const uint64_t cpu = CpuMicroseconds() - cpuStart;
+    const uint64_t allocations = HeapAllocationCount() - allocationsStart;
+
+    work = nullptr;
+    ioThread.join();
+
+    std::cout << (operation == Operation::Post ? "post" : "async_send_to") << (recycled ? ", recycled: " : ", asio's: ")
+        << static_cast<double>(elapsed) * 1000.0 / count << "ns, " << static_cast<double>(ticks) / count << " cycles, "
+        << static_cast<double>(cpu) * 1000.0 / count << "ns cpu per operation";
+    if (AllocationTracker::Enabled)
+    {
+        std::cout << ", " << static_cast<double>(allocations) / count << " allocations";
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    const uint64_t count = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    const uint32_t inFlight = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 32;
+
+    Run(Operation::Post, false, count, inFlight);
+    Run(Operation::Post, true, count, inFlight);
+    Run(Operation::UdpSend, false, count / 4, inFlight);
+    Run(Operation::UdpSend, true, count / 4, inFlight);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <iostream>
+#include <vector>
+#include "ProtocolSchema.hpp"
+#include "PacketAggregator.hpp"
+#include "Clock.hpp"
+
+// Encode/decode throughput for UDPMessage through the generated serializers, against a plain memcpy, plus the
+// cost of batching a tick's worth of updates into datagrams.
+// Usage: ProtocolBench [iterations]
+// Exits non-zero if a round trip through the serializers doesn't give back what went in, or the two encode paths disagree
+
+static volatile uint64_t sink; // Keeps the optimiser from throwing the work away
+
+static void Report(const char *name, uint64_t count, uint64_t elapsedUs)
+{
+    std::cout << name << ": " << count << " in " << elapsedUs << "us ("
+        << (elapsedUs > 0 ? count * 1000000 / elapsedUs : 0) << "/s)" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    const uint64_t iterations = argc > 1 ? std::stoull(argv[1]) : 10000000;
+
+    UDPMessage msg;
+    memset(static_cast<void*>(&msg), 0, sizeof(msg));
+    msg.type = UDPMessageType::PlayerUpdate;
+    msg.sequence = 1;
+    msg.unixTimestamp = 1234567890;
+    msg.data.playerUpdateData.playerData.id = 3;
+    msg.data.playerUpdateData.playerData.transform.SetPosition(Vector3(1.f, 2.f, 3.f));
+    msg.data.playerUpdateData.sender = UDPMessageSender::Client;
+
+    uint8_t wire[WireSize<UDPMessage>::value];
+    UDPMessage decoded;
+
+    uint64_t start = MonotonicMicroseconds();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        msg.sequence = static_cast<uint16_t>(i);
+        memcpy(wire, &msg, sizeof(msg));
+        memcpy(static_cast<void*>(&decoded), wire, sizeof(decoded));
+        sink += decoded.sequence;
+    }
+    Report("memcpy round trip", iterations, MonotonicMicroseconds() - start);
+
+    start = MonotonicMicroseconds();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        msg.sequence = static_cast<uint16_t>(i);
+        WireEncode(msg, wire, sizeof(wire));
+        WireDecode(wire, sizeof(wire), decoded);
+        sink += decoded.sequence;
+    }
+    Report("WireEncode/WireDecode round trip", iterations, MonotonicMicroseconds() - start);
+
+    // What a big endian host would be running
+    start = MonotonicMicroseconds();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        msg.sequence = static_cast<uint16_t>(i);
+        WireCodec<UDPMessage>::Encode(msg, wire);
+        WireCodec<UDPMessage>::Decode(wire, decoded);
+        sink += decoded.sequence;
+    }
+    Report("Field by field round trip", iterations, MonotonicMicroseconds() - start);
+
+    // The same bytes back out of what came in, so padding doesn't matter
+    uint8_t again[WireSize<UDPMessage>::value];
+    WireEncode(msg, wire, sizeof(wire));
+    const bool decodedAll = WireDecode(wire, sizeof(wire), decoded);
+    WireEncode(decoded, again, sizeof(again));
+    if (!decodedAll || memcmp(wire, again, sizeof(wire)) != 0)
+    {
+        std::cout << "Error: UDPMessage didn't survive a round trip" << std::endl;
+        return 1;
+    }
+
+    // Both encode paths put the same bytes out, with nothing of what was in the union before past its live member
+    TCPMessage ping;
+    memset(static_cast<void*>(&ping), 0xCD, sizeof(ping));
+    ping.type = TCPMessageType::Ping;
+    ping.data.pingPongData = TCPMessagePingPongData(3, 1234567890, 0, 0);
+    std::vector<uint8_t> tcpFast(WireSize<TCPMessage>::value), tcpFields(WireSize<TCPMessage>::value);
+    WireEncode(ping, tcpFast.data(), tcpFast.size());
+    WireCodec<TCPMessage>::Encode(ping, tcpFields.data());
+    UDPMessage reliable;
+    memset(static_cast<void*>(&reliable), 0xCD, sizeof(reliable));
+    reliable.type = UDPMessageType::Reliable;
+    reliable.data.reliableData.controlType = TCPMessageType::YouAreConnected;
+    WireEncode(reliable, wire, sizeof(wire));
+    WireCodec<UDPMessage>::Encode(reliable, again);
+    if (tcpFast != tcpFields || memcmp(wire, again, sizeof(wire)) != 0)
+    {
+        std::cout << "Error: WireEncode left old union bytes in a message" << std::endl;
+        return 1;
+    }
+
+    // 16 players each sending one update a tick, relayed to the other 15
+    UDPSendBufferPool pool;
+    std::vector<PacketAggregator> aggregators(16);
+    uint64_t datagrams = 0;
+    const uint64_t ticks = iterations / 256 + 1;
+    start = MonotonicMicroseconds();
+    for (uint64_t tick = 0; tick < ticks; tick++)
+    {
+        for (uint8_t from = 0; from < 16; from++)
+        {
+            for (uint8_t to = 0; to < 16; to++)
+            {
+                if (to != from)
+                {
+                    aggregators[to].Append(pool, msg, [&](UDPSendBuffer *buffer) { datagrams++; UDPSendBufferPool::Release(buffer); });
+                }
+            }
+        }
+        for (auto &aggregator : aggregators)
+        {
+            aggregator.Flush([&](UDPSendBuffer *buffer) { datagrams++; UDPSendBufferPool::Release(buffer); });
+        }
+    }
+    const uint64_t elapsed = MonotonicMicroseconds() - start;
+    Report("Batched relays (16 players)", ticks * 16 * 15, elapsed);
+    std::cout << "  " << datagrams << " datagrams, " << (datagrams > 0 ? ticks * 16 * 15 / datagrams : 0) << " messages per datagram" << std::endl;
+    return 0;
+}
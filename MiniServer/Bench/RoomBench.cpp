@@ -0,0 +1,90 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "RoomHost.hpp"
+#include "SyntheticCapture.hpp"
+
+// Many matches at once, each an offline server replaying the same synthetic session on its own pinned thread,
+// the way RoomHost runs rooms. Reports aggregate throughput for 1, 2, 4... rooms up to the limit, which should go
+// up in step with the room count until rooms outnumber cores.
+// Usage: RoomBench [max rooms] [players per room] [seconds of play] [capture file]
+
+int main(int argc, char *argv[])
+{
+    const uint32_t cores = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+    const uint32_t maxRooms = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : cores;
+    const uint32_t players = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 16;
+    const uint32_t seconds = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 120;
+    const std::string path = argc > 4 ? argv[4] : "RoomBench.capture";
+    const uint64_t tickUs = 16000;
+    const uint64_t ticks = static_cast<uint64_t>(seconds) * 1000000 / tickUs;
+
+    if (!WriteSyntheticCapture(path, players, ticks, tickUs))
+    {
+        return 1;
+    }
+    std::cout << cores << " cores" << std::endl;
+
+    for (uint32_t roomCount = 1; roomCount <= maxRooms; roomCount = roomCount < maxRooms && roomCount * 2 > maxRooms ? maxRooms : roomCount * 2)
+    {
+        std::atomic<uint32_t> ready(0);
+        std::atomic<bool> go(false);
+        std::atomic<uint64_t> replayed(0);
+        std::atomic<uint32_t> failed(0);
+        std::vector<std::thread> threads;
+        for (uint32_t room = 0; room < roomCount; room++)
+        {
+            threads.emplace_back([&, room]()
+            {
+                PinThreadToCore(room % cores);
+                CaptureReader reader;
+                if (!reader.Open(path))
+                {
+                    ready++;
+                    return;
+                }
+                boost::asio::io_service io_service;
+                ServerConfig config;
+                config.offline = true;
+                pServer server = MakeUnique<Server>(io_service, config);
+                ready++;
+                while (!go.load())
+                {
+                    std::this_thread::yield();
+                }
+                uint64_t roomReplayed;
+                if (!server->Replay(reader, roomReplayed))
+                {
+                    failed++;
+                }
+                replayed += roomReplayed;
+            });
+        }
+        while (ready.load() < roomCount)
+        {
+            std::this_thread::yield();
+        }
+
+        const uint64_t start = MonotonicMicroseconds();
+        go.store(true);
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        const uint64_t elapsed = MonotonicMicroseconds() - start;
+        std::cout << roomCount << " rooms: " << replayed.load() << " records in " << elapsed << "us ("
+            << (elapsed > 0 ? replayed.load() * 1000000 / elapsed : 0) << " records/s, "
+            << (elapsed > 0 ? roomCount * ticks * 1000000 / elapsed : 0) << " room ticks/s)" << std::endl;
+
+        if (failed.load() > 0)
+        {
+            return 1;
+        }
+        if (roomCount == maxRooms)
+        {
+            break;
+        }
+    }
+    return 0;
+}
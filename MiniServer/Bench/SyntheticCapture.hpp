@@ -0,0 +1,35 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include "Capture.hpp"
+
+// Writes a capture of players moving around, one PlayerUpdate from each of them every tick, so the benchmarks can
+// replay a session without having recorded one
+inline bool WriteSyntheticCapture(const std::string &path, uint32_t players, uint64_t ticks, uint64_t tickUs)
+{
+    CaptureWriter writer;
+    if (!writer.Open(path))
+    {
+        return false;
+    }
+    for (uint8_t id = 0; id < players && id < 16; id++)
+    {
+        writer.RecordConnect(id, 0, 0);
+    }
+    UDPMessage msg;
+    memset(static_cast<void*>(&msg), 0, sizeof(msg));
+    msg.type = UDPMessageType::PlayerUpdate;
+    msg.data.playerUpdateData.sender = UDPMessageSender::Client;
+    for (uint64_t tick = 1; tick <= ticks; tick++)
+    {
+        for (uint8_t id = 0; id < players && id < 16; id++)
+        {
+            msg.sequence = static_cast<uint16_t>(tick);
+            msg.data.playerUpdateData.playerData.id = id;
+            msg.data.playerUpdateData.playerData.transform.SetPosition(Vector3(static_cast<float>(tick), static_cast<float>(id), 0.f));
+            writer.RecordUDP(msg, tick, tick * tickUs);
+        }
+    }
+    std::cout << "Wrote " << ticks << " ticks for " << players << " players (" << writer.GetBytesWritten() << " bytes)" << std::endl;
+    return true;
+}
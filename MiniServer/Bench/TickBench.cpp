@@ -0,0 +1,53 @@
+#include <iostream>
+#include <string>
+#include "Server.hpp"
+#include "SyntheticCapture.hpp"
+
+// Generates a capture of players moving around and replays it through an offline server, reporting how fast Tick
+// gets through it. Same path as MiniServer --replay, minus needing a real session recorded first.
+// Usage: TickBench [players] [seconds of play] [capture file]
+// Built with MINISERVER_COUNT_ALLOCATIONS, any tick after the first second that allocates aborts it, see FanoutBench
+
+int main(int argc, char *argv[])
+{
+    const uint32_t players = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 16;
+    const uint32_t seconds = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 600;
+    const std::string path = argc > 3 ? argv[3] : "TickBench.capture";
+    const uint64_t tickUs = 16000;
+    const uint64_t ticks = static_cast<uint64_t>(seconds) * 1000000 / tickUs;
+
+    if (!WriteSyntheticCapture(path, players, ticks, tickUs))
+    {
+        return 1;
+    }
+
+    CaptureReader reader;
+    if (!reader.Open(path))
+    {
+        return 1;
+    }
+    boost::asio::io_service io_service;
+    ServerConfig config;
+    config.offline = true;
+    if (AllocationTracker::Enabled)
+    {
+        config.allocationFreeAfterTicks = static_cast<uint32_t>(1000000 / tickUs);
+    }
+    pServer server = MakeUnique<Server>(io_service, config);
+
+    const uint64_t start = MonotonicMicroseconds();
+    uint64_t replayed;
+    const bool replayedAll = server->Replay(reader, replayed);
+    const uint64_t elapsed = MonotonicMicroseconds() - start;
+    const Server::ReceiveStats stats = server->GetReceiveStats();
+    std::cout << "Replayed " << replayed << " records over " << ticks << " ticks in " << elapsed << "us ("
+        << (elapsed > 0 ? replayed * 1000000 / elapsed : 0) << " records/s, "
+        << (elapsed > 0 ? ticks * 1000000 / elapsed : 0) << " ticks/s)" << std::endl;
+    std::cout << "UDP: " << stats.packets << " packets, " << (stats.packets > 0 ? stats.bytesCopied / stats.packets : 0)
+        << " bytes copied per packet, " << stats.dropped << " dropped" << std::endl;
+    if (AllocationTracker::Enabled)
+    {
+        AllocationTracker::Report(std::cout);
+    }
+    return replayedAll ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sched.h>
+#include "Server.hpp"
+#include "ShmClient.hpp"
+
+// The same burst of datagrams through the asio and io_uring UDP backends, and from a local client over shared
+// memory (ShmTransport). A separate process sends them, so the CPU time counted is only the server's, while the
+// server ticks every tickUs.
+// asio does at least one recvfrom per datagram (plus epoll waits), io_uring one io_uring_enter per tick at most,
+// shared memory none at all unless its receive thread has gone to sleep.
+// Usage: UDPBackendBench [datagrams] [tick interval us] [port]
+
+enum class Backend
+{
+    Asio,
+    IoUring,
+    SharedMemory
+};
+
+static const char *ShmSocketPath = "/tmp/UDPBackendBench.sock";
+
+static uint64_t CpuMicroseconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void SendBurst(uint16_t port, uint64_t count)
+{
+    boost::asio::io_service io_service;
+    udp::socket socket(io_service, udp::v4());
+    const udp::endpoint server(boost::asio::ip::address_v4::loopback(), port);
+    UDPMessage msg;
+    memset(static_cast<void*>(&msg), 0, sizeof(msg));
+    msg.type = UDPMessageType::StillHere;
+    msg.data.stillHereData.sender = UDPMessageSender::Client;
+    uint8_t wire[WireSize<UDPMessage>::value];
+    for (uint64_t i = 0; i < count; i++)
+    {
+        msg.data.stillHereData.id = static_cast<uint8_t>(i % 16);
+        WireEncode(msg, wire, sizeof(wire));
+        socket.send_to(boost::asio::buffer(wire), server);
+        if (i % 32 == 31)
+        {
+            usleep(100); // Keep under what the socket buffer can take between ticks, drops would flatter whoever dropped
+        }
+    }
+}
+
+static void SendBurstShm(uint64_t count)
+{
+    ShmClient client;
+    if (!client.Attach(ShmSocketPath))
+    {
+        std::cout << "Couldn't attach to " << ShmSocketPath << std::endl;
+        return;
+    }
+    UDPMessage msg;
+    memset(static_cast<void*>(&msg), 0, sizeof(msg));
+    msg.type = UDPMessageType::StillHere;
+    msg.data.stillHereData.sender = UDPMessageSender::Client;
+    const auto ignore = [](...) {};
+    for (uint64_t i = 0; i < count; i++)
+    {
+        msg.data.stillHereData.id = static_cast<uint8_t>(i % 16);
+        while (!client.SendDatagram(msg))
+        {
+            sched_yield(); // Ring's full, nothing is dropped so just wait for the server to catch up
+        }
+        if (i % 32 == 31)
+        {
+            client.Receive(0, ignore, ignore); // Keep up with the server's pings and snapshots, or be dropped as a slow consumer
+        }
+    }
+}
+
+static void Run(const char *name, Backend backend, uint64_t count, uint64_t tickUs, uint16_t port)
+{
+    const pid_t sender = fork();
+    if (sender == 0)
+    {
+        usleep(200000); // Give the server time to come up
+        if (backend == Backend::SharedMemory)
+        {
+            SendBurstShm(count);
+        }
+        else
+        {
+            SendBurst(port, count);
+        }
+        _exit(0);
+    }
+
+    boost::asio::io_service io_service;
+    ServerConfig config;
+    config.tcpEnabled = false;
+    config.udpPort = port;
+    config.udpIoUring = backend == Backend::IoUring;
+    if (backend == Backend::SharedMemory)
+    {
+        config.ipcSocketPath = ShmSocketPath;
+    }
+    pServer server = MakeUnique<Server>(io_service, config);
+
+    const uint64_t cpuStart = CpuMicroseconds();
+    const uint64_t start = MonotonicMicroseconds();
+    uint64_t ticks = 0;
+    uint64_t senderDoneAt = 0;
+    while (senderDoneAt == 0 || MonotonicMicroseconds() - senderDoneAt < 50000)
+    {
+        server->Tick();
+        ticks++;
+        if (senderDoneAt == 0 && waitpid(sender, nullptr, WNOHANG) == sender)
+        {
+            senderDoneAt = MonotonicMicroseconds();
+        }
+        usleep(static_cast<useconds_t>(tickUs));
+    }
+    const uint64_t cpu = CpuMicroseconds() - cpuStart;
+    const uint64_t elapsed = MonotonicMicroseconds() - start;
+    const Server::ReceiveStats stats = server->GetReceiveStats();
+
+    std::cout << name << ": " << stats.packets << "/" << count << " handled over " << ticks << " ticks in " << elapsed << "us, "
+        << (stats.packets > 0 ? static_cast<double>(cpu) / stats.packets : 0.0) << "us cpu per datagram";
+    const uint64_t syscalls = server->GetUDPSyscallCount();
+    if (syscalls > 0)
+    {
+        std::cout << ", " << syscalls << " syscalls (" << (stats.packets > 0 ? static_cast<double>(syscalls) / stats.packets : 0.0) << " per datagram)";
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    const uint64_t count = argc > 1 ? std::stoull(argv[1]) : 200000;
+    const uint64_t tickUs = argc > 2 ? std::stoull(argv[2]) : 1000;
+    const uint16_t port = argc > 3 ? static_cast<uint16_t>(std::stoul(argv[3])) : 4450;
+
+    Run("asio", Backend::Asio, count, tickUs, port);
+#ifdef MINISERVER_IO_URING
+    Run("io_uring", Backend::IoUring, count, tickUs, port);
+#else
+    std::cout << "io_uring: not built in" << std::endl;
+#endif
+    Run("shared memory", Backend::SharedMemory, count, tickUs, port);
+    return 0;
+}
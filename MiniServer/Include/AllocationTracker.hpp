@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+
+// Counts heap allocations (global operator new) per thread and per subsystem, so whatever's still allocating on
+// a hot path can be found and named. Compiled in when MINISERVER_COUNT_ALLOCATIONS is defined, which debug builds
+// always do and -DMINISERVER_COUNT_ALLOCATIONS=ON does for any other. Otherwise operator new is left alone and
+// everything here counts nothing.
+// An AllocationScope tags what the thread allocates until it goes out of scope, the innermost tag wins, and
+// anything untagged is Other. Counting is a thread local increment, the tag a thread local store
+#if defined(_DEBUG) && !defined(MINISERVER_COUNT_ALLOCATIONS)
+#define MINISERVER_COUNT_ALLOCATIONS
+#endif
+
+enum class AllocationTag : uint8_t
+{
+    Other,
+    Tick, // Server::Tick, apart from anything more specific below
+    Channel, // Channel's own container, on either side
+    TcpSend, // Encoding and queueing for a TCPConnection, and starting its writes
+    TcpReceive, // Reading a TCPConnection and handing what arrived on
+    UdpSocket, // SocketTransport's UDP receives and sends, asio's handler storage mostly
+    Accept, // New connections, TCPConnection::Create and handing them to the server
+    Snapshots, // SendSnapshots on the io thread
+    Spectators, // SpectatorRelay
+    Count
+};
+
+const char *AllocationTagName(AllocationTag tag);
+
+class AllocationScope
+{
+public:
+#ifdef MINISERVER_COUNT_ALLOCATIONS
+    explicit AllocationScope(AllocationTag tag);
+    ~AllocationScope();
+#else
+    explicit AllocationScope(AllocationTag) {}
+#endif
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope &operator=(const AllocationScope&) = delete;
+
+#ifdef MINISERVER_COUNT_ALLOCATIONS
+private:
+    AllocationTag previous;
+#endif
+};
+
+namespace AllocationTracker
+{
+#ifdef MINISERVER_COUNT_ALLOCATIONS
+    static const bool Enabled = true;
+#else
+    static const bool Enabled = false;
+#endif
+
+    struct Counts
+    {
+        uint64_t allocations;
+        uint64_t bytes;
+    };
+
+    // The calling thread's, for one tag
+    Counts ThreadCounts(AllocationTag tag);
+    // Every thread that's allocated anything, for one tag
+    Counts TotalCounts(AllocationTag tag);
+
+    // Each thread's non zero counts by tag, threads in the order they first allocated
+    void Report(std::ostream &out);
+}
+
+// Number of heap allocations the calling thread has made so far, whatever the tag. Compare before and after a
+// block of code to catch anything on the hot path that should be using an arena. Always 0 when not counting
+uint64_t HeapAllocationCount();
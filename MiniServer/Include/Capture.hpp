@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "Protocol.hpp"
+
+// Binary capture of everything Tick was handed, so that real sessions can be replayed offline, either to
+// reproduce a problem or as a throughput benchmark.
+// The file is memory mapped and only ever appended to, so recording a message is a memcpy into the page cache
+// plus bumping dataEnd in the header. The OS writes it back whenever it likes, and because dataEnd is always
+// up to date a capture from a server that crashed is still readable up to the last full record.
+//
+// Layout: CaptureFileHeader | CaptureRecordHeader + payload | ... | CaptureIndexEntry[indexCount]
+// The index is written on Close. It holds an entry every indexIntervalUs of capture time, for seeking.
+// Captures without one (i.e. after a crash) can still be read front to back.
+
+enum class CaptureRecordKind : uint8_t
+{
+    UDP, // Payload is a UDPMessage
+    TCP, // Payload is a TCPMessage
+    Connect, // No payload, a client was given the id in CaptureRecordHeader::id
+    Handshake // Payload is a CaptureHandshake, a UDP-only client's first Reliable message and where it came from
+};
+
+#pragma pack(push, 1)
+struct CaptureFileHeader
+{
+    char magic[8]; // "MSCAPTUR"
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t dataEnd; // File offset one past the last complete record
+    uint64_t indexOffset; // 0 until the capture has been closed cleanly
+    uint64_t indexCount;
+    uint64_t indexIntervalUs;
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct CaptureRecordHeader
+{
+    uint16_t size; // Payload bytes following this header
+    CaptureRecordKind kind;
+    uint8_t id; // Only used by Connect
+    uint64_t tick; // Server tick the message was handled on
+    uint64_t timestamp; // Server monotonic microseconds for that tick
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct CaptureEndpoint
+{
+    uint8_t isV6;
+    uint8_t address[16]; // Only the first 4 bytes are used for v4
+    uint16_t port;
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct CaptureHandshake
+{
+    CaptureEndpoint endpoint;
+    UDPMessage msg;
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct CaptureIndexEntry
+{
+    uint64_t tick;
+    uint64_t timestamp;
+    uint64_t offset; // File offset of the first record of tick
+};
+#pragma pack(pop)
+
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    bool Open(const std::string &InPath, uint64_t InIndexIntervalUs = 1000000);
+    void Close();
+    inline bool IsOpen() const { return base != nullptr; }
+
+    void RecordUDP(const UDPMessage &msg, uint64_t tick, uint64_t timestamp) { Append(CaptureRecordKind::UDP, 0, &msg, sizeof(UDPMessage), tick, timestamp); }
+    void RecordTCP(const TCPMessage &msg, uint64_t tick, uint64_t timestamp) { Append(CaptureRecordKind::TCP, 0, &msg, sizeof(TCPMessage), tick, timestamp); }
+    void RecordConnect(uint8_t id, uint64_t tick, uint64_t timestamp) { Append(CaptureRecordKind::Connect, id, nullptr, 0, tick, timestamp); }
+    void RecordHandshake(const CaptureHandshake &handshake, uint64_t tick, uint64_t timestamp) { Append(CaptureRecordKind::Handshake, 0, &handshake, sizeof(CaptureHandshake), tick, timestamp); }
+
+    inline uint64_t GetBytesWritten() const { return writeOffset; }
+
+private:
+    void Append(CaptureRecordKind kind, uint8_t id, const void *payload, uint16_t size, uint64_t tick, uint64_t timestamp);
+    bool Map(uint64_t size);
+
+    std::string path;
+    boost::interprocess::file_mapping file;
+    boost::interprocess::mapped_region region;
+    uint8_t *base;
+    uint64_t mappedSize;
+    uint64_t writeOffset;
+
+    std::vector<CaptureIndexEntry> index;
+    uint64_t indexIntervalUs;
+    uint64_t nextIndexTime;
+    uint64_t lastTick;
+};
+
+class CaptureReader
+{
+public:
+    CaptureReader();
+
+    bool Open(const std::string &path);
+    inline bool IsOpen() const { return base != nullptr; }
+
+    // Walks records in order. Returns false at the end of the capture
+    bool Next(CaptureRecordHeader &header, const uint8_t *&payload);
+    // Positions the reader at the first record of the first tick at or after timestamp, using the index if there is one
+    void SeekToTime(uint64_t timestamp);
+    void Rewind() { readOffset = headerSize; }
+
+    inline uint64_t GetIndexCount() const { return indexCount; }
+
+private:
+    boost::interprocess::file_mapping file;
+    boost::interprocess::mapped_region region;
+    const uint8_t *base;
+    uint64_t headerSize;
+    uint64_t dataEnd;
+    uint64_t readOffset;
+    const CaptureIndexEntry *indexEntries;
+    uint64_t indexCount;
+};
@@ -4,6 +4,7 @@
 #include <stack>
 #include <queue>
 #include <condition_variable>
+#include "AllocationTracker.hpp"
 
 // Container must implement front(), as well as push(), pop() and empty()
 // Or specify as queue or stack, which have specialised variants
@@ -26,6 +27,7 @@ public:
 
     void Write(DataType data)
     {
+        AllocationScope allocationScope(AllocationTag::Channel); // The container growing
         std::unique_lock<std::mutex> lock(bufferMutex);
         buffer.push(data);
         bufferEmpty = false;
@@ -49,6 +51,20 @@ public:
         return data;
     }
 
+    // Take everything currently in the channel in one lock, in the same order Read would have given it
+    template<typename OutputContainer>
+    void ReadAll(OutputContainer &out)
+    {
+        AllocationScope allocationScope(AllocationTag::Channel);
+        std::unique_lock<std::mutex> lock(bufferMutex);
+        while (!buffer.empty())
+        {
+            out.push_back(buffer.front());
+            buffer.pop();
+        }
+        bufferEmpty = true;
+    }
+
 private:
     Container buffer;
     std::mutex bufferMutex;
@@ -76,6 +92,7 @@ public:
 
     void Write(DataType data)
     {
+        AllocationScope allocationScope(AllocationTag::Channel); // The container growing
         std::unique_lock<std::mutex> lock(bufferMutex);
         buffer.push(data);
         bufferEmpty = false;
@@ -98,6 +115,21 @@ public:
         if (buffer.empty()) bufferEmpty = true;
         return data;
     }
+
+    // Take everything currently in the channel in one lock, in the same order Read would have given it
+    template<typename OutputContainer>
+    void ReadAll(OutputContainer &out)
+    {
+        AllocationScope allocationScope(AllocationTag::Channel);
+        std::unique_lock<std::mutex> lock(bufferMutex);
+        while (!buffer.empty())
+        {
+            out.push_back(buffer.top());
+            buffer.pop();
+        }
+        bufferEmpty = true;
+    }
+
 private:
     std::stack<DataType> buffer;
     std::mutex bufferMutex;
@@ -126,6 +158,7 @@ public:
 
     void Write(DataType data)
     {
+        AllocationScope allocationScope(AllocationTag::Channel); // The container growing
         std::unique_lock<std::mutex> lock(bufferMutex);
         buffer.push(data);
         bufferEmpty = false;
@@ -148,6 +181,21 @@ public:
         if (buffer.empty()) bufferEmpty = true;
         return data;
     }
+
+    // Take everything currently in the channel in one lock, in the same order Read would have given it
+    template<typename OutputContainer>
+    void ReadAll(OutputContainer &out)
+    {
+        AllocationScope allocationScope(AllocationTag::Channel);
+        std::unique_lock<std::mutex> lock(bufferMutex);
+        while (!buffer.empty())
+        {
+            out.push_back(buffer.front());
+            buffer.pop();
+        }
+        bufferEmpty = true;
+    }
+
 private:
     std::queue<DataType> buffer;
     std::mutex bufferMutex;
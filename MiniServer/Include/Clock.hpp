@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+
+// Monotonic clock in microseconds. std::time only has one second resolution and the wall clock can jump
+// about, so anything that measures time between two events (roundtrips, timeouts, ordering) should use this.
+// The epoch is arbitrary, values are only meaningful relative to other values from the same process.
+inline uint64_t MonotonicMicroseconds()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()
+    );
+}
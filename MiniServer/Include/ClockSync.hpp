@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include "Protocol.hpp"
+
+// Tracks the roundtrip time, jitter and clock offset of a single client from the pings we send it.
+// The maths is NTP style, with four timestamps per exchange:
+//   t0 = originateTimestamp   (server clock, ping sent)
+//   t1 = receiveTimestamp     (client clock, ping received)
+//   t2 = transmitTimestamp    (client clock, pong sent)
+//   t3 = destinationTimestamp (server clock, pong received)
+// rtt = (t3 - t0) - (t2 - t1), offset = ((t1 - t0) + (t2 - t3)) / 2
+// Smoothed rtt and jitter follow RFC 6298 (gains of 1/8 and 1/4). The offset is taken from the sample with
+// the lowest rtt out of the last few, as that is the one least skewed by queueing on either leg.
+class ClockSync
+{
+public:
+    ClockSync()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        smoothedRtt = 0;
+        rttVariance = 0;
+        clockOffset = 0;
+        numSamples = 0;
+        nextSample = 0;
+    }
+
+    void AddSample(const TCPMessagePingPongData &pong)
+    {
+        const int64_t t0 = static_cast<int64_t>(pong.originateTimestamp);
+        const int64_t t1 = static_cast<int64_t>(pong.receiveTimestamp);
+        const int64_t t2 = static_cast<int64_t>(pong.transmitTimestamp);
+        const int64_t t3 = static_cast<int64_t>(pong.destinationTimestamp);
+
+        int64_t rtt = (t3 - t0) - (t2 - t1);
+        if (rtt < 0) rtt = 0; // Client took longer to turn it around than the whole trip, don't trust its clock rate
+        const int64_t offset = ((t1 - t0) + (t2 - t3)) / 2;
+
+        if (numSamples == 0)
+        {
+            smoothedRtt = rtt;
+            rttVariance = rtt / 2;
+        }
+        else
+        {
+            const int64_t delta = smoothedRtt > rtt ? smoothedRtt - rtt : rtt - smoothedRtt;
+            rttVariance += (delta - rttVariance) / 4;
+            smoothedRtt += (rtt - smoothedRtt) / 8;
+        }
+
+        samples[nextSample] = { rtt, offset };
+        nextSample = (nextSample + 1) % samples.size();
+        if (numSamples < samples.size()) numSamples++;
+
+        // Pick the offset from the least delayed sample we still have
+        size_t best = 0;
+        for (size_t i = 1; i < numSamples; i++)
+        {
+            if (samples[i].rtt < samples[best].rtt) best = i;
+        }
+        clockOffset = samples[best].offset;
+    }
+
+    inline bool HasSample() const { return numSamples > 0; }
+    inline uint32_t GetSmoothedRtt() const { return static_cast<uint32_t>(smoothedRtt); } // Microseconds
+    inline uint32_t GetJitter() const { return static_cast<uint32_t>(rttVariance); } // Microseconds, mean deviation of the rtt
+    inline int64_t GetClockOffset() const { return clockOffset; } // Client clock minus server clock, microseconds
+
+    // Convert a timestamp taken on the client's clock into the server's clock
+    inline uint64_t ToServerTime(uint64_t clientTime) const
+    {
+        return static_cast<uint64_t>(static_cast<int64_t>(clientTime) - clockOffset);
+    }
+
+private:
+    struct Sample
+    {
+        int64_t rtt;
+        int64_t offset;
+    };
+
+    std::array<Sample, 8> samples;
+    size_t numSamples;
+    size_t nextSample;
+
+    int64_t smoothedRtt;
+    int64_t rttVariance;
+    int64_t clockOffset;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "AllocationTracker.hpp" // HeapAllocationCount, for checking the arena is doing its job
+
+// Bump pointer allocator for anything that only needs to live for one frame. Allocating is a pointer bump and
+// freeing is resetting the pointer, so scratch buffers on the hot path don't have to touch the heap at all.
+// Only Tick uses one, resetting its thread's arena at the start of every tick. The io thread handlers have no
+// per call scratch to put in one, they work in place in pooled buffers (see UDPReceivePool, TCPConnection).
+// If a frame outgrows the arena the extra comes from the heap (and is counted), and the next Reset grows the
+// main block to fit, so steady state is one block and no heap traffic.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t InCapacity = 64 * 1024);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena &operator=(const FrameArena&) = delete;
+
+    void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    void Reset();
+
+    inline size_t GetUsed() const { return offset + overflowBytes; }
+    inline size_t GetCapacity() const { return capacity; }
+    inline size_t GetHighWater() const { return highWater; }
+    inline uint64_t GetOverflowCount() const { return overflowCount; } // Allocations that had to go to the heap
+
+    // One arena per thread, created on first use
+    static FrameArena &ThreadLocal();
+
+private:
+    uint8_t *block;
+    size_t capacity;
+    size_t offset;
+    size_t highWater;
+
+    std::vector<void*> overflowBlocks;
+    size_t overflowBytes;
+    uint64_t overflowCount;
+};
+
+// STL allocator on top of a FrameArena, e.g. ArenaVector<UDPMessage> messages{ ArenaAllocator<UDPMessage>(arena) };
+// deallocate does nothing, memory comes back when the arena is reset, so containers using it must not outlive the frame
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(FrameArena &InArena) : arena(&InArena) {}
+    template<typename OtherT>
+    ArenaAllocator(const ArenaAllocator<OtherT> &Other) : arena(Other.arena) {}
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T*>(arena->Allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t) {}
+
+    template<typename OtherT>
+    bool operator==(const ArenaAllocator<OtherT> &Other) const { return arena == Other.arena; }
+    template<typename OtherT>
+    bool operator!=(const ArenaAllocator<OtherT> &Other) const { return arena != Other.arena; }
+
+private:
+    template<typename OtherT>
+    friend class ArenaAllocator;
+
+    FrameArena *arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
@@ -1,7 +1,10 @@
 #pragma once
 #include <cstdint>
 #include <cmath>
+#include <cstddef>
+#ifdef _MSC_VER
 #include <intrin.h>
+#endif
 
 // RemoveReference
 template< typename T > struct RemoveReference { typedef T Type; };
@@ -28,15 +31,19 @@ inline T&& Forward(typename RemoveReference<T>::Type&& Obj)
     return (T&&)Obj;
 }
 
-static uint32_t CountTrailingZeros(uint32_t Value)
+static inline uint32_t CountTrailingZeros(uint32_t Value)
 {
     if (Value == 0)
     {
         return 32;
     }
-    uint32_t BitIndex; // 0-based, where LSB is 0 and MSB is 31
-    _BitScanForward(reinterpret_cast<unsigned long*>(&BitIndex), Value); // Scans from LSB to MSB
-    return BitIndex;
+#ifdef _MSC_VER
+    unsigned long BitIndex; // 0-based, where LSB is 0 and MSB is 31
+    _BitScanForward(&BitIndex, Value); // Scans from LSB to MSB
+    return static_cast<uint32_t>(BitIndex);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(Value)); // Same thing on GCC/Clang, undefined for 0 so that's handled above
+#endif
 }
 
 template<typename T>
@@ -48,8 +55,6 @@ static inline void Valswap(T& A, T& B)
     B = Tmp;
 }
 
-static void MemswapImpl(void* Ptr1, void* Ptr2, size_t Size);
-
 // Memswap function used by SharedRef & UniqueObj
 static inline void Memswap(void* Ptr1, void* Ptr2, size_t Size)
 {
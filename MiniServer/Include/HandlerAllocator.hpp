@@ -0,0 +1,152 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <boost/version.hpp>
+
+// asio allocates each outstanding operation's state, handler included, and only recycles that memory on the
+// thread it's freed on. Anything started on one thread and finished on another, like a tick sending on a socket
+// the io thread completes, pays a malloc every time. HandlerMemory is a block for one operation at a time, kept
+// wherever the operation comes from (a connection's writes, a shard's receives, a send buffer), and handed to asio
+// by wrapping the handler with MakeAllocatingHandler. If the block is taken or too small it falls back on the heap,
+// so getting the size wrong only costs what it did before.
+// The block itself is allocated once, separately, because an operation can outlive whatever started it. Once the
+// io_service is stopped its pending operations are only destroyed with it, by which point the socket or connection
+// that held the memory is long gone, so a block still in use then is left for the operation to free
+class HandlerMemory
+{
+public:
+    class Block
+    {
+    public:
+        // Any thread, the operation can be started on one and completed on another
+        void *Allocate(size_t size)
+        {
+            uint8_t expected = Free;
+            if (size <= sizeof(storage) && state.compare_exchange_strong(expected, InUse, std::memory_order_acquire))
+            {
+                return &storage;
+            }
+            return ::operator new(size);
+        }
+
+        void Deallocate(void *pointer)
+        {
+            if (pointer != &storage)
+            {
+                ::operator delete(pointer);
+            }
+            else if (state.exchange(Free, std::memory_order_release) == Orphaned)
+            {
+                delete this;
+            }
+        }
+
+    private:
+        friend class HandlerMemory;
+        static const size_t Size = 512; // Plenty for a socket operation holding a bound member function and a few arguments
+        enum : uint8_t { Free, InUse, Orphaned };
+
+        Block() : state(Free) {}
+
+        typename std::aligned_storage<Size>::type storage;
+        std::atomic<uint8_t> state;
+    };
+
+    HandlerMemory()
+        : block(new Block())
+    {
+    }
+
+    ~HandlerMemory()
+    {
+        uint8_t expected = Block::InUse;
+        if (!block->state.compare_exchange_strong(expected, Block::Orphaned, std::memory_order_acq_rel))
+        {
+            delete block; // Free, nothing else can take it now
+        }
+    }
+
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory &operator=(const HandlerMemory&) = delete;
+
+    inline Block &GetBlock() { return *block; }
+
+private:
+    Block *block;
+};
+
+// The allocator asio finds through a handler's allocator_type and get_allocator. It holds the block rather than
+// the HandlerMemory, which may not be there any more when the operation is freed
+template<typename T>
+class HandlerAllocator
+{
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory::Block &InBlock)
+        : block(&InBlock)
+    {
+    }
+
+    template<typename OtherT>
+    HandlerAllocator(const HandlerAllocator<OtherT> &Other)
+        : block(Other.block)
+    {
+    }
+
+    T *allocate(size_t count) { return static_cast<T*>(block->Allocate(sizeof(T) * count)); }
+    void deallocate(T *pointer, size_t) { block->Deallocate(pointer); }
+
+    template<typename OtherT>
+    bool operator==(const HandlerAllocator<OtherT> &Other) const { return block == Other.block; }
+    template<typename OtherT>
+    bool operator!=(const HandlerAllocator<OtherT> &Other) const { return block != Other.block; }
+
+private:
+    template<typename OtherT>
+    friend class HandlerAllocator;
+
+    HandlerMemory::Block *block;
+};
+
+template<typename Handler>
+class AllocatingHandler
+{
+public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    AllocatingHandler(HandlerMemory &InMemory, Handler InHandler)
+        : block(&InMemory.GetBlock())
+        , handler(std::move(InHandler))
+    {
+    }
+
+    allocator_type get_allocator() const { return allocator_type(*block); }
+
+    template<typename... Args>
+    void operator()(Args&&... args)
+    {
+        handler(std::forward<Args>(args)...);
+    }
+
+#if BOOST_VERSION < 106600
+    // Before associated allocators asio looked for these instead
+    friend void *asio_handler_allocate(size_t size, AllocatingHandler *self) { return self->block->Allocate(size); }
+    friend void asio_handler_deallocate(void *pointer, size_t, AllocatingHandler *self) { self->block->Deallocate(pointer); }
+#endif
+
+private:
+    HandlerMemory::Block *block;
+    Handler handler;
+};
+
+// Only one operation should be using memory at a time to get any benefit from it
+template<typename Handler>
+inline AllocatingHandler<typename std::decay<Handler>::type> MakeAllocatingHandler(HandlerMemory &memory, Handler &&handler)
+{
+    return AllocatingHandler<typename std::decay<Handler>::type>(memory, std::forward<Handler>(handler));
+}
@@ -29,6 +29,36 @@ public:
 		return id;
 	}
 
+	// Takes a particular ID out of the pool, e.g. to bring back one handed out before. False if it's already
+	// allocated (or was never in the pool)
+	inline bool ReserveID(const unsigned int Id)
+	{
+		std::stack<unsigned int> rest;
+		bool found = false;
+		while (!unused.empty())
+		{
+			if (unused.top() == Id)
+			{
+				found = true;
+			}
+			else
+			{
+				rest.push(unused.top());
+			}
+			unused.pop();
+		}
+		while (!rest.empty()) // Back in the order they came out
+		{
+			unused.push(rest.top());
+			rest.pop();
+		}
+		if (found)
+		{
+			numUsed++;
+		}
+		return found;
+	}
+
 	inline void ReturnID(const unsigned int Id)
 	{
 		unused.push(Id);
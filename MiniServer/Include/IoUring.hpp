@@ -0,0 +1,84 @@
+#pragma once
+#ifdef MINISERVER_IO_URING
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+// Just enough of io_uring to drive it straight through the syscalls, without liburing.
+// Submissions are queued with GetSqe and only handed to the kernel by Submit, so a whole tick's worth goes in one
+// io_uring_enter. Completions are read straight out of the shared ring by ForEachCompletion, no syscall needed.
+// One provided buffer ring is supported, for receives that pick their own buffer (IOSQE_BUFFER_SELECT).
+// Single threaded, the owner does all of the submitting and reaping.
+class IoUring
+{
+public:
+    IoUring();
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring &operator=(const IoUring&) = delete;
+
+    bool Init(uint32_t sqEntries, uint32_t cqEntries);
+    void Close();
+    inline bool IsValid() const { return ringFd >= 0; }
+
+    // The next free submission, zeroed. nullptr if the queue is full, Submit and try again
+    io_uring_sqe *GetSqe();
+    // Hands everything queued since last time to the kernel, without waiting for any of it. Returns how many went
+    // in, or -errno. Also what gets the kernel to flush completions that overflowed the completion ring
+    int Submit();
+
+    // func(const io_uring_cqe&) for each completion waiting, returns how many there were
+    template<typename Func>
+    size_t ForEachCompletion(Func &&func)
+    {
+        unsigned head = *cqHead;
+        const unsigned tail = reinterpret_cast<std::atomic<unsigned>*>(cqTail)->load(std::memory_order_acquire);
+        size_t count = 0;
+        for (; head != tail; head++, count++)
+        {
+            func(cqes[head & cqMask]);
+        }
+        reinterpret_cast<std::atomic<unsigned>*>(cqHead)->store(head, std::memory_order_release);
+        return count;
+    }
+
+    bool RegisterBuffers(const iovec *buffers, unsigned count);
+
+    // Provided buffers. Add any number, then Commit to make them visible to the kernel
+    bool SetupBufferRing(uint16_t groupId, uint16_t entries);
+    void AddBuffer(void *address, uint32_t length, uint16_t bufferId);
+    void CommitBuffers();
+
+    inline uint64_t GetEnterCount() const { return enterCount; } // io_uring_enter syscalls made so far
+
+private:
+    int ringFd;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing; // Same mapping as sqRing when the kernel has IORING_FEAT_SINGLE_MMAP
+    size_t cqRingSize;
+    io_uring_sqe *sqes;
+    size_t sqesSize;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqFlags;
+    unsigned sqMask;
+    unsigned sqEntryCount;
+    unsigned sqLocalTail; // Queued by GetSqe, not yet published to the kernel
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    io_uring_cqe *cqes;
+
+    io_uring_buf_ring *bufferRing;
+    size_t bufferRingSize;
+    uint16_t bufferRingMask;
+    uint16_t bufferRingLocalTail; // Added by AddBuffer, not yet committed
+
+    uint64_t enterCount;
+};
+#endif
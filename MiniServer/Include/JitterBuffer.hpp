@@ -0,0 +1,205 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include "SequenceNumber.hpp"
+
+// Smooths out a stream of sequence numbered updates from one client so they get applied one per interval,
+// in order, regardless of how bunched up or shuffled they arrived.
+// Updates are held in a ring indexed by sequence % Capacity, so an insert is a single slot check: anything older
+// than the next sequence due out is late, and anything whose slot is already filled is a duplicate.
+// Playback starts once targetDepth updates are waiting, then one sequence is due every intervalUs. If a due
+// sequence never arrived it is skipped (and counted as lost) rather than waited on, if the buffer runs dry it
+// stops and refills to targetDepth, and if it backs up past twice targetDepth the extra is released straight away
+// so latency doesn't creep up.
+// Not thread safe, meant to be filled and drained by the tick.
+template<typename ItemType, uint16_t Capacity = 32>
+class JitterBuffer
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two so the ring survives sequence wrap");
+
+public:
+    enum class InsertResult : uint8_t
+    {
+        Accepted,
+        Late, // Older than what has already been released (or skipped), includes duplicates of released updates
+        Duplicate // Already waiting in the buffer
+    };
+
+    JitterBuffer(const uint16_t InTargetDepth = 2, const uint64_t InIntervalUs = 16000)
+        : targetDepth(InTargetDepth)
+        , intervalUs(InIntervalUs)
+    {
+        Reset();
+    }
+
+    void Configure(const uint16_t InTargetDepth, const uint64_t InIntervalUs)
+    {
+        targetDepth = InTargetDepth < Capacity / 2 ? InTargetDepth : Capacity / 2;
+        intervalUs = InIntervalUs;
+    }
+
+    // Reset, passing everything still waiting to drop first
+    template<typename DropFunc>
+    void Clear(DropFunc &&drop)
+    {
+        for (auto &slot : slots)
+        {
+            if (slot.present)
+            {
+                drop(slot.item);
+            }
+        }
+        Reset();
+    }
+
+    void Reset()
+    {
+        for (auto &slot : slots)
+        {
+            slot.present = false;
+        }
+        started = false;
+        playing = false;
+        nextRelease = 0;
+        nextReleaseTime = 0;
+        count = 0;
+        released = 0;
+        lost = 0;
+        late = 0;
+        duplicates = 0;
+        underruns = 0;
+    }
+
+    InsertResult Insert(const uint16_t sequence, const ItemType &item)
+    {
+        return Insert(sequence, item, [](const ItemType&) {});
+    }
+
+    // As above, but anything the buffer lets go of without releasing (overtaken after a long gap) is passed to drop,
+    // for when items are handles to something that has to be given back
+    template<typename DropFunc>
+    InsertResult Insert(const uint16_t sequence, const ItemType &item, DropFunc &&drop)
+    {
+        if (!started)
+        {
+            nextRelease = sequence; // The first update we see starts the stream
+            started = true;
+        }
+        if (SequenceLessThan(sequence, nextRelease))
+        {
+            late++;
+            return InsertResult::Late;
+        }
+
+        // So far ahead it would land on top of something still waiting, everything it overtakes is lost.
+        // Only happens after a long gap, otherwise this is all O(1)
+        while (SequenceDistance(sequence, nextRelease) >= Capacity)
+        {
+            Slot &skipped = slots[nextRelease % Capacity];
+            if (skipped.present)
+            {
+                skipped.present = false;
+                count--;
+                drop(skipped.item);
+            }
+            lost++;
+            nextRelease++;
+        }
+
+        Slot &slot = slots[sequence % Capacity];
+        if (slot.present)
+        {
+            duplicates++;
+            return InsertResult::Duplicate;
+        }
+        slot.present = true;
+        slot.item = item;
+        count++;
+        return InsertResult::Accepted;
+    }
+
+    // Calls release(item) for everything due by now, in sequence order
+    template<typename ReleaseFunc>
+    void Release(const uint64_t now, ReleaseFunc &&release)
+    {
+        if (!playing)
+        {
+            if (count < targetDepth || count == 0)
+            {
+                return;
+            }
+            playing = true;
+            nextReleaseTime = now;
+        }
+        if (now > nextReleaseTime && now - nextReleaseTime > intervalUs * Capacity)
+        {
+            nextReleaseTime = now; // The tick stalled, don't try and make up for all of it
+        }
+
+        while (now >= nextReleaseTime)
+        {
+            if (count == 0)
+            {
+                playing = false; // Ran dry, wait until it has filled back up
+                underruns++;
+                return;
+            }
+            ReleaseNext(release);
+            nextReleaseTime += intervalUs;
+        }
+
+        while (count > targetDepth * 2)
+        {
+            ReleaseNext(release); // Backed up, catch up now rather than sitting on stale updates
+        }
+    }
+
+    inline uint16_t GetDepth() const { return count; }
+    inline uint64_t GetReleasedCount() const { return released; }
+    inline uint64_t GetLostCount() const { return lost; }
+    inline uint64_t GetLateCount() const { return late; }
+    inline uint64_t GetDuplicateCount() const { return duplicates; }
+    inline uint64_t GetUnderrunCount() const { return underruns; }
+
+private:
+    struct Slot
+    {
+        bool present;
+        ItemType item;
+    };
+
+    template<typename ReleaseFunc>
+    void ReleaseNext(ReleaseFunc &release)
+    {
+        Slot &slot = slots[nextRelease % Capacity];
+        if (slot.present)
+        {
+            slot.present = false;
+            count--;
+            released++;
+            release(slot.item);
+        }
+        else
+        {
+            lost++; // Its turn came and it wasn't here, if it turns up now it will be late
+        }
+        nextRelease++;
+    }
+
+    std::array<Slot, Capacity> slots;
+    uint16_t targetDepth;
+    uint64_t intervalUs;
+
+    bool started;
+    bool playing;
+    uint16_t nextRelease; // Sequence of the next update due out
+    uint64_t nextReleaseTime;
+    uint16_t count; // Updates waiting
+
+    uint64_t released;
+    uint64_t lost;
+    uint64_t late;
+    uint64_t duplicates;
+    uint64_t underruns;
+};
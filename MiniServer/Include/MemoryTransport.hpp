@@ -0,0 +1,82 @@
+#pragma once
+#include <vector>
+#include "Transport.hpp"
+
+using boost::asio::ip::udp;
+
+// One of MemoryTransport's simulated clients. What the server sends it is counted rather than decoded, apart from
+// picking its id out of YouAreConnected
+class MemoryClient
+{
+public:
+    MemoryClient()
+        : id(UDPUnassignedId)
+        , connected(false)
+        , datagramsReceived(0)
+        , bytesReceived(0)
+        , controlMessagesReceived(0)
+    {}
+
+    inline uint8_t GetId() const { return id; }
+    inline bool IsConnected() const { return connected; }
+    inline const udp::endpoint &GetEndpoint() const { return endpoint; }
+    inline uint64_t GetDatagramsReceived() const { return datagramsReceived; }
+    inline uint64_t GetBytesReceived() const { return bytesReceived; }
+    inline uint64_t GetControlMessagesReceived() const { return controlMessagesReceived; }
+
+private:
+    friend class MemoryTransport;
+    friend class MemoryConnection;
+
+    uint8_t id;
+    bool connected;
+    udp::endpoint endpoint; // Never bound to anything, just how the server tells the clients apart
+    uint64_t datagramsReceived;
+    uint64_t bytesReceived;
+    uint64_t controlMessagesReceived;
+};
+
+// A transport with no kernel, threads or clock of its own. N simulated clients are linked straight to the
+// server's queues: their datagrams are encoded into receive pool slabs and handed over as if just received, their
+// control messages go into the TCP message channel, and whatever the server sends them is delivered (counted)
+// there and then. Everything happens on the thread driving the ticks, so given the same calls and the same tick
+// times a run is the same every time. Meant for benchmarking the server's own work
+class MemoryTransport : public Transport
+{
+public:
+    explicit MemoryTransport(uint32_t clientCount);
+
+    bool Start(TransportHandler &InHandler, UDPReceivePool &InReceivePool, UDPSendBufferPool &sendPool, Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > &InTcpMessageChannel) override;
+    void Stop() override {}
+    void Send(UDPSendBuffer *buffer, const udp::endpoint &to) override;
+
+    // Everything below is the clients' side, called between ticks
+
+    // Opens a stream connection for client. The server takes it on at its next tick, and once the client has its
+    // id it asks for its datagrams as a real client does, see MemoryClient::IsConnected
+    void Connect(uint32_t client);
+    // As if received from client, false if it was dropped
+    bool SendDatagram(uint32_t client, const UDPMessage &msg);
+    // As if received over client's stream connection
+    void SendControl(uint32_t client, TCPMessage &msg);
+
+    inline MemoryClient &GetClient(uint32_t client) { return clients[client]; }
+    inline size_t GetClientCount() const { return clients.size(); }
+    inline uint64_t GetDatagramsDelivered() const { return datagramsDelivered; }
+    inline uint64_t GetBytesDelivered() const { return bytesDelivered; }
+    inline uint64_t GetDatagramsLost() const { return datagramsLost; } // Sent to an endpoint that isn't a client
+
+private:
+    friend class MemoryConnection;
+
+    void RequestDatagrams(uint32_t client); // As soon as client hears its id
+
+    TransportHandler *handler;
+    UDPReceivePool *receivePool;
+    Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > *tcpMessageChannel;
+    std::vector<MemoryClient> clients; // Client i is 127.0.0.1 port i + 1
+    uint16_t heldSlab; // Rejected last time, so still ours to encode the next datagram into
+    uint64_t datagramsDelivered;
+    uint64_t bytesDelivered;
+    uint64_t datagramsLost;
+};
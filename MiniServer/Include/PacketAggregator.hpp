@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <array>
+#include <vector>
+#include <memory>
+#include "ProtocolSchema.hpp"
+#include "Trace.hpp"
+#include "HandlerAllocator.hpp"
+
+// A datagram's worth of bytes that stays put until the socket is done with it.
+// inUse is set by the tick thread when it hands the buffer to async_send_to, and cleared by the send handler on
+// the io thread, which is the only cross thread traffic involved
+struct UDPSendBuffer
+{
+    std::atomic<bool> inUse;
+    uint32_t index; // Where it is in the pool, which is also its registered buffer index for the io_uring backend
+    size_t size;
+    uint64_t traceFlow; // Tick thread sets it when sending, 0 if it isn't being traced
+    HandlerMemory sendHandler; // asio's storage for the send it's in, so a send from the tick thread doesn't malloc
+    std::array<uint8_t, UDPMaxDatagramSize> data;
+};
+
+// Send buffers are recycled rather than allocated per datagram. The pool only grows when every buffer is
+// still waiting on the socket, so after the first few ticks it stops allocating altogether
+class UDPSendBufferPool
+{
+public:
+    explicit UDPSendBufferPool(size_t InitialCount = 32);
+
+    // Tick thread only
+    UDPSendBuffer *Acquire();
+    // Any thread, once the send has completed
+    static void Release(UDPSendBuffer *buffer)
+    {
+        if (buffer->traceFlow != 0)
+        {
+            MINISERVER_TRACE_FLOW(FlowEnd, "UDP batch", buffer->traceFlow); // Wherever the send completed
+            buffer->traceFlow = 0;
+        }
+        buffer->inUse.store(false, std::memory_order_release);
+    }
+
+    inline size_t GetCount() const { return buffers.size(); }
+    inline UDPSendBuffer *Get(size_t index) { return buffers[index].get(); }
+
+private:
+    std::vector<std::unique_ptr<UDPSendBuffer>> buffers;
+    size_t cursor; // Where to start looking next time, buffers tend to come back in the order they went out
+};
+
+// Packs everything headed to one client during a tick into as few datagrams as possible.
+// Messages are written straight into a pooled send buffer behind a UDPBatchHeader, when the next one wouldn't fit
+// the buffer is handed to send and a fresh one started. Flush at the end of the tick sends whatever is left
+class PacketAggregator
+{
+public:
+    PacketAggregator()
+        : current(nullptr)
+        , datagramsSent(0)
+        , messagesSent(0)
+    {}
+
+    // send is called as send(UDPSendBuffer*) with each full datagram, and owns the buffer from then on
+    template<typename SendFunc>
+    void Append(UDPSendBufferPool &pool, const UDPMessage &msg, SendFunc &&send)
+    {
+        if (current != nullptr && reinterpret_cast<UDPBatchHeader*>(current->data.data())->count == UDPMessagesPerDatagram)
+        {
+            Flush(send);
+        }
+        if (current == nullptr)
+        {
+            current = pool.Acquire();
+            reinterpret_cast<UDPBatchHeader*>(current->data.data())->count = 0;
+            current->size = sizeof(UDPBatchHeader);
+        }
+        current->size += WireEncode(msg, current->data.data() + current->size, current->data.size() - current->size);
+        reinterpret_cast<UDPBatchHeader*>(current->data.data())->count++;
+    }
+
+    template<typename SendFunc>
+    void Flush(SendFunc &&send)
+    {
+        if (current == nullptr)
+        {
+            return;
+        }
+        messagesSent += reinterpret_cast<UDPBatchHeader*>(current->data.data())->count;
+        datagramsSent++;
+        UDPSendBuffer *buffer = current;
+        current = nullptr;
+        send(buffer);
+    }
+
+    // Throw away anything not yet flushed, e.g. when the client has gone
+    void Discard()
+    {
+        if (current != nullptr)
+        {
+            UDPSendBufferPool::Release(current);
+            current = nullptr;
+        }
+    }
+
+    inline bool Empty() const { return current == nullptr; }
+    inline uint64_t GetDatagramsSent() const { return datagramsSent; }
+    inline uint64_t GetMessagesSent() const { return messagesSent; }
+
+private:
+    UDPSendBuffer *current;
+    uint64_t datagramsSent;
+    uint64_t messagesSent;
+};
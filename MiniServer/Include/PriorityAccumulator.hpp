@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <algorithm>
+#include "Protocol.hpp"
+
+// Tunables for PriorityAccumulator, copied out of ServerConfig
+struct PriorityConfig
+{
+    float nearDistance; // Anything this close is as important as it gets
+    float falloffDistance; // Priority halves this far beyond nearDistance, and keeps falling off after that
+    uint32_t bytesPerSecond; // Each client's budget for player updates
+    uint32_t burstBytes; // Unspent budget carried over between ticks, up to this much
+};
+
+// Decides which players' latest state a client is sent each tick, when there's more changing than its bandwidth
+// budget allows.
+// Every player with an update the client hasn't seen yet builds up priority each tick it goes unsent, at a rate
+// that falls off with its distance from the client. Each tick the highest accumulated priorities are sent until
+// the budget runs out, and reset to zero. Nearby players win most ticks so stay at full rate, distant ones still
+// get through eventually because their priority keeps growing while they wait. Only the newest state is ever
+// sent, so an update superseded while waiting costs nothing.
+// The budget is a token bucket refilled at bytesPerSecond, so a client's bandwidth stays flat however many
+// players there are. One per client, not thread safe, meant to be used by the tick.
+class PriorityAccumulator
+{
+public:
+    PriorityAccumulator()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        priority.fill(0.f);
+        changed.fill(false);
+        budgetBytes = 0;
+        lastRefill = 0;
+        updatesSent = 0;
+        updatesSkipped = 0;
+    }
+
+    // player has a new update this client hasn't been sent
+    inline void MarkChanged(uint8_t player) { changed[player] = true; }
+
+    // player has gone, don't send them again
+    inline void Forget(uint8_t player)
+    {
+        changed[player] = false;
+        priority[player] = 0.f;
+    }
+
+    // Picks this tick's updates for the client at viewer and calls send(uint8_t player) for each, highest
+    // priority first. Returns how many were sent
+    template<typename SendFunc>
+    size_t Select(uint64_t now, const Vector3 &viewer, const std::array<PlayerRecord, 16> &records, const PriorityConfig &config, size_t updateBytes, SendFunc &&send)
+    {
+        Refill(now, config);
+
+        std::array<uint8_t, 16> candidates;
+        size_t count = 0;
+        for (uint8_t player = 0; player < 16; player++)
+        {
+            if (changed[player])
+            {
+                Vector3 offset = records[player].transform.GetPosition();
+                offset -= viewer;
+                const float beyond = std::max(offset.magnitude() - config.nearDistance, 0.f);
+                priority[player] += config.falloffDistance / (config.falloffDistance + beyond);
+                candidates[count++] = player;
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.begin() + count, [this](uint8_t a, uint8_t b) { return priority[a] > priority[b]; });
+        size_t sent = 0;
+        for (; sent < count && budgetBytes >= updateBytes; sent++)
+        {
+            const uint8_t player = candidates[sent];
+            budgetBytes -= static_cast<uint32_t>(updateBytes);
+            priority[player] = 0.f;
+            changed[player] = false;
+            send(player);
+        }
+        updatesSent += sent;
+        updatesSkipped += count - sent;
+        return sent;
+    }
+
+    inline float GetPriority(uint8_t player) const { return priority[player]; }
+    inline uint64_t GetUpdatesSent() const { return updatesSent; }
+    inline uint64_t GetUpdatesSkipped() const { return updatesSkipped; } // Tick-player pairs held back for budget
+
+private:
+    void Refill(uint64_t now, const PriorityConfig &config)
+    {
+        if (lastRefill == 0)
+        {
+            budgetBytes = config.burstBytes; // First tick for this client, start full
+        }
+        else
+        {
+            const uint64_t earned = (now - lastRefill) * config.bytesPerSecond / 1000000;
+            budgetBytes = static_cast<uint32_t>(std::min<uint64_t>(budgetBytes + earned, config.burstBytes));
+        }
+        lastRefill = now;
+    }
+
+    std::array<float, 16> priority;
+    std::array<bool, 16> changed;
+    uint32_t budgetBytes;
+    uint64_t lastRefill;
+    uint64_t updatesSent;
+    uint64_t updatesSkipped;
+};
@@ -1,8 +1,11 @@
 #pragma once
 #include <cstdint>
 #include <ctime>
+#include <cstring>
 #include "Transform.hpp"
 
+// Everything here goes on the wire through the schemas in ProtocolSchema.hpp, keep them in step
+
 /*************************** Protocol Over TCP ***************************/
 enum class TCPMessageType : uint8_t // Might as well keep these small since we don't need to have a million message types
 {
@@ -13,13 +16,16 @@ enum class TCPMessageType : uint8_t // Might as well keep these small since we d
     ConnectTell,
     DisconnectTell, 
     Snapshot,
-    Ping, // Only implement this if you have time
-    Pong // Response to a ping, workout roundtrip time
+    Ping, // Sent periodically by the server, carries its monotonic clock so the client can reply
+    Pong, // Response to a ping, used to work out roundtrip time and clock offset
+    RoomRedirect // From a RoomHost's lobby, which room to connect to instead. The lobby hangs up after sending it
 };
 
 enum class  DisconnectType : uint8_t
 {
-    Standard // Could be expanded to include things like connection timeout or being kicked for too high a ping
+    Standard, // Could be expanded to include things like being kicked for too high a ping
+    Timeout, // Nothing heard from the client for longer than ServerConfig::idleTimeoutMs
+    SlowConsumer // Couldn't keep up with what it was being sent, see ServerConfig::slowConsumerTimeoutMs
 };
 
 #pragma pack(push, 1)
@@ -107,7 +113,7 @@ struct TCPMessageSnapshotData
     TCPMessageSnapshotData() {}
     TCPMessageSnapshotData(PlayerRecord InRecords[16])
     {
-        memcpy(&records, &InRecords, 16);
+        memcpy(records, InRecords, sizeof(records)); // Was copying 16 bytes of the pointer rather than 16 records
     }
     PlayerRecord records[16]; // 16 should technically be the maximum number of users on the server
     // A way to cut this down would be to only send deltas, but this'll work for now
@@ -118,7 +124,34 @@ struct TCPMessageSnapshotData
 struct TCPMessagePingPongData
 {
     TCPMessagePingPongData() {}
-    // Empty
+    TCPMessagePingPongData(uint8_t InId, uint64_t InOriginate, int64_t InClockOffset, uint32_t InSmoothedRtt)
+        : id(InId)
+        , originateTimestamp(InOriginate)
+        , receiveTimestamp(0)
+        , transmitTimestamp(0)
+        , destinationTimestamp(0)
+        , clockOffset(InClockOffset)
+        , smoothedRtt(InSmoothedRtt)
+    {}
+    // All timestamps are microseconds on the monotonic clock of whoever stamped them (see ClockSync.hpp)
+    uint8_t id;
+    uint64_t originateTimestamp; // Server clock, set when the ping is sent. Client echoes it back in the pong
+    uint64_t receiveTimestamp; // Client clock, when the ping arrived
+    uint64_t transmitTimestamp; // Client clock, when the pong was sent
+    uint64_t destinationTimestamp; // Server clock, when the pong arrived. Stamped by the server on receive
+    int64_t clockOffset; // Server's current estimate of (client clock - server clock), lets the client stamp things in server time
+    uint32_t smoothedRtt; // Server's current smoothed rtt estimate for this client, microseconds
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct TCPMessageRoomRedirectData
+{
+    TCPMessageRoomRedirectData() {}
+    TCPMessageRoomRedirectData(uint16_t InRoom, uint16_t InTcpPort, uint16_t InUdpPort) : room(InRoom), tcpPort(InTcpPort), udpPort(InUdpPort) {}
+    uint16_t room;
+    uint16_t tcpPort; // Same host as the lobby
+    uint16_t udpPort;
 };
 #pragma pack(pop)
 
@@ -133,6 +166,7 @@ union TCPMessageData
     TCPMessageDisconnectTellData disconnectTellData;
     TCPMessageSnapshotData snapshotData;
     TCPMessagePingPongData pingPongData;
+    TCPMessageRoomRedirectData roomRedirectData;
 };
 
 #pragma pack(push, 1)
@@ -151,8 +185,12 @@ enum class UDPMessageType : uint8_t
 {
     PlayerUpdate,
     ActuallyUpdate,
-    StillThere,
-    StillHere
+    StillThere, // Heartbeat probe from the server when a client has gone quiet
+    StillHere, // Client's answer to StillThere, keeps its slot alive
+    Reliable, // A control message sent through a ReliableChannel, for clients that don't have a TCP connection
+    Ack, // Acknowledges Reliable messages when there is nothing to piggyback the ack on
+    Ping, // Clock sync for clients without a TCP connection, as the TCP Ping and Pong but never resent, so a
+    Pong // late resend can't end up in the rtt. A lost one is just a missed sample
 };
 
 enum class UDPMessageSender : uint8_t
@@ -192,6 +230,42 @@ struct UDPStillHereData
 };
 #pragma pack(pop)
 
+// Ids aren't handed out until the handshake has been handled, so a client's first Reliable message uses this
+#define UDPUnassignedId 0xFF
+
+// The control messages that can travel over UDP. Anything carried here has the same layout as in TCPMessageData,
+// the snapshot is left out because it would make every datagram the size of a snapshot
+union UDPReliableControlData
+{
+    UDPReliableControlData() {}
+    TCPMessageIWantToConnectIPv4Data ipv4ConnectData; // The host/service are ignored, the datagram's source address is used
+    TCPMessageYouAreConnectedData youAreConnectedData;
+    TCPMessageIAmDisconnectingData iAmDisconnectingData;
+    TCPMessageConnectTellData connectTellData;
+    TCPMessageDisconnectTellData disconnectTellData;
+};
+
+#pragma pack(push, 1)
+struct UDPReliableData
+{
+    uint8_t id; // The client this connection belongs to (in both directions), UDPUnassignedId until it has one
+    uint16_t sequence; // Wrapping sequence number of this message
+    uint16_t ack; // Most recent sequence received from the other end
+    uint32_t ackBits; // Bit n set if sequence (ack - 1 - n) has also been received
+    TCPMessageType controlType;
+    UDPReliableControlData control;
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct UDPAckData
+{
+    uint8_t id;
+    uint16_t ack;
+    uint32_t ackBits;
+};
+#pragma pack(pop)
+
 union UDPMessageData
 {
     UDPMessageData() {}
@@ -199,15 +273,34 @@ union UDPMessageData
     UDPActuallyUpdate actuallyUpdateData;
     UDPStillThereData stillThereData;
     UDPStillHereData stillHereData;
+    UDPReliableData reliableData;
+    UDPAckData ackData;
+    TCPMessagePingPongData pingPongData;
 };
 
 #pragma pack(push, 1)
 struct UDPMessage
 {
     UDPMessageType type;
+    uint16_t sequence; // Wrapping per client counter on PlayerUpdates, relays keep the original sender's. Unused otherwise
     uint64_t unixTimestamp;
     UDPMessageData data;
 };
 #pragma pack(pop)
 
 #define UDPMessageSize sizeof(UDPMessage)
+
+// Everything the server sends over UDP goes out batched, a UDPBatchHeader followed by count UDPMessages,
+// so a tick's worth of updates for a client costs a datagram or two rather than one per update.
+// Clients still send single UDPMessages
+#pragma pack(push, 1)
+struct UDPBatchHeader
+{
+    uint8_t count;
+};
+#pragma pack(pop)
+
+// Largest datagram the server will build. 1200 leaves room for IPv6 and tunnel headers under a 1280 byte MTU,
+// anything bigger risks fragmentation (or being dropped) somewhere along the way
+#define UDPMaxDatagramSize 1200
+#define UDPMessagesPerDatagram ((UDPMaxDatagramSize - sizeof(UDPBatchHeader)) / sizeof(UDPMessage))
@@ -0,0 +1,182 @@
+#pragma once
+#include "Schema.hpp"
+#include "Protocol.hpp"
+
+// Wire schemas for everything in Protocol.hpp. Encode/decode is generated from these (see Schema.hpp), and every
+// struct is checked below to take up exactly as many bytes in memory as on the wire, which is what lets little
+// endian hosts skip straight to memcpy. Adding a message type means adding its enum value to WireEnum here, its
+// data struct's schema, and a row in the union tables in ProtocolSchema.cpp.
+
+/*************************** Enums ***************************/
+template<> struct WireEnum<TCPMessageType> { static const size_t Count = static_cast<size_t>(TCPMessageType::RoomRedirect) + 1; };
+template<> struct WireEnum<DisconnectType> { static const size_t Count = static_cast<size_t>(DisconnectType::SlowConsumer) + 1; };
+template<> struct WireEnum<UDPMessageType> { static const size_t Count = static_cast<size_t>(UDPMessageType::Pong) + 1; };
+template<> struct WireEnum<UDPMessageSender> { static const size_t Count = static_cast<size_t>(UDPMessageSender::Server) + 1; };
+
+/*************************** Shared ***************************/
+template<> struct WireSchema<Vector3>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(Vector3, x), MINISERVER_WIRE_FIELD(Vector3, y), MINISERVER_WIRE_FIELD(Vector3, z)>;
+};
+template<> struct WireSchema<Rotation>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(Rotation, deg), MINISERVER_WIRE_FIELD(Rotation, axis)>;
+};
+template<> struct WireSchema<TransformInheritance>
+{
+    using Fields = WireFields<
+        MINISERVER_WIRE_FIELD(TransformInheritance, InheritPosition),
+        MINISERVER_WIRE_FIELD(TransformInheritance, InheritScale),
+        MINISERVER_WIRE_FIELD(TransformInheritance, InheritRotation),
+        MINISERVER_WIRE_FIELD(TransformInheritance, InheritPreRotation)>;
+};
+template<> struct WireSchema<Transform>
+{
+    using Fields = WireFields<
+        MINISERVER_WIRE_FIELD(Transform, pos),
+        MINISERVER_WIRE_FIELD(Transform, scale),
+        MINISERVER_WIRE_FIELD(Transform, rotation),
+        MINISERVER_WIRE_FIELD(Transform, preRotation),
+        MINISERVER_WIRE_FIELD(Transform, transformInheritance)>;
+};
+template<> struct WireSchema<PlayerRecord>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(PlayerRecord, id), MINISERVER_WIRE_FIELD(PlayerRecord, transform)>;
+};
+
+/*************************** TCP ***************************/
+template<> struct WireSchema<TCPMessageIWantToConnectIPv4Data>
+{
+    using Fields = WireFields<
+        MINISERVER_WIRE_FIELD(TCPMessageIWantToConnectIPv4Data, id),
+        MINISERVER_WIRE_FIELD(TCPMessageIWantToConnectIPv4Data, host),
+        MINISERVER_WIRE_FIELD(TCPMessageIWantToConnectIPv4Data, service)>;
+};
+template<> struct WireSchema<TCPMessageIWantToConnectIPv6Data>
+{
+    using Fields = WireFields<
+        MINISERVER_WIRE_FIELD(TCPMessageIWantToConnectIPv6Data, id),
+        MINISERVER_WIRE_FIELD(TCPMessageIWantToConnectIPv6Data, host),
+        MINISERVER_WIRE_FIELD(TCPMessageIWantToConnectIPv6Data, service)>;
+};
+template<> struct WireSchema<TCPMessageYouAreConnectedData>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(TCPMessageYouAreConnectedData, id)>;
+};
+template<> struct WireSchema<TCPMessageIAmDisconnectingData>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(TCPMessageIAmDisconnectingData, id)>;
+};
+template<> struct WireSchema<TCPMessageConnectTellData>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(TCPMessageConnectTellData, newPlayer)>;
+};
+template<> struct WireSchema<TCPMessageDisconnectTellData>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(TCPMessageDisconnectTellData, id), MINISERVER_WIRE_FIELD(TCPMessageDisconnectTellData, disconnectType)>;
+};
+template<> struct WireSchema<TCPMessageSnapshotData>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(TCPMessageSnapshotData, records)>;
+};
+template<> struct WireSchema<TCPMessagePingPongData>
+{
+    using Fields = WireFields<
+        MINISERVER_WIRE_FIELD(TCPMessagePingPongData, id),
+        MINISERVER_WIRE_FIELD(TCPMessagePingPongData, originateTimestamp),
+        MINISERVER_WIRE_FIELD(TCPMessagePingPongData, receiveTimestamp),
+        MINISERVER_WIRE_FIELD(TCPMessagePingPongData, transmitTimestamp),
+        MINISERVER_WIRE_FIELD(TCPMessagePingPongData, destinationTimestamp),
+        MINISERVER_WIRE_FIELD(TCPMessagePingPongData, clockOffset),
+        MINISERVER_WIRE_FIELD(TCPMessagePingPongData, smoothedRtt)>;
+};
+template<> struct WireSchema<TCPMessageRoomRedirectData>
+{
+    using Fields = WireFields<
+        MINISERVER_WIRE_FIELD(TCPMessageRoomRedirectData, room),
+        MINISERVER_WIRE_FIELD(TCPMessageRoomRedirectData, tcpPort),
+        MINISERVER_WIRE_FIELD(TCPMessageRoomRedirectData, udpPort)>;
+};
+
+// type, timestamp, then whichever member of data type says, zero filled out to the size of the union
+template<>
+struct WireCodec<TCPMessage>
+{
+    static const size_t Size = 1 + 8 + sizeof(TCPMessageData);
+    static void Encode(const TCPMessage &value, uint8_t *out);
+    static bool Decode(const uint8_t *in, TCPMessage &value);
+    static bool Validate(const TCPMessage &value);
+};
+template<> struct WireClearUnused<TCPMessage> { static void Clear(const TCPMessage &value, uint8_t *out); };
+
+/*************************** UDP ***************************/
+template<> struct WireSchema<UDPPlayerUpdateData>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(UDPPlayerUpdateData, playerData), MINISERVER_WIRE_FIELD(UDPPlayerUpdateData, sender)>;
+};
+template<> struct WireSchema<UDPActuallyUpdate>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(UDPActuallyUpdate, playerData), MINISERVER_WIRE_FIELD(UDPActuallyUpdate, sender)>;
+};
+template<> struct WireSchema<UDPStillThereData>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(UDPStillThereData, sender)>;
+};
+template<> struct WireSchema<UDPStillHereData>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(UDPStillHereData, id), MINISERVER_WIRE_FIELD(UDPStillHereData, sender)>;
+};
+template<> struct WireSchema<UDPAckData>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(UDPAckData, id), MINISERVER_WIRE_FIELD(UDPAckData, ack), MINISERVER_WIRE_FIELD(UDPAckData, ackBits)>;
+};
+template<> struct WireSchema<UDPBatchHeader>
+{
+    using Fields = WireFields<MINISERVER_WIRE_FIELD(UDPBatchHeader, count)>;
+};
+
+// The fixed fields, then the control message controlType says. Snapshots and IPv6 connects can't go this way
+template<>
+struct WireCodec<UDPReliableData>
+{
+    static const size_t Size = 1 + 2 + 2 + 4 + 1 + sizeof(UDPReliableControlData);
+    static void Encode(const UDPReliableData &value, uint8_t *out);
+    static bool Decode(const uint8_t *in, UDPReliableData &value);
+    static bool Validate(const UDPReliableData &value);
+};
+
+// type, sequence, timestamp, then whichever member of data type says, zero filled out to the size of the union
+template<>
+struct WireCodec<UDPMessage>
+{
+    static const size_t Size = 1 + 2 + 8 + sizeof(UDPMessageData);
+    static void Encode(const UDPMessage &value, uint8_t *out);
+    static bool Decode(const uint8_t *in, UDPMessage &value);
+    static bool Validate(const UDPMessage &value);
+};
+template<> struct WireClearUnused<UDPMessage> { static void Clear(const UDPMessage &value, uint8_t *out); };
+
+/*************************** Layout checks ***************************/
+static_assert(WireSize<Vector3>::value == sizeof(Vector3), "Vector3 has padding");
+static_assert(WireSize<Rotation>::value == sizeof(Rotation), "Rotation has padding");
+static_assert(WireSize<Transform>::value == sizeof(Transform), "Transform has padding, or a member missing from its schema");
+static_assert(WireSize<PlayerRecord>::value == sizeof(PlayerRecord), "PlayerRecord has padding, or a member missing from its schema");
+static_assert(WireSize<TCPMessageIWantToConnectIPv4Data>::value == sizeof(TCPMessageIWantToConnectIPv4Data), "Schema out of step with struct");
+static_assert(WireSize<TCPMessageIWantToConnectIPv6Data>::value == sizeof(TCPMessageIWantToConnectIPv6Data), "Schema out of step with struct");
+static_assert(WireSize<TCPMessageYouAreConnectedData>::value == sizeof(TCPMessageYouAreConnectedData), "Schema out of step with struct");
+static_assert(WireSize<TCPMessageIAmDisconnectingData>::value == sizeof(TCPMessageIAmDisconnectingData), "Schema out of step with struct");
+static_assert(WireSize<TCPMessageConnectTellData>::value == sizeof(TCPMessageConnectTellData), "Schema out of step with struct");
+static_assert(WireSize<TCPMessageDisconnectTellData>::value == sizeof(TCPMessageDisconnectTellData), "Schema out of step with struct");
+static_assert(WireSize<TCPMessageSnapshotData>::value == sizeof(TCPMessageSnapshotData), "Schema out of step with struct");
+static_assert(WireSize<TCPMessagePingPongData>::value == sizeof(TCPMessagePingPongData), "Schema out of step with struct");
+static_assert(WireSize<TCPMessageRoomRedirectData>::value == sizeof(TCPMessageRoomRedirectData), "Schema out of step with struct");
+static_assert(WireSize<TCPMessage>::value == sizeof(TCPMessage), "Schema out of step with struct");
+static_assert(WireSize<UDPPlayerUpdateData>::value == sizeof(UDPPlayerUpdateData), "Schema out of step with struct");
+static_assert(WireSize<UDPActuallyUpdate>::value == sizeof(UDPActuallyUpdate), "Schema out of step with struct");
+static_assert(WireSize<UDPStillThereData>::value == sizeof(UDPStillThereData), "Schema out of step with struct");
+static_assert(WireSize<UDPStillHereData>::value == sizeof(UDPStillHereData), "Schema out of step with struct");
+static_assert(WireSize<UDPAckData>::value == sizeof(UDPAckData), "Schema out of step with struct");
+static_assert(WireSize<UDPReliableData>::value == sizeof(UDPReliableData), "Schema out of step with struct");
+static_assert(WireSize<UDPBatchHeader>::value == sizeof(UDPBatchHeader), "Schema out of step with struct");
+static_assert(WireSize<UDPMessage>::value == sizeof(UDPMessage), "Schema out of step with struct");
+static_assert(sizeof(UDPBatchHeader) + UDPMessagesPerDatagram * WireSize<UDPMessage>::value <= UDPMaxDatagramSize, "Batches overflow the datagram");
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "Protocol.hpp"
+
+// How control messages wait in the server's tcpMessageChannel between whichever thread received them and Tick.
+// A TCPMessage is always the size of a snapshot, nearly 1KB even for a one byte IAmDisconnecting, and the server
+// never reads a snapshot's records (clients have no business sending one), so they're left out here and the
+// biggest thing left is a ConnectTell's PlayerRecord. Same idea as UDPReliableControlData, plus the IPv6 connect
+union QueuedTCPMessageData
+{
+    QueuedTCPMessageData() {}
+    TCPMessageIWantToConnectIPv4Data ipv4ConnectData;
+    TCPMessageIWantToConnectIPv6Data ipv6ConnectData;
+    TCPMessageYouAreConnectedData youAreConnectedData;
+    TCPMessageIAmDisconnectingData iAmDisconnectingData;
+    TCPMessageConnectTellData connectTellData;
+    TCPMessageDisconnectTellData disconnectTellData;
+    TCPMessagePingPongData pingPongData;
+    TCPMessageRoomRedirectData roomRedirectData;
+};
+
+struct QueuedTCPMessage
+{
+    uint64_t unixTimestamp; // First, so the rest packs in behind it
+    TCPMessageType type;
+    QueuedTCPMessageData data;
+};
+
+static_assert(sizeof(QueuedTCPMessage) <= sizeof(TCPMessage) / 8, "Queued messages are meant to be a fraction of a snapshot");
+
+// Every member has the same layout as in TCPMessageData, so the payload is copied straight across. A snapshot
+// keeps its type and loses its records
+inline QueuedTCPMessage MakeQueuedTCPMessage(const TCPMessage &msg)
+{
+    QueuedTCPMessage queued;
+    queued.unixTimestamp = msg.unixTimestamp;
+    queued.type = msg.type;
+    memcpy(static_cast<void*>(&queued.data), &msg.data, sizeof(QueuedTCPMessageData));
+    return queued;
+}
+
+// Whatever a client sends that names a client is about the one that sent it, so the id comes from the connection
+// it arrived on, never the message, and nobody can disconnect someone else or redirect their datagrams.
+// UDPUnassignedId (which Tick ignores) if the connection hasn't been given an id yet
+inline void StampSender(QueuedTCPMessage &msg, uint8_t id)
+{
+    switch (msg.type)
+    {
+    case TCPMessageType::IWantToConnectIPv4: msg.data.ipv4ConnectData.id = id; break;
+    case TCPMessageType::IWantToConnectIPv6: msg.data.ipv6ConnectData.id = id; break;
+    case TCPMessageType::IAmDisconnecting: msg.data.iAmDisconnectingData.id = id; break;
+    case TCPMessageType::Pong: msg.data.pingPongData.id = id; break;
+    default: break;
+    }
+}
+
+// Back to the full thing, for the capture file. Whatever the queued form doesn't hold is zeroed
+inline TCPMessage MakeTCPMessage(const QueuedTCPMessage &queued)
+{
+    TCPMessage msg;
+    memset(static_cast<void*>(&msg), 0, sizeof(TCPMessage));
+    msg.unixTimestamp = queued.unixTimestamp;
+    msg.type = queued.type;
+    memcpy(static_cast<void*>(&msg.data), &queued.data, sizeof(QueuedTCPMessageData));
+    return msg;
+}
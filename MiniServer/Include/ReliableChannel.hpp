@@ -0,0 +1,147 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include "Protocol.hpp"
+#include "SequenceNumber.hpp"
+
+// Reliable, ordered delivery of control messages over the UDP socket, so a client doesn't need a TCP connection
+// (and its socket, kernel buffers and head of line blocking) just for the handful of control messages.
+// Every Reliable packet carries its own sequence number plus an ack of the latest sequence received from the
+// other side and a bitfield of the 32 before it, so one packet getting through acks a whole run of them.
+// Unacked messages are resent once the retransmit timeout (srtt + 4 * rttvar, backed off per resend) runs out,
+// and received messages are held back until everything before them has arrived so they come out in order.
+// Messages waiting for room in the window queue in a fixed backlog, so sending never allocates on the tick.
+// A client that lets the backlog fill, or leaves a message unacked through MaxSends sends, is stalled and
+// should be disconnected.
+// One of these per client, owned and driven by the tick thread.
+class ReliableChannel
+{
+public:
+    static const uint16_t WindowSize = 32; // Most messages in flight at once, matches the width of ackBits
+    static const uint16_t BacklogSize = 64; // Most messages waiting behind a full window
+    static const uint8_t MaxSends = 10; // With the backoff, 159 rtos from the first send until the channel gives up
+
+    ReliableChannel()
+    {
+        Reset(UDPUnassignedId);
+    }
+
+    void Reset(uint8_t InId);
+
+    // Queue a control message. It goes out on the next Update. Dropped, and the channel stalled, if the backlog is full
+    void Send(TCPMessageType type, const UDPReliableControlData &data);
+
+    // Take in a Reliable or Ack packet from the other end
+    void Receive(const UDPMessage &packet, uint64_t now);
+
+    // Pull the next message in order, if it has arrived
+    bool Deliver(TCPMessageType &type, UDPReliableControlData &data);
+
+    // Send anything new or due a resend, and a bare Ack if we owe one and had nothing to piggyback it on.
+    // send is called with each UDPMessage to put on the wire
+    template<typename SendFunc>
+    void Update(uint64_t now, uint64_t minRto, SendFunc &&send)
+    {
+        const uint64_t rto = GetRetransmitTimeout(minRto);
+        bool sentAnything = false;
+        for (uint16_t seq = oldestUnacked; seq != nextSendSequence; seq++)
+        {
+            OutgoingMessage &out = sendWindow[seq % WindowSize];
+            if (!out.inFlight)
+            {
+                continue;
+            }
+            const unsigned int backoff = out.sends < 6 ? out.sends : 6;
+            if (out.sends == 0 || now - out.lastSent >= (rto << (backoff > 0 ? backoff - 1 : 0)))
+            {
+                if (out.sends >= MaxSends)
+                {
+                    stalled = true; // They aren't acking, sending it again won't help
+                    continue;
+                }
+                UDPMessage packet;
+                BuildPacket(out, packet);
+                send(packet);
+                if (out.sends > 0) retransmits++;
+                out.lastSent = now;
+                out.sends++;
+                sentAnything = true;
+            }
+        }
+        if (ackPending && !sentAnything)
+        {
+            UDPMessage packet;
+            packet.type = UDPMessageType::Ack;
+            packet.sequence = 0;
+            packet.unixTimestamp = 0;
+            packet.data.ackData.id = id;
+            packet.data.ackData.ack = remoteLatest;
+            packet.data.ackData.ackBits = receivedBits;
+            send(packet);
+        }
+        ackPending = false;
+    }
+
+    inline uint64_t GetRetransmitTimeout(uint64_t minRto) const
+    {
+        uint64_t rto = hasRttSample ? smoothedRtt + 4 * rttVariance : minRto * 4;
+        return rto < minRto ? minRto : rto;
+    }
+    inline uint64_t GetSmoothedRtt() const { return smoothedRtt; }
+    inline size_t GetUnackedCount() const { return static_cast<uint16_t>(nextSendSequence - oldestUnacked) + backlogCount; }
+    inline bool IsStalled() const { return stalled; }
+    inline uint64_t GetRetransmitCount() const { return retransmits; }
+
+private:
+    struct OutgoingMessage
+    {
+        bool inFlight;
+        uint16_t sequence;
+        uint8_t sends;
+        uint64_t lastSent;
+        TCPMessageType type;
+        UDPReliableControlData data;
+    };
+
+    struct IncomingMessage
+    {
+        bool present;
+        uint16_t sequence;
+        TCPMessageType type;
+        UDPReliableControlData data;
+    };
+
+    struct BackloggedMessage
+    {
+        TCPMessageType type;
+        UDPReliableControlData data;
+    };
+
+    void BuildPacket(const OutgoingMessage &out, UDPMessage &packet);
+    void ProcessAck(uint16_t ack, uint32_t ackBits, uint64_t now);
+    void Acknowledge(uint16_t sequence, uint64_t now);
+    void FillWindow();
+
+    uint8_t id;
+
+    // Sending side
+    std::array<OutgoingMessage, WindowSize> sendWindow;
+    std::array<BackloggedMessage, BacklogSize> backlog; // Waiting for room in the window, a ring from backlogHead
+    uint16_t backlogHead;
+    uint16_t backlogCount;
+    bool stalled;
+    uint16_t nextSendSequence;
+    uint16_t oldestUnacked;
+    uint64_t smoothedRtt;
+    uint64_t rttVariance;
+    bool hasRttSample;
+    uint64_t retransmits;
+
+    // Receiving side
+    std::array<IncomingMessage, WindowSize> receiveWindow;
+    uint16_t nextDeliverSequence;
+    uint16_t remoteLatest;
+    uint32_t receivedBits;
+    bool hasReceived;
+    bool ackPending;
+};
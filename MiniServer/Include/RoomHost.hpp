@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include "Server.hpp"
+#include "ThreadAffinity.hpp"
+
+struct RoomHostConfig
+{
+    RoomHostConfig()
+        : roomCount(std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1)
+        , lobbyPort(4443)
+        , firstRoomPort(4444)
+        , tickIntervalMs(16)
+        , pinThreads(true)
+    {}
+
+    uint32_t roomCount;
+    uint16_t lobbyPort; // TCP, where clients connect first to be told which room is theirs
+    uint16_t firstRoomPort; // Room n listens on firstRoomPort + n, for TCP and UDP both
+    uint32_t tickIntervalMs;
+    bool pinThreads; // Room n's tick thread runs on core n % cores
+    ServerConfig roomConfig; // What each room's Server is created with, apart from the ports. worldExportName, capturePath, ipcSocketPath and spectatorPort have the room's index added
+};
+
+// Runs a number of independent rooms (matches) in one process. Each room is a whole Server with its own io_service,
+// player slots and channels, ticked by its own thread pinned to its own core, and nothing is shared between rooms,
+// so they never wait on each other and throughput goes up with the number of cores.
+// Clients connect to the lobby first, which sends them a RoomRedirect to whichever room has the fewest players and
+// hangs up. The lobby only reads each room's player count, an atomic the room's tick thread updates after each tick
+class RoomHost
+{
+public:
+    explicit RoomHost(const RoomHostConfig &InConfig = RoomHostConfig());
+    ~RoomHost();
+
+    void Start();
+    void Stop(); // Waits for every room to finish its tick and shut down
+
+    inline size_t GetRoomCount() const { return rooms.size(); }
+    inline uint64_t GetTickCount(size_t room) const { return rooms[room]->ticks.load(std::memory_order_relaxed); }
+    inline uint32_t GetPlayerCount(size_t room) const { return rooms[room]->players.load(std::memory_order_relaxed); }
+
+private:
+    struct Room
+    {
+        Room() : ticks(0), players(0) {}
+        boost::asio::io_service ioService;
+        pThread tickThread;
+        std::atomic<uint64_t> ticks;
+        std::atomic<uint32_t> players;
+    };
+
+    void RoomThreadFunc(Room &room, uint32_t index);
+    void LobbyAccept();
+    void lobbyHandleAccept(const boost::system::error_code &error);
+
+    RoomHostConfig config;
+    std::vector<UniquePtr<Room>> rooms;
+    std::atomic<bool> stopping;
+
+    boost::asio::io_service lobbyService;
+    tcp::acceptor lobbyAcceptor;
+    tcp::socket lobbySocket; // Clients are redirected one at a time, they only get one message
+    pThread lobbyThread;
+};
@@ -5,7 +5,7 @@ class Rotation
 {
 public:
     Rotation() : deg(0), axis(0.0f, 0.0f, 0.0f) {}
-    Rotation(float d, Vector3& ax) : deg(d), axis(ax) {}
+    Rotation(float d, const Vector3& ax) : deg(d), axis(ax) {}
     float deg;
     Vector3 axis;
 };
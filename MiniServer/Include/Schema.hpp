@@ -0,0 +1,310 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+// Compile time description of how structs go on the wire, and the encode/decode that falls out of it.
+// The wire format is little endian with no padding, fields in declaration order, floats as their IEEE 754 bits.
+// That is exactly the in memory layout of a #pragma pack(1) struct on a little endian host, so there a whole
+// message can be memcpy'd (see MINISERVER_LITTLE_ENDIAN) and the field by field path is only needed elsewhere.
+//
+// A struct is described by specialising WireSchema with a WireFields list:
+//     template<> struct WireSchema<Foo> { using Fields = WireFields<MINISERVER_WIRE_FIELD(Foo, a), MINISERVER_WIRE_FIELD(Foo, b)>; };
+// Enums need a WireEnum specialisation giving how many values are valid, so decode can reject anything else.
+// Unions can't be described like this, since which member is live depends on something outside them, those get
+// a hand written WireCodec which picks the member through a WireUnionCase table (see ProtocolSchema.hpp).
+
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define MINISERVER_LITTLE_ENDIAN 1
+#else
+#define MINISERVER_LITTLE_ENDIAN 0
+#endif
+
+static_assert(std::numeric_limits<float>::is_iec559 && sizeof(float) == 4, "The wire format assumes IEEE 754 floats");
+
+template<typename T> struct WireSchema; // Specialise for each struct that goes on the wire
+template<typename T> struct WireEnum; // Specialise for each enum, with static const size_t Count
+
+template<typename Owner, typename Type, Type Owner::*Member>
+struct WireField
+{
+    using OwnerType = Owner;
+    using FieldType = Type;
+    static const Type &Get(const Owner &owner) { return owner.*Member; }
+    static Type &Get(Owner &owner) { return owner.*Member; }
+};
+#define MINISERVER_WIRE_FIELD(Owner, member) WireField<Owner, decltype(Owner::member), &Owner::member>
+
+template<typename... Fields>
+struct WireFields {};
+
+template<typename T, typename Enable = void>
+struct WireCodec;
+
+// Bytes T takes on the wire
+template<typename T>
+struct WireSize
+{
+    static const size_t value = WireCodec<T>::Size;
+};
+
+// Unsigned integers, everything else is built on these
+template<typename T>
+struct WireCodec<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type>
+{
+    static const size_t Size = sizeof(T);
+
+    static void Encode(const T &value, uint8_t *out)
+    {
+        for (size_t i = 0; i < sizeof(T); i++)
+        {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+    static bool Decode(const uint8_t *in, T &value)
+    {
+        T result = 0;
+        for (size_t i = 0; i < sizeof(T); i++)
+        {
+            result |= static_cast<T>(in[i]) << (8 * i);
+        }
+        value = result;
+        return true;
+    }
+    static bool Validate(const T &) { return true; }
+};
+
+// Signed integers as their two's complement bits (char included, it's only ever used for strings)
+template<typename T>
+struct WireCodec<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type>
+{
+    using Bits = typename std::make_unsigned<T>::type;
+    static const size_t Size = sizeof(T);
+
+    static void Encode(const T &value, uint8_t *out)
+    {
+        Bits bits;
+        memcpy(&bits, &value, sizeof(T));
+        WireCodec<Bits>::Encode(bits, out);
+    }
+    static bool Decode(const uint8_t *in, T &value)
+    {
+        Bits bits;
+        WireCodec<Bits>::Decode(in, bits);
+        memcpy(&value, &bits, sizeof(T));
+        return true;
+    }
+    static bool Validate(const T &) { return true; }
+};
+
+template<>
+struct WireCodec<float>
+{
+    static const size_t Size = 4;
+
+    static void Encode(const float &value, uint8_t *out)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        WireCodec<uint32_t>::Encode(bits, out);
+    }
+    static bool Decode(const uint8_t *in, float &value)
+    {
+        uint32_t bits;
+        WireCodec<uint32_t>::Decode(in, bits);
+        memcpy(&value, &bits, sizeof(bits));
+        return true;
+    }
+    static bool Validate(const float &) { return true; }
+};
+
+template<>
+struct WireCodec<bool>
+{
+    static const size_t Size = 1;
+
+    static void Encode(const bool &value, uint8_t *out) { out[0] = value ? 1 : 0; }
+    static bool Decode(const uint8_t *in, bool &value)
+    {
+        value = in[0] != 0;
+        return in[0] <= 1;
+    }
+    static bool Validate(const bool &value) { uint8_t byte; memcpy(&byte, &value, 1); return byte <= 1; }
+};
+
+// Enums go as their underlying type, and only values below WireEnum<T>::Count are accepted
+template<typename T>
+struct WireCodec<T, typename std::enable_if<std::is_enum<T>::value>::type>
+{
+    using Underlying = typename std::underlying_type<T>::type;
+    static const size_t Size = sizeof(Underlying);
+
+    static void Encode(const T &value, uint8_t *out)
+    {
+        WireCodec<Underlying>::Encode(static_cast<Underlying>(value), out);
+    }
+    static bool Decode(const uint8_t *in, T &value)
+    {
+        Underlying raw;
+        WireCodec<Underlying>::Decode(in, raw);
+        value = static_cast<T>(raw);
+        return Validate(value);
+    }
+    static bool Validate(const T &value)
+    {
+        return static_cast<size_t>(static_cast<Underlying>(value)) < WireEnum<T>::Count;
+    }
+};
+
+template<typename T, size_t N>
+struct WireCodec<T[N]>
+{
+    static const size_t Size = WireSize<T>::value * N;
+
+    static void Encode(const T (&value)[N], uint8_t *out)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            WireCodec<T>::Encode(value[i], out + i * WireSize<T>::value);
+        }
+    }
+    static bool Decode(const uint8_t *in, T (&value)[N])
+    {
+        bool ok = true;
+        for (size_t i = 0; i < N; i++)
+        {
+            ok &= WireCodec<T>::Decode(in + i * WireSize<T>::value, value[i]);
+        }
+        return ok;
+    }
+    static bool Validate(const T (&value)[N])
+    {
+        bool ok = true;
+        for (size_t i = 0; i < N; i++)
+        {
+            ok &= WireCodec<T>::Validate(value[i]);
+        }
+        return ok;
+    }
+};
+
+// Walks a WireFields list, each field following straight on from the last
+template<typename FieldList>
+struct WireFieldsCodec;
+
+template<>
+struct WireFieldsCodec<WireFields<>>
+{
+    static const size_t Size = 0;
+    template<typename Owner> static void Encode(const Owner &, uint8_t *) {}
+    template<typename Owner> static bool Decode(const uint8_t *, Owner &) { return true; }
+    template<typename Owner> static bool Validate(const Owner &) { return true; }
+};
+
+template<typename First, typename... Rest>
+struct WireFieldsCodec<WireFields<First, Rest...>>
+{
+    using FieldCodec = WireCodec<typename First::FieldType>;
+    using RestCodec = WireFieldsCodec<WireFields<Rest...>>;
+    static const size_t Size = FieldCodec::Size + RestCodec::Size;
+
+    template<typename Owner>
+    static void Encode(const Owner &owner, uint8_t *out)
+    {
+        FieldCodec::Encode(First::Get(owner), out);
+        RestCodec::Encode(owner, out + FieldCodec::Size);
+    }
+    template<typename Owner>
+    static bool Decode(const uint8_t *in, Owner &owner)
+    {
+        // Each field is read in full before it's stored, so in may point at owner itself
+        const bool ok = FieldCodec::Decode(in, First::Get(owner));
+        return RestCodec::Decode(in + FieldCodec::Size, owner) && ok;
+    }
+    template<typename Owner>
+    static bool Validate(const Owner &owner)
+    {
+        return FieldCodec::Validate(First::Get(owner)) && RestCodec::Validate(owner);
+    }
+};
+
+// Anything with a WireSchema
+template<typename T>
+struct WireCodec<T, typename std::enable_if<std::is_class<typename WireSchema<T>::Fields>::value>::type>
+{
+    using Fields = WireFieldsCodec<typename WireSchema<T>::Fields>;
+    static const size_t Size = Fields::Size;
+
+    static void Encode(const T &value, uint8_t *out) { Fields::Encode(value, out); }
+    static bool Decode(const uint8_t *in, T &value) { return Fields::Decode(in, value); }
+    static bool Validate(const T &value) { return Fields::Validate(value); }
+};
+
+// One row of a union's dispatch table, for the member Member of Union
+template<typename Union>
+struct WireUnionCase
+{
+    void (*encode)(const Union &, uint8_t *);
+    bool (*decode)(const uint8_t *, Union &);
+    bool (*validate)(const Union &);
+    size_t size;
+};
+
+template<typename Union, typename Type, Type Union::*Member>
+struct WireUnionMember
+{
+    static void Encode(const Union &value, uint8_t *out) { WireCodec<Type>::Encode(value.*Member, out); }
+    static bool Decode(const uint8_t *in, Union &value) { return WireCodec<Type>::Decode(in, value.*Member); }
+    static bool Validate(const Union &value) { return WireCodec<Type>::Validate(value.*Member); }
+    static constexpr WireUnionCase<Union> Case() { return { &Encode, &Decode, &Validate, WireSize<Type>::value }; }
+};
+#define MINISERVER_WIRE_UNION_CASE(Union, member) WireUnionMember<Union, decltype(Union::member), &Union::member>::Case()
+
+// Messages holding a union specialise this to zero whatever follows the live member once the memcpy path has
+// copied it, as encoding field by field does, so nothing left over in memory goes out on the wire
+template<typename T>
+struct WireClearUnused
+{
+    static void Clear(const T &, uint8_t *) {}
+};
+
+// Whole messages. Sizes are fixed, so decode wants exactly WireSize bytes. On little endian hosts the struct
+// already is the wire format, so it's a memcpy plus checking the enums (and encode zeroing any unused union
+// bytes), elsewhere it goes field by field.
+// in may be the same memory as out (e.g. a receive buffer being decoded where it is)
+template<typename T>
+inline size_t WireEncode(const T &value, uint8_t *out, size_t capacity)
+{
+    if (capacity < WireSize<T>::value)
+    {
+        return 0;
+    }
+#if MINISERVER_LITTLE_ENDIAN
+    static_assert(WireSize<T>::value == sizeof(T), "Wire and memory layout must match for the memcpy path");
+    memcpy(out, &value, sizeof(T));
+    WireClearUnused<T>::Clear(value, out);
+#else
+    WireCodec<T>::Encode(value, out);
+#endif
+    return WireSize<T>::value;
+}
+
+template<typename T>
+inline bool WireDecode(const uint8_t *in, size_t size, T &value)
+{
+    if (size != WireSize<T>::value)
+    {
+        return false;
+    }
+#if MINISERVER_LITTLE_ENDIAN
+    if (in != reinterpret_cast<const uint8_t*>(&value))
+    {
+        memcpy(&value, in, sizeof(T));
+    }
+    return WireCodec<T>::Validate(value);
+#else
+    return WireCodec<T>::Decode(in, value);
+#endif
+}
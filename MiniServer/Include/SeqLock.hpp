@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <type_traits>
+
+// One writer publishing a value for any number of readers, without either side ever waiting on a lock.
+// The sequence is odd while a write is in progress. A reader copies the value out between two reads of the
+// sequence and keeps it only if both were the same even number, otherwise it was torn by a write and the reader
+// goes again. Writes are never held up by readers, so this suits a tick publishing state that other threads look
+// at now and then.
+// The value is kept as relaxed atomic words, which compile to plain loads and stores but mean a torn read is
+// only ever a stale word rather than undefined behaviour. Nothing in here points anywhere, so it can live in
+// memory shared between processes just as well (see WorldExport)
+template<typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock copies its value a word at a time");
+
+public:
+    SeqLock()
+        : sequence(0)
+    {
+        for (auto &word : words)
+        {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Writer only
+    void Publish(const T &value)
+    {
+        uint64_t buffer[WordCount] = {};
+        memcpy(buffer, &value, sizeof(T));
+        const uint32_t start = sequence.load(std::memory_order_relaxed);
+        sequence.store(start + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release); // Readers that see any new word see the odd sequence
+        for (size_t i = 0; i < WordCount; i++)
+        {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+        sequence.store(start + 2, std::memory_order_release);
+    }
+
+    // Any thread. False if a write got in the way, the caller can try again straight away
+    bool TryRead(T &out) const
+    {
+        const uint32_t before = sequence.load(std::memory_order_acquire);
+        if ((before & 1) != 0)
+        {
+            return false;
+        }
+        uint64_t buffer[WordCount];
+        for (size_t i = 0; i < WordCount; i++)
+        {
+            buffer[i] = words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire); // Word loads can't drift past the second look at the sequence
+        if (sequence.load(std::memory_order_relaxed) != before)
+        {
+            return false;
+        }
+        memcpy(&out, buffer, sizeof(T));
+        return true;
+    }
+
+    // Any thread. Retries until it gets a whole value, a write only takes as long as copying one
+    void Read(T &out) const
+    {
+        while (!TryRead(out))
+        {
+        }
+    }
+
+    // How many values have been published, for a reader to tell whether there's anything new
+    inline uint32_t GetVersion() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+    static const size_t WordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint64_t> words[WordCount];
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+// Comparisons for wrapping 16 bit sequence numbers. a is newer than b if it is ahead by less than half the range,
+// so 0 counts as newer than 65535 and things keep working across the wrap
+inline bool SequenceGreaterThan(const uint16_t a, const uint16_t b)
+{
+    return ((a > b) && (a - b <= 32768)) || ((a < b) && (b - a > 32768));
+}
+
+inline bool SequenceLessThan(const uint16_t a, const uint16_t b)
+{
+    return SequenceGreaterThan(b, a);
+}
+
+// How far a is ahead of b, assuming it is
+inline uint16_t SequenceDistance(const uint16_t a, const uint16_t b)
+{
+    return static_cast<uint16_t>(a - b);
+}
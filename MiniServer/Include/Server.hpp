@@ -1,9 +1,29 @@
 #pragma once
 #include <unordered_map>
-#include "TCPConnection.hpp"
+#include "Transport.hpp"
+#include "UniquePtr.hpp"
 #include "IdPool.hpp"
+#include "Clock.hpp"
+#include "ClockSync.hpp"
+#include "ServerConfig.hpp"
+#include "TimingWheel.hpp"
+#include "TransformHistory.hpp"
+#include "Capture.hpp"
+#include "FrameArena.hpp"
+#include "ReliableChannel.hpp"
+#include "PacketAggregator.hpp"
+#include "JitterBuffer.hpp"
+#include "UDPReceivePool.hpp"
+#include "PriorityAccumulator.hpp"
+#include "SeqLock.hpp"
+#include "WorldExport.hpp"
+#include "SpectatorRelay.hpp"
+#include "HandlerAllocator.hpp"
 #include <thread>
 #include <functional>
+#include <mutex>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp> // For async timers
 
 
@@ -11,62 +31,223 @@ using pThread = UniquePtr<std::thread>;
 using boost::asio::ip::tcp;
 using boost::asio::ip::udp;
 
-class Server : public boost::enable_shared_from_this<Server>
+// Server logic only, the traffic comes and goes through a Transport. Unless one is passed in the server opens
+// real sockets (SocketTransport), plus shared memory for local clients if ServerConfig::ipcSocketPath is set
+// (ShmTransport), and runs io_service on a thread of its own. Or nothing at all when offline
+class Server : public TransportHandler, public boost::enable_shared_from_this<Server>
 {
 public:
-    Server(boost::asio::io_service &io_service);
+    // InTransport isn't owned, and is started here. Nothing runs io_service for it, so it has to do all its work
+    // on the tick thread (in Poll and Flush) or from whoever is driving the ticks, as MemoryTransport does
+    Server(boost::asio::io_service &io_service, const ServerConfig &InConfig = ServerConfig(), Transport *InTransport = nullptr);
     ~Server();
 
     // Tick is called each frame to process any messages sitting in the message channels
     // Tick can respond to messages, but otherwise messages are sent on a timer 
     bool Tick();
+    bool Tick(uint64_t now); // As above, but with the tick's time supplied rather than read from the clock
+
+    // Feed a capture back through Tick as fast as it will go. Meant for offline servers (ServerConfig::offline)
+    // so nothing is actually sent anywhere. replayed is the number of records replayed. False if the capture
+    // stopped making sense, e.g. a client connected with an id that's still in use, in which case it stops there
+    bool Replay(CaptureReader &reader, uint64_t &replayed);
+
+    // Latest rtt/jitter/clock offset estimate for a client, fed by the periodic pings
+    const ClockSync &GetClockSync(uint8_t id) const { return clockSync[id]; }
+
+    // Lag compensation, rewinds every player to where they were at a server time. RewindForPlayer takes a
+    // timestamp on that player's own clock (e.g. when they fired) and converts it using their clock offset
+    bool Rewind(uint64_t serverTime, TransformFrame &out) const { return transformHistory.Sample(serverTime, out); }
+    bool RewindForPlayer(uint8_t id, uint64_t clientTimestamp, TransformFrame &out) const
+    {
+        return transformHistory.Sample(clockSync[id].ToServerTime(clientTimestamp), out);
+    }
+
+    // How much copying the UDP receive path does once the kernel has written a datagram into its slab.
+    // Doesn't count the capture, which is a copy on purpose
+    struct ReceiveStats
+    {
+        uint64_t packets; // Handled by the tick
+        uint64_t bytesCopied;
+        uint64_t dropped; // Malformed, or arrived while every slab was in use
+    };
+    ReceiveStats GetReceiveStats() const { return { udpPacketsHandled, udpBytesCopied, udpPacketsDropped.load(std::memory_order_relaxed) }; }
+
+    // io_uring_enter calls made by the io_uring UDP backend, 0 when it isn't in use (asio doesn't keep count)
+    uint64_t GetUDPSyscallCount() const
+    {
+        uint64_t syscalls = 0;
+        for (const Transport *transport : transports)
+        {
+            syscalls += transport->GetSyscallCount();
+        }
+        return syscalls;
+    }
+
+    // The players as of the end of a tick, published for other threads, which can't look at the tick's copy
+    // while it's being changed
+    struct WorldState
+    {
+        uint64_t tick;
+        std::array<PlayerRecord, 16> records;
+        std::array<bool, 16> active;
+    };
+    // Any thread, never holds up the tick. The last tick to finish, or how things were set up if none has yet
+    void ReadWorld(WorldState &out) const { publishedWorld.Read(out); }
+
+    // Connected clients, as of the last tick
+    uint32_t GetPlayerCount()
+    {
+        std::unique_lock<std::mutex> lock(idPoolMutex);
+        return idPool.GetNumUsed();
+    }
 
 private:
     void ioServiceThreadFunc()
     {
+        Trace::SetThreadName("Server io");
         ioService->run();
     }
 
-    void StartAccepting();
-    void tcpHandleAccept(SharedPtr<TCPConnection> newConnection, const boost::system::error_code &error);
+    // TransportHandler, called from wherever the transport receives (the io thread for SocketTransport)
+    void OnStreamAccepted(SharedPtr<StreamConnection> newConnection) override;
+    bool OnDatagram(uint16_t slab, std::size_t bytesTransferred, const udp::endpoint &from) override;
+    void OnDatagramDropped() override;
 
-    void udpInit(boost::asio::io_service &io_service);
-    void udpSend(UDPMessage &msg, udp::endpoint udpEndpoint);
-    void udpReceive();
-    void udpHandleReceive(const boost::system::error_code &error, std::size_t bytesTransferred);
-    void udpHandleSend(const boost::system::error_code &error, std::size_t bytesTransferred);
+    // UDP sends are batched per client and only go out when the tick flushes them (or a batch fills up)
+    void udpQueue(uint8_t id, const UDPMessage &msg);
+    void udpFlush();
+    void udpSendDatagram(uint8_t id, UDPSendBuffer *buffer);
+    void udpSetEndpoint(uint8_t id, const udp &protocol, const std::string &host, const std::string &service); // Where a TCP client wants its datagrams
     void udpHandleResolve(const boost::system::error_code &error, udp::resolver::iterator endpointIter, const uint8_t id);
 
 
+    // A stream connection a transport accepted, on whichever thread it accepts on, for the tick to take on. Offline
+    // there's no connection, just the id Replay is bringing back
+    struct PendingStream
+    {
+        SharedPtr<StreamConnection> connection;
+        uint8_t replayId;
+    };
+    // What SendSnapshots sends to, the tick's tcpConnections as of the last time they changed. Never changed once
+    // published, the tick makes a new one instead
+    using StreamConnections = std::array<SharedPtr<StreamConnection>, 16>;
+
+    // A UDP-only client's first Reliable message, which needs the address it came from to set the client up.
+    // From Replay it comes with the id the capture says it was given, if any
+    struct PendingHandshake
+    {
+        UDPMessage msg;
+        udp::endpoint endpoint;
+        bool replayed;
+        uint8_t replayId;
+    };
+
+    // Dispatch through a table of the handlers below, indexed by message type
+    void tcpHandleMessage(QueuedTCPMessage &msg, uint64_t now);
+    bool udpHandleMessage(UDPMessage &msg, uint16_t slab, uint64_t now); // Returns true if it held on to the slab
+
+    void tcpHandleConnectIPv4(QueuedTCPMessage &msg, uint64_t now);
+    void tcpHandleConnectIPv6(QueuedTCPMessage &msg, uint64_t now);
+    void tcpHandleDisconnecting(QueuedTCPMessage &msg, uint64_t now);
+    void tcpHandlePong(QueuedTCPMessage &msg, uint64_t now);
+    void HandlePong(const TCPMessagePingPongData &data, uint64_t now); // From either, a clock sync sample
+    void tcpHandleUnexpected(QueuedTCPMessage &msg, uint64_t now);
+    bool udpHandlePlayerUpdate(UDPMessage &msg, uint16_t slab, uint64_t now);
+    bool udpHandleStillHere(UDPMessage &msg, uint16_t slab, uint64_t now);
+    bool udpHandleReliable(UDPMessage &msg, uint16_t slab, uint64_t now); // Reliable and Ack
+    bool udpHandlePong(UDPMessage &msg, uint16_t slab, uint64_t now);
+    bool udpHandleUnexpected(UDPMessage &msg, uint16_t slab, uint64_t now);
+    void ApplyPlayerUpdate(UDPMessage &msg); // Called as each PlayerUpdate comes out of its client's jitter buffer
+    void udpHandleHandshake(PendingHandshake &handshake, uint64_t now);
+    void udpDeliverReliable(uint8_t id, uint64_t now);
+
+    // Sends a control message down whichever connection the client has, TCP if there is one, reliable UDP otherwise
+    void SendControl(uint8_t id, TCPMessage &msg);
+    void AcceptStream(PendingStream &pending, uint64_t now);
+    void PublishStreamConnections(); // After tcpConnections changes
+    void OnPlayerConnected(uint8_t id, uint64_t now);
+    bool ReserveId(uint8_t &id);
+    bool ReserveReplayId(uint8_t id); // The id a client was given when the capture was made, fails the replay if it's taken
+    void ReleaseId(uint8_t id);
+
+    void PublishWorld(); // End of each tick, see ReadWorld
     void SendSnapshots();
+    void SendPlayerUpdates(uint64_t now); // Each client's budget's worth of the updates applied so far, most important first
+    void SendPings(uint64_t now);
 
-    boost::asio::deadline_timer tcpSnapshotTimer;
-    bool timerActive;
+    // Everything time based that isn't tied to the io_service goes through the timing wheel, which is advanced each tick
+    enum class ScheduledEventType : uint8_t
+    {
+        Heartbeat, // Probe a quiet client with StillThere
+        IdleTimeout // Check whether a client has been quiet for too long, and drop it if so
+    };
 
-    boost::array<uint8_t, sizeof(UDPMessage)> udpRecvBuffer;
-    boost::array<uint8_t, sizeof(UDPMessage)> udpSendBuffer;
+    struct ScheduledEvent
+    {
+        ScheduledEventType type;
+        uint8_t id;
+    };
+    using EventWheel = TimingWheel<ScheduledEvent>;
+
+    void StartPlayerTimers(uint8_t id, uint64_t now);
+    void HandleScheduledEvent(const ScheduledEvent &event, uint64_t now);
+    void DisconnectPlayer(uint8_t id, DisconnectType reason);
+
+    boost::asio::deadline_timer tcpSnapshotTimer;
+    HandlerMemory snapshotTimerHandler;
+    std::atomic<bool> timerActive;
+
+    UDPReceivePool udpReceivePool;
+    std::atomic<uint64_t> udpPacketsDropped;
+    uint64_t udpPacketsHandled;
+    uint64_t udpBytesCopied;
+    UDPSendBufferPool udpSendPool;
+    std::array<PacketAggregator, 16> udpAggregators;
     std::array<udp::endpoint, 16> udpConnections;
-    std::array<SharedPtr<TCPConnection>, 16> tcpConnections;
+    StreamConnections tcpConnections; // Tick thread only
+    std::mutex publishedConnectionsMutex; // Only held to swap or copy the pointer
+    SharedPtr<StreamConnections> publishedConnections;
     boost::asio::io_service *ioService;
-    udp::socket udpSocket;
-    udp::endpoint remoteEndpoint;
-    tcp::acceptor acceptor;
+    std::vector<Transport*> transports; // Sends go through the first that owns the endpoint, none offline
+    std::vector<std::unique_ptr<Transport>> ownedTransports; // Those the server made for itself, when one wasn't passed in
+    UniquePtr<SpectatorRelay> spectators; // Gets each snapshot once, however many are watching, if ServerConfig::spectatorPort is set
 
     IdPool idPool;
+    std::mutex idPoolMutex; // Only the tick hands ids out, this is for GetPlayerCount
+    bool replayFailed; // See ReserveReplayId
 
-    Channel<UDPMessage, std::stack<UDPMessage> > udpMessageChannel;
-    Channel<TCPMessage, std::queue<TCPMessage> > tcpMessageChannel;
-
-    struct PlayerRecordHistory // Name is maybe a little ambiguous, tracks the last time a record was updated, and if it has been updated this frame
-    {
-        bool UpdatedThisFrame;
-        uint64_t timestamp;
-    };
+    Channel<PendingStream, std::queue<PendingStream> > streamAcceptChannel;
+    Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > tcpMessageChannel;
+    Channel<PendingHandshake, std::queue<PendingHandshake> > udpHandshakeChannel;
 
-    std::array<PlayerRecord, 16> playerRecords;
+    std::array<PlayerRecord, 16> playerRecords; // Tick thread only, everyone else reads publishedWorld
+    SeqLock<WorldState> publishedWorld;
+    WorldExportWriter worldExport; // The same again for other processes, if ServerConfig::worldExportName is set
     std::array<PlayerRecord, 16> oldPlayerRecords;
     std::array<bool, 16> activePlayers;
-    std::array<PlayerRecordHistory, 16> playerRecordHistory;
+    std::array<JitterBuffer<uint16_t>, 16> jitterBuffers; // Slabs of incoming PlayerUpdates, ordered by sequence and applied at a steady rate
+    std::array<ClockSync, 16> clockSync;
+    std::array<ReliableChannel, 16> reliableChannels;
+    std::array<bool, 16> udpOnlyClients; // Connected with a Reliable handshake, control messages go over reliableChannels
+    std::array<PriorityAccumulator, 16> updatePriorities; // Which players each client hears about next
+    std::array<uint16_t, 16> latestSequences; // Of each player's last applied update, relayed with it
+    PriorityConfig priorityConfig;
+
+    ServerConfig config;
+    uint64_t nextPingTime;
+    uint64_t tickCount;
+    uint64_t ticksWithHeapAllocations; // Only with MINISERVER_COUNT_ALLOCATIONS, see AllocationTracker.hpp
+    uint64_t nextAllocationWarningTime;
+    uint64_t traceBatches; // Datagrams sent while tracing, for their flow ids
+
+    TransformHistory transformHistory;
+    CaptureWriter captureWriter;
+
+    EventWheel timerWheel;
+    std::array<uint64_t, 16> lastHeardFrom; // Monotonic time of the last message of any kind from each client
+    std::array<EventWheel::TimerHandle, 16> heartbeatTimers;
+    std::array<EventWheel::TimerHandle, 16> idleTimers;
 
     pThread ioServiceThread;
 };
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Tunables for the server, the defaults are what we actually run with
+struct ServerConfig
+{
+    ServerConfig()
+        : pingIntervalMs(1000)
+        , timerResolutionMs(10)
+        , heartbeatIntervalMs(2000)
+        , idleTimeoutMs(10000)
+        , historyFrames(64)
+        , historyIntervalMs(16)
+        , captureIndexIntervalMs(1000)
+        , offline(false)
+        , tcpPort(4443)
+        , udpPort(4443)
+        , udpShards(1)
+        , udpIoUring(false)
+        , tcpEnabled(true)
+        , reliableMinRtoMs(50)
+        , jitterBufferDepth(2)
+        , jitterIntervalMs(16)
+        , tcpSendQueueBytes(64 * 1024)
+        , slowConsumerTimeoutMs(5000)
+        , snapshotIntervalMs(200)
+        , updateBytesPerSecond(48 * 1024)
+        , updateBurstBytes(2400)
+        , priorityNearDistance(10.f)
+        , priorityFalloffDistance(50.f)
+        , spectatorPort(0)
+        , spectatorDelayMs(0)
+        , allocationFreeAfterTicks(0)
+    {}
+
+    uint32_t pingIntervalMs; // How often every connected client is pinged to refresh its rtt and clock offset
+    uint32_t timerResolutionMs; // Granularity of the timing wheel, nothing scheduled on it can be more precise than this
+    uint32_t heartbeatIntervalMs; // Send a StillThere to any client we haven't heard from in this long
+    uint32_t idleTimeoutMs; // Drop any client we haven't heard from in this long
+    uint32_t historyFrames; // Frames of player transforms kept for lag compensation (rounded up to a power of two)
+    uint32_t historyIntervalMs; // Gap between those frames, so rewinds reach back historyFrames * historyIntervalMs
+    std::string capturePath; // If set, everything Tick handles is recorded here (see Capture.hpp)
+    uint32_t captureIndexIntervalMs; // Capture time between seek index entries
+    bool offline; // Don't open any sockets or start the io thread, for replaying captures
+    uint16_t tcpPort;
+    uint16_t udpPort;
+    uint16_t udpShards; // UDP sockets sharing udpPort, each with its own receive thread. More than 1 needs SO_REUSEPORT (Linux)
+    bool udpIoUring; // Linux: UDP goes through io_uring on the tick thread instead of asio, udpShards is ignored. TCP stays on asio either way
+    bool tcpEnabled; // Accept TCP clients. Clients can always connect over UDP alone with a Reliable handshake
+    std::string ipcSocketPath; // Linux: also take clients on this host over shared memory (see ShmTransport), attaching through a Unix socket here. Empty for none
+    std::string worldExportName; // Linux: publish every tick's players to this shared memory object (shm_open name, see WorldExport.hpp) for local read only consumers. Empty for none
+    uint32_t reliableMinRtoMs; // Floor on the retransmit timeout for Reliable control messages
+    uint16_t jitterBufferDepth; // PlayerUpdates held back per client before they start being applied, trades latency for smoothness
+    uint32_t jitterIntervalMs; // One buffered PlayerUpdate is applied per this, should match the clients' send rate
+    uint32_t tcpSendQueueBytes; // Cap on what can be waiting to go out to each TCP client, so slow clients can't eat memory
+    uint32_t slowConsumerTimeoutMs; // Drop a TCP client whose send queue has stayed over half full for this long
+    uint32_t snapshotIntervalMs; // How often TCP clients are sent a full snapshot
+    uint32_t updateBytesPerSecond; // Each client's bandwidth for other players' updates, see PriorityAccumulator
+    uint32_t updateBurstBytes; // How much unspent update budget a client can save up, a couple of datagrams is plenty
+    float priorityNearDistance; // Players within this distance of a client get its updates at full priority
+    float priorityFalloffDistance; // Beyond that priority falls off, halving this much further out
+    uint16_t spectatorPort; // Serve the snapshot stream read only to spectators and relays on this port (see SpectatorRelay), 0 for none
+    uint32_t spectatorDelayMs; // How long spectators on spectatorPort are kept behind the game
+    uint32_t allocationFreeAfterTicks; // Testing: abort, with AllocationTracker's report, if any tick after this many touches the heap. Needs MINISERVER_COUNT_ALLOCATIONS, 0 for off
+};
@@ -491,7 +491,7 @@ public:
     // Assignment operator adds a weak reference to the object referenced by the specified weak pointer
     inline WeakPtr& operator=(WeakPtr const& InWeakPtr)
     {
-        Object = InWeakPtr.Pin.Get();
+        Object = InWeakPtr.Pin().Get();
         WeakReferenceCount = InWeakPtr.WeakReferenceCount;
         return *this;
     }
@@ -538,7 +538,7 @@ public:
     template<class OtherType>
     inline WeakPtr& operator=(SharedPtr<OtherType> const& InSharedPtr)
     {
-        Object InSharedPTr.Object;
+        Object = InSharedPtr.Object;
         WeakReferenceCount = InSharedPtr.SharedReferenceCount;
         return *this;
     }
@@ -775,7 +775,7 @@ inline bool operator==(WeakPtr<ObjectTypeA> const& InWeakPtrA, decltype(nullptr)
 template<class ObjectTypeB>
 inline bool operator==(decltype(nullptr), WeakPtr<ObjectTypeB> const& InWeakPtrB)
 {
-    return !InWeakPTrB.IsValid();
+    return !InWeakPtrB.IsValid();
 }
 
 // WeakPtr != WeakPTr
@@ -863,3 +863,17 @@ inline RawPtrProxy<ObjectType> MakeShareable(ObjectType* InObject, DeleterType&&
 {
     return RawPtrProxy<ObjectType>(InObject, Forward<DeleterType>(InDeleter));
 }
+
+// For boost::bind and mem_fn, so a member function can be bound to a shared reference or pointer rather than a
+// raw this, and the object stays alive as long as whatever holds the binding (e.g. an asio handler) does
+template<class ObjectType>
+inline ObjectType* get_pointer(SharedRef<ObjectType> const& InSharedRef)
+{
+    return &InSharedRef.Get();
+}
+
+template<class ObjectType>
+inline ObjectType* get_pointer(SharedPtr<ObjectType> const& InSharedPtr)
+{
+    return InSharedPtr.Get();
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <atomic>
 // Heavily inspired by the Unreal Engine implementation
 
 #define FORCE_THREADSAFE_SHAREDPTRS 0
@@ -32,9 +33,11 @@ public:
         , Object(InOject)
     { }
 
-    int32_t SharedReferenceCount;
+    // Atomic, a pointer can be copied and dropped on more than one thread (connections are handed from the io
+    // thread to the tick and back), as long as each SharedPtr object itself is only used by one at a time
+    std::atomic<int32_t> SharedReferenceCount;
 
-    int32_t WeakReferenceCount;
+    std::atomic<int32_t> WeakReferenceCount;
 
     void* Object;
 
@@ -81,7 +84,7 @@ inline ReferenceControllerBase* NewDefaultReferenceController(ObjectType* Object
 template< typename ObjectType, typename DeleterType >
 inline ReferenceControllerBase* NewDefaultReferenceController(ObjectType* Object, DeleterType&& Deleter)
 {
-    return new ReferenceControllerWithDeleter<ObjectType, typename RemoveReference<DeleterType>::Type>(Object, Forward< DeleteType >(Deleter));
+    return new ReferenceControllerWithDeleter<ObjectType, typename RemoveReference<DeleterType>::Type>(Object, Forward< DeleterType >(Deleter));
 }
 
 template< class ObjectType >
@@ -106,28 +109,30 @@ struct ReferenceControllerOps
 {
     static inline const int32_t GetSharedReferenceCount(const ReferenceControllerBase* ReferenceController)
     {
-        return ReferenceController->SharedReferenceCount;
+        return ReferenceController->SharedReferenceCount.load(std::memory_order_relaxed);
     }
 
     static inline void AddSharedReference(ReferenceControllerBase* ReferenceController)
     {
-        ++ReferenceController->SharedReferenceCount;
+        ReferenceController->SharedReferenceCount.fetch_add(1, std::memory_order_relaxed);
     }
 
     static bool ConditionallyAddSharedReference(ReferenceControllerBase* ReferenceController)
     {
-        if (ReferenceController->SharedReferenceCount == 0)
+        int32_t count = ReferenceController->SharedReferenceCount.load(std::memory_order_relaxed);
+        do
         {
-            return false;
-        }
-
-        ++ReferenceController->SharedReferenceCount;
+            if (count == 0)
+            {
+                return false;
+            }
+        } while (!ReferenceController->SharedReferenceCount.compare_exchange_weak(count, count + 1, std::memory_order_relaxed));
         return true;
     }
 
     static inline void ReleaseSharedReference(ReferenceControllerBase* ReferenceController)
     {
-        if (--ReferenceController->SharedReferenceCount == 0)
+        if (ReferenceController->SharedReferenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
         {
             ReferenceController->DestroyObject();
             ReleaseWeakReference(ReferenceController);
@@ -136,12 +141,12 @@ struct ReferenceControllerOps
 
     static inline void AddWeakReference(ReferenceControllerBase* ReferenceController)
     {
-        ++ReferenceController->WeakReferenceCount;
+        ReferenceController->WeakReferenceCount.fetch_add(1, std::memory_order_relaxed);
     }
 
     static void ReleaseWeakReference(ReferenceControllerBase* ReferenceController)
     {
-        if (--ReferenceController->WeakReferenceCount == 0)
+        if (ReferenceController->WeakReferenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
         {
             delete ReferenceController;
         }
@@ -173,14 +178,7 @@ public:
         InWeakRefCountPointer.ReferenceController = nullptr;
     }
 
-    inline WeakReferencer(SharedReferencer const& InSharedRefCountPointer)
-        : ReferenceController(InSharedRefCountPointer.ReferenceController)
-    {
-        if (ReferenceController != nullptr)
-        {
-            TOps::AddWeakReference(ReferenceController);
-        }
-    }
+    inline WeakReferencer(SharedReferencer const& InSharedRefCountPointer); // Below SharedReferencer, which has to be complete first
 
     inline ~WeakReferencer()
     {
@@ -209,11 +207,7 @@ public:
         return *this;
     }
 
-    inline WeakReferencer& operator=(SharedReferencer const & InSharedReference)
-    {
-        AssignReferenceController(InSharedReference.ReferenceController);
-        return *this;
-    }
+    inline WeakReferencer& operator=(SharedReferencer const & InSharedReference);
 
     inline const bool IsValid() const
     {
@@ -333,6 +327,23 @@ private:
     ReferenceControllerBase* ReferenceController;
 };
 
+template<ESPMode Mode>
+inline WeakReferencer<Mode>::WeakReferencer(SharedReferencer const& InSharedRefCountPointer)
+    : ReferenceController(InSharedRefCountPointer.ReferenceController)
+{
+    if (ReferenceController != nullptr)
+    {
+        TOps::AddWeakReference(ReferenceController);
+    }
+}
+
+template<ESPMode Mode>
+inline WeakReferencer<Mode>& WeakReferencer<Mode>::operator=(SharedReferencer const & InSharedReference)
+{
+    AssignReferenceController(InSharedReference.ReferenceController);
+    return *this;
+}
+
 template<class SharedPtrType, class ObjectType, class  OtherType>
 inline void EnableSharedFromThis(SharedPtr<SharedPtrType> const* InSharedPtr, ObjectType const* InObject, SharedFromThis<OtherType> const* InShareable)
 {
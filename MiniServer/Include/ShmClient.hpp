@@ -0,0 +1,82 @@
+#pragma once
+#ifdef __linux__
+#include <string>
+#include "ShmRing.hpp"
+#include "ProtocolSchema.hpp"
+
+// A local process's end of ShmTransport (ServerConfig::ipcSocketPath). Behaves like a client with a TCP connection:
+// the server says who it is with YouAreConnected, after which this asks for its datagrams just as a socket client
+// would with IWantToConnectIPv4. Everything in and out is Protocol.hpp messages, sent without any network stack.
+// One thread only, the rings have one writer and one reader at each end
+class ShmClient
+{
+public:
+    ShmClient();
+    ~ShmClient();
+
+    ShmClient(const ShmClient&) = delete;
+    ShmClient &operator=(const ShmClient&) = delete;
+
+    bool Attach(const std::string &socketPath);
+    void Detach(); // The server finds out straight away, and tells everyone else the client left
+    inline bool IsAttached() const { return segment != nullptr; }
+    inline uint8_t GetId() const { return id; } // UDPUnassignedId until the server says
+
+    // False if the ring's full, nothing is sent
+    bool SendControl(TCPMessage &msg);
+    bool SendDatagram(const UDPMessage &msg);
+
+    // Waits up to timeoutMs (-1 for as long as it takes, 0 not at all) for anything from the server, then calls
+    // onControl(TCPMessage&) for each control message and onDatagram(const uint8_t*, size_t) for each datagram,
+    // which is a UDPBatchHeader and its messages just as one would arrive over UDP. Returns how many there were,
+    // 0 if the server has gone as well as on timing out, see IsAttached
+    template<typename ControlFunc, typename DatagramFunc>
+    size_t Receive(int timeoutMs, ControlFunc &&onControl, DatagramFunc &&onDatagram)
+    {
+        if (segment == nullptr || !Wait(timeoutMs))
+        {
+            return 0;
+        }
+        bool corrupt;
+        const size_t count = segment->toClient.ReadAll([&](ShmFrameKind kind, const uint8_t *bytes, size_t size)
+        {
+            if (kind == ShmFrameKind::Datagram)
+            {
+                onDatagram(bytes, size);
+                return true;
+            }
+            TCPMessage msg;
+            if (!WireDecode(bytes, size, msg))
+            {
+                return true;
+            }
+            if (msg.type == TCPMessageType::YouAreConnected)
+            {
+                OnConnected(msg.data.youAreConnectedData.id);
+            }
+            onControl(msg);
+            return true;
+        }, corrupt);
+        if (corrupt)
+        {
+            Detach(); // Can't be trusted to be in step any more
+        }
+        return count;
+    }
+
+    inline uint64_t GetWakeups() const { return wakeups; } // eventfd writes to the server
+
+private:
+    bool Write(ShmFrameKind kind, const uint8_t *bytes, size_t size);
+    bool Wait(int timeoutMs); // True if there's something to read
+    void OnConnected(uint8_t InId);
+
+    int socketFd;
+    int toServerEvent;
+    int toClientEvent;
+    ShmSegment *segment;
+    uint16_t slot;
+    uint8_t id;
+    uint64_t wakeups;
+};
+#endif
@@ -0,0 +1,158 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+
+// What a ShmTransport client and the server share: one memfd per client holding a ring each way. Frames are the
+// same bytes the sockets would carry, a wire encoded TCPMessage for control messages or a datagram exactly as it
+// would be sent over UDP, so both ends speak Protocol.hpp unchanged.
+// Each ring has one writer and one reader. The reader only sleeps on its eventfd after setting waiting and seeing
+// the ring still empty, and the writer only signals it when it sees waiting set after publishing, so a busy reader
+// never costs the writer a syscall.
+// Both processes use these atomics, so they have to be lock free rather than backed by a lock in one address space
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "Shared memory rings need lock free atomics");
+
+enum class ShmFrameKind : uint8_t
+{
+    Control,
+    Datagram
+};
+
+struct ShmRing
+{
+    static const uint32_t Capacity = 64 * 1024; // Power of two, frames are 4 byte aligned so their headers never wrap
+    static const uint32_t MaxFrameSize = 2048;
+
+    struct FrameHeader
+    {
+        uint16_t size;
+        ShmFrameKind kind;
+        uint8_t unused;
+    };
+
+    // Writer. False if there isn't room, nothing is written. wake is set if the reader needs signalling
+    bool Write(ShmFrameKind kind, const uint8_t *bytes, size_t size, bool &wake)
+    {
+        if (size > MaxFrameSize)
+        {
+            return false;
+        }
+        const uint32_t writePos = tail.load(std::memory_order_relaxed);
+        const uint32_t frameSize = FrameSize(size);
+        if (frameSize > Capacity - (writePos - head.load(std::memory_order_acquire)))
+        {
+            return false;
+        }
+        const FrameHeader frameHeader = { static_cast<uint16_t>(size), kind, 0 };
+        memcpy(&data[writePos & (Capacity - 1)], &frameHeader, sizeof(frameHeader));
+        CopyIn(writePos + sizeof(FrameHeader), bytes, size);
+        tail.store(writePos + frameSize, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst); // Publish before looking at waiting, see PrepareToWait
+        wake = waiting.load(std::memory_order_relaxed) != 0;
+        return true;
+    }
+
+    // Reader. Calls func(ShmFrameKind, const uint8_t*, size_t) for every frame waiting, returns how many. func
+    // returns false to leave that frame (and the rest) where it is, to be read again next time.
+    // The writer is another process and can scribble anything over tail and the frame headers, so neither is
+    // trusted. If tail is further ahead than the ring holds, or a frame is bigger than the writer may send or
+    // runs past tail, reading stops there and corrupt is set. Nothing more should be read from the ring after that
+    template<typename Func>
+    size_t ReadAll(Func &&func, bool &corrupt)
+    {
+        corrupt = false;
+        uint32_t readPos = head.load(std::memory_order_relaxed);
+        const uint32_t end = tail.load(std::memory_order_acquire);
+        if (end - readPos > Capacity)
+        {
+            corrupt = true;
+            return 0;
+        }
+        size_t count = 0;
+        uint8_t scratch[MaxFrameSize]; // Only used for frames that wrap
+        for (; readPos != end; count++)
+        {
+            FrameHeader frameHeader;
+            memcpy(&frameHeader, &data[readPos & (Capacity - 1)], sizeof(frameHeader));
+            if (frameHeader.size > MaxFrameSize || FrameSize(frameHeader.size) > end - readPos)
+            {
+                corrupt = true;
+                break;
+            }
+            const uint32_t start = (readPos + sizeof(FrameHeader)) & (Capacity - 1);
+            const uint8_t *bytes = &data[start];
+            if (start + frameHeader.size > Capacity)
+            {
+                CopyOut(readPos + sizeof(FrameHeader), scratch, frameHeader.size);
+                bytes = scratch;
+            }
+            if (!func(frameHeader.kind, bytes, static_cast<size_t>(frameHeader.size)))
+            {
+                break;
+            }
+            readPos += FrameSize(frameHeader.size);
+        }
+        head.store(readPos, std::memory_order_release);
+        return count;
+    }
+
+    bool Empty() const { return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire); }
+
+    // Reader, before sleeping. Returns false if something arrived meanwhile, in which case don't sleep
+    bool PrepareToWait()
+    {
+        waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!Empty())
+        {
+            waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+    void DoneWaiting() { waiting.store(0, std::memory_order_relaxed); }
+
+    std::atomic<uint32_t> head; // Reader's
+    uint8_t headPadding[60]; // Keeps the two ends' cursors on separate cache lines
+    std::atomic<uint32_t> tail; // Writer's
+    std::atomic<uint32_t> waiting;
+    uint8_t tailPadding[56];
+    uint8_t data[Capacity];
+
+private:
+    static uint32_t FrameSize(size_t size) { return (static_cast<uint32_t>(sizeof(FrameHeader) + size) + 3) & ~3u; }
+
+    void CopyIn(uint32_t pos, const uint8_t *bytes, size_t size)
+    {
+        const uint32_t start = pos & (Capacity - 1);
+        const size_t first = size < Capacity - start ? size : Capacity - start;
+        memcpy(&data[start], bytes, first);
+        memcpy(&data[0], bytes + first, size - first);
+    }
+
+    void CopyOut(uint32_t pos, uint8_t *bytes, size_t size) const
+    {
+        const uint32_t start = pos & (Capacity - 1);
+        const size_t first = size < Capacity - start ? size : Capacity - start;
+        memcpy(bytes, &data[start], first);
+        memcpy(bytes + first, &data[0], size - first);
+    }
+};
+
+// The whole memfd, created zeroed by the server, which is an empty ring each way
+struct ShmSegment
+{
+    ShmRing toServer;
+    ShmRing toClient;
+};
+
+// Sent by the server over the Unix socket a client attaches through, along with the memfd and then the eventfds
+// the server and client sleep on
+struct ShmAttachInfo
+{
+    static const uint32_t CurrentVersion = 1;
+    uint32_t version;
+    uint32_t segmentSize; // sizeof(ShmSegment), so a client built against a different layout can tell
+    uint16_t slot; // The client's datagrams come from ShmTransport::SlotEndpoint(slot) as far as the server's concerned
+};
@@ -0,0 +1,91 @@
+#pragma once
+#ifdef __linux__
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Transport.hpp"
+#include "ShmRing.hpp"
+#include "UniquePtr.hpp"
+
+using boost::asio::ip::udp;
+
+// For processes on the same host (bots, match logic sidecars), which attach as ordinary clients through shared
+// memory rather than loopback sockets (see ShmClient for their side). A client connects to a Unix socket at
+// socketPath and is handed a memfd holding a ShmRing each way, plus an eventfd for each end to sleep on. From then
+// on nothing goes through the network stack, and a message costs a couple of copies and, only when the other end
+// is asleep, an eventfd write.
+// Each client counts as a stream connection, its control messages arriving in the TCP message channel like any
+// TCP client's, and its datagrams come from SlotEndpoint(slot), an address real traffic never has. One thread
+// accepts clients and reads their rings, into shard receiveShard of the receive pool, which has to be its alone
+class ShmTransport : public Transport
+{
+public:
+    static const uint16_t MaxClients = 16;
+
+    ShmTransport(const std::string &InSocketPath, uint16_t InReceiveShard);
+    ~ShmTransport();
+
+    bool Start(TransportHandler &InHandler, UDPReceivePool &InReceivePool, UDPSendBufferPool &sendPool, Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > &InTcpMessageChannel) override;
+    void Stop() override;
+    void Send(UDPSendBuffer *buffer, const udp::endpoint &to) override;
+    bool Owns(const udp::endpoint &to) const override;
+
+    // 0.0.0.0 and a port of slot + 1
+    static udp::endpoint SlotEndpoint(uint16_t slot) { return udp::endpoint(boost::asio::ip::address_v4::any(), static_cast<uint16_t>(slot + 1)); }
+
+    inline uint64_t GetWakeups() const { return wakeups.load(std::memory_order_relaxed); } // eventfd writes to clients
+
+private:
+    friend class ShmConnection;
+
+    struct Slot
+    {
+        Slot()
+            : generation(0)
+            , attached(false)
+            , kicked(false)
+            , clientId(UDPUnassignedId)
+            , socketFd(-1)
+            , toServerEvent(-1)
+            , toClientEvent(-1)
+            , segment(nullptr)
+        {}
+
+        std::mutex sendMutex; // Held by anything writing to the client, or changing who the slot belongs to
+        uint32_t generation; // Bumped each time the slot is freed, so connections to its last client go quiet
+        bool attached;
+        bool kicked; // The server closed the connection, so it doesn't need telling the client left
+        uint8_t clientId; // From YouAreConnected
+        int socketFd;
+        int toServerEvent;
+        int toClientEvent;
+        ShmSegment *segment;
+    };
+
+    void ReceiveThreadFunc();
+    void AcceptClient();
+    void DetachClient(uint16_t slot); // Receive thread, once the client's socket closes
+    bool ReadClient(uint16_t slot); // False if it stopped for want of a slab
+    // Any thread. False if the ring is full or the slot has moved on from generation
+    bool WriteToClient(uint16_t slot, uint32_t generation, ShmFrameKind kind, const uint8_t *bytes, size_t size);
+    bool WriteLocked(Slot &client, ShmFrameKind kind, const uint8_t *bytes, size_t size); // sendMutex held
+    void Kick(uint16_t slot, uint32_t generation);
+    void SetClientId(uint16_t slot, uint32_t generation, uint8_t id);
+
+    std::string socketPath;
+    uint16_t receiveShard;
+    TransportHandler *handler;
+    UDPReceivePool *receivePool;
+    Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > *tcpMessageChannel;
+
+    std::array<Slot, MaxClients> slots;
+    int listenFd;
+    int epollFd;
+    int stopEvent;
+    uint16_t heldSlab; // Rejected last time, so still the receive thread's to fill
+    UniquePtr<std::thread> receiveThread;
+    std::atomic<uint64_t> wakeups;
+};
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <boost/array.hpp>
+#include "Transport.hpp"
+#include "TCPConnection.hpp"
+#include "ServerConfig.hpp"
+#include "UDPUringBackend.hpp"
+
+using boost::asio::ip::udp;
+
+// The real thing. TCP clients are accepted and served through asio on the io_service the server runs, UDP goes
+// through asio sockets (sharded over SO_REUSEPORT, see ServerConfig::udpShards) or io_uring on the tick thread
+// (ServerConfig::udpIoUring)
+class SocketTransport : public Transport
+{
+public:
+    SocketTransport(boost::asio::io_service &io_service, const ServerConfig &InConfig);
+    ~SocketTransport();
+
+    bool Start(TransportHandler &InHandler, UDPReceivePool &InReceivePool, UDPSendBufferPool &sendPool, Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > &InTcpMessageChannel) override;
+    void Stop() override;
+    void Poll() override;
+    void Flush() override;
+    void Send(UDPSendBuffer *buffer, const udp::endpoint &to) override;
+    uint64_t GetSyscallCount() const override; // io_uring_enter calls, 0 when it isn't in use (asio doesn't keep count)
+
+private:
+    void StartAccepting();
+    void tcpHandleAccept(SharedPtr<TCPConnection> newConnection, const boost::system::error_code &error);
+
+    void udpInit();
+    void udpReceive(uint16_t shard); // Into a fresh slab
+    void udpReceiveInto(uint16_t shard, uint16_t slab); // Into one the io thread already holds, after it was rejected
+    void udpHandleReceive(uint16_t shard, uint16_t slab, const boost::system::error_code &error, std::size_t bytesTransferred);
+    void udpHandleSend(UDPSendBuffer *buffer, const boost::system::error_code &error, std::size_t bytesTransferred);
+
+    // One per receive socket. Shard 0 runs on ioService and all the sending goes through it, the rest get an
+    // io_service and a thread each. With more than one the kernel steers each client's datagrams to the shard
+    // for its id (see udpInit), so a client's PlayerUpdates all come through the same queue
+    struct UDPShard
+    {
+        UDPShard(boost::asio::io_service &io_service) : socket(io_service) {}
+        udp::socket socket;
+        udp::endpoint remoteEndpoint;
+        boost::array<uint8_t, sizeof(UDPMessage)> dropBuffer; // Somewhere to put datagrams when there's no slab free, so they can be dropped
+        HandlerMemory receiveHandler; // For the one receive it always has outstanding
+    };
+
+    ServerConfig config;
+    boost::asio::io_service *ioService;
+    TransportHandler *handler;
+    UDPReceivePool *receivePool;
+    Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > *tcpMessageChannel;
+
+    tcp::acceptor acceptor;
+    // Services before the shards, so the sockets registered with them are destroyed first
+    std::vector<std::unique_ptr<boost::asio::io_service>> udpShardServices; // For shards 1 and up
+    std::vector<UniquePtr<std::thread>> udpShardThreads;
+    std::vector<std::unique_ptr<UDPShard>> udpShards;
+#ifdef MINISERVER_IO_URING
+    UniquePtr<UDPUringBackend> udpUring; // Instead of udpShards when ServerConfig::udpIoUring is set
+#endif
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <boost/array.hpp>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ProtocolSchema.hpp"
+#include "SharedRef.hpp"
+#include "HandlerAllocator.hpp"
+
+using boost::asio::ip::tcp;
+
+struct SpectatorRelayConfig
+{
+    SpectatorRelayConfig()
+        : port(4444)
+        , delayMs(0)
+        , maxSubscribers(4096)
+        , upstreamPort(0)
+    {}
+
+    uint16_t port; // Spectators, and relays further down the chain, connect here
+    uint32_t delayMs; // Hold each snapshot back this long before passing it on, on top of any delay upstream
+    uint32_t maxSubscribers; // Connections past this are turned away
+    std::string upstreamHost; // Standalone relays only: a server's spectatorPort or another relay's port, numeric or a name
+    uint16_t upstreamPort;
+};
+
+// Read only snapshot stream for any number of spectators, none of whom take up a player slot. The stream is the
+// same encoded Snapshot messages a TCP client gets, so anything that reads a client's TCP stream can watch.
+// Fed either by the server (ServerConfig::spectatorPort), which hands it each snapshot once, or by connecting to
+// another relay or server as a spectator itself, so relays chain and each one only costs its upstream one
+// connection. Each snapshot is encoded once into a buffer every subscriber's write shares. A subscriber that
+// hasn't finished writing the last one only has the newest waiting for it, snapshots are full state and there's
+// no point catching up on old ones.
+// Everything but Publish runs on the io_service it's given, which has to have stopped before this is destroyed
+class SpectatorRelay
+{
+public:
+    SpectatorRelay(boost::asio::io_service &io_service, const SpectatorRelayConfig &InConfig);
+
+    SpectatorRelay(const SpectatorRelay&) = delete;
+    SpectatorRelay &operator=(const SpectatorRelay&) = delete;
+
+    bool Start(); // Listens, and connects upstream if there is one. False if the port couldn't be had
+    void Stop(); // Closes every connection
+
+    // Any thread. Only the snapshot is copied across, the io thread wraps it for sharing
+    void Publish(const TCPMessage &snapshot);
+
+    // Io thread only, these are for whoever runs the io_service to report on
+    inline size_t GetSubscriberCount() const { return subscribers.size(); }
+    inline uint64_t GetFramesReceived() const { return framesReceived; }
+    inline uint64_t GetFramesSent() const { return framesSent; } // Writes to subscribers, all of them
+    inline uint64_t GetFramesSuperseded() const { return framesSuperseded; } // Replaced before a slow subscriber got to them
+
+private:
+    using Frame = boost::array<uint8_t, WireSize<TCPMessage>::value>;
+
+    struct Subscriber
+    {
+        explicit Subscriber(boost::asio::io_service &io_service) : socket(io_service), closed(false) {}
+        tcp::socket socket;
+        HandlerMemory writeHandler; // A fan out has a write in flight per subscriber, far more than asio's per thread recycling keeps
+        SharedPtr<Frame> sending; // Kept alive until its write finishes
+        SharedPtr<Frame> pending; // The newest since, if there is one
+        bool closed;
+    };
+
+    void StartAccepting();
+    void HandleAccept(const boost::system::error_code &error);
+    void Deliver(const SharedPtr<Frame> &frame); // After the delay, to every subscriber
+    void ReleaseDelayed(const boost::system::error_code &error);
+    void Enqueue(const Frame &bytes); // Io thread, from Publish or upstream
+    void StartWrite(Subscriber &subscriber);
+    void HandleWrite(Subscriber *subscriber, const boost::system::error_code &error);
+    void RemoveClosed();
+
+    void ConnectUpstream();
+    void HandleUpstreamConnect(const boost::system::error_code &error);
+    void HandleUpstreamRead(const boost::system::error_code &error, std::size_t bytesTransferred);
+    void RetryUpstream();
+
+    SpectatorRelayConfig config;
+    boost::asio::io_service *ioService;
+    tcp::acceptor acceptor;
+    std::unique_ptr<Subscriber> accepting; // The next subscriber, until its connection arrives
+    std::vector<std::unique_ptr<Subscriber> > subscribers;
+    SharedPtr<Frame> latest; // What a new subscriber starts with
+    std::deque<std::pair<uint64_t, SharedPtr<Frame> > > delayed; // Due time and frame, oldest first
+    boost::asio::deadline_timer delayTimer;
+
+    tcp::socket upstream;
+    tcp::resolver upstreamResolver;
+    boost::asio::deadline_timer upstreamRetryTimer;
+    Frame upstreamBuffer;
+
+    uint64_t framesReceived;
+    uint64_t framesSent;
+    uint64_t framesSuperseded;
+    bool stopped;
+};
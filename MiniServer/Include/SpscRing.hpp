@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <array>
+
+// Bounded lock free queue for exactly one producer thread and one consumer thread.
+// head is only written by the consumer and tail only by the producer, padded a cache line apart so the two
+// threads aren't fighting over one (padded rather than alignas, so whatever holds one doesn't need aligned new).
+// Capacity must be a power of two, one slot is kept empty to tell full from empty.
+template<typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscRing()
+        : head(0)
+        , tail(0)
+    {}
+
+    // Producer only. Returns false if full
+    bool TryPush(const T &item)
+    {
+        const size_t currentTail = tail.load(std::memory_order_relaxed);
+        const size_t nextTail = (currentTail + 1) & Mask;
+        if (nextTail == head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        items[currentTail] = item;
+        tail.store(nextTail, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if empty
+    bool TryPop(T &item)
+    {
+        const size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = items[currentHead];
+        head.store((currentHead + 1) & Mask, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Hands everything currently queued to callback, publishing the new head once at the end.
+    // Returns how many there were
+    template<typename Callback>
+    size_t PopAll(Callback &&callback)
+    {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        const size_t currentTail = tail.load(std::memory_order_acquire);
+        size_t count = 0;
+        while (currentHead != currentTail)
+        {
+            callback(items[currentHead]);
+            currentHead = (currentHead + 1) & Mask;
+            count++;
+        }
+        head.store(currentHead, std::memory_order_release);
+        return count;
+    }
+
+    // Either side, only a snapshot
+    inline bool Empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+private:
+    static const size_t Mask = Capacity - 1;
+    static const size_t CacheLineSize = 64;
+
+    std::atomic<size_t> head;
+    uint8_t headPadding[CacheLineSize - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+    uint8_t tailPadding[CacheLineSize - sizeof(std::atomic<size_t>)];
+    std::array<T, Capacity> items;
+};
@@ -1,50 +1,89 @@
 #pragma once
-#include <boost\asio.hpp>
-#include <boost\bind.hpp>
-#include <boost\enable_shared_from_this.hpp>
-#include <boost\shared_ptr.hpp>
-#include <boost\array.hpp>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/array.hpp>
 #include "Channel.hpp"
-#include "Protocol.hpp"
+#include "ProtocolSchema.hpp"
+#include "Clock.hpp"
 #include "UniquePtr.hpp"
 #include "SharedRef.hpp"
+#include "Transport.hpp"
+#include "HandlerAllocator.hpp"
 #include <iostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
 
 using boost::asio::ip::tcp;
 
-// The TCPConnection class listens on a socket for incoming messages and passes them down a Channel to be
-// processed each tick
-class TCPConnection : public boost::enable_shared_from_this<TCPConnection>
+// The TCPConnection class is SocketTransport's StreamConnection. It listens on a socket for incoming messages and
+// passes them down a Channel to be processed each tick.
+// Outgoing messages go through a fixed size queue with one write in flight at a time, so a client that stops
+// reading costs at most maxQueuedBytes rather than whatever the kernel and asio will buffer for it. Snapshots are
+// full state, so one still waiting in the queue is overwritten by the next rather than queued behind it.
+// Each read and write holds a reference to the connection (SharedThis) until its handler has run, so the server
+// dropping its own reference can't free the connection under an operation that's still in flight
+class TCPConnection : public StreamConnection, public SharedFromThis<TCPConnection>
 {
 public:
-    static SharedPtr<TCPConnection> Create(boost::asio::io_service &io_service, Channel<TCPMessage, std::queue<TCPMessage> > *InTcpMessageChannel)
+    static SharedPtr<TCPConnection> Create(boost::asio::io_service &io_service, Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > *InTcpMessageChannel, size_t maxQueuedBytes)
     {
-        return MakeShareable(new TCPConnection(io_service, InTcpMessageChannel));
+        return MakeShareable(new TCPConnection(io_service, InTcpMessageChannel, maxQueuedBytes));
     }
 
     tcp::socket &GetSocket() { return socket; }
 
-    void StartReceive();
-    void Send(TCPMessage &msg);
-    void Close()
+    void StartReceive() override;
+    SendResult Send(TCPMessage &msg) override;
+    void Close() override
     {
         socket.close();
     }
+
+    bool IsSlowConsumer(uint64_t now, uint64_t timeoutUs) override;
+    size_t GetQueuedBytes();
     
 private:
-    TCPConnection(boost::asio::io_service &io_service, Channel<TCPMessage, std::queue<TCPMessage> > *InTcpMessageChannel)
-        : socket(io_service)
+    using MessageBuffer = boost::array<uint8_t, WireSize<TCPMessage>::value>;
+    static const size_t NoSnapshot = static_cast<size_t>(-1);
+
+    TCPConnection(boost::asio::io_service &io_service, Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > *InTcpMessageChannel, size_t maxQueuedBytes)
+        : sendQueue(maxQueuedBytes / sizeof(MessageBuffer) > 2 ? maxQueuedBytes / sizeof(MessageBuffer) : 2)
+        , sendHead(0)
+        , sendCount(0)
+        , sending(false)
+        , queuedSnapshot(NoSnapshot)
+        , backloggedSince(0)
+        , overflowed(false)
+        , clientId(UDPUnassignedId)
         , tcpMessageChannel(InTcpMessageChannel)
+        , socket(io_service)
     {
     }
 
     void tcpHandleReceive(const boost::system::error_code &error, std::size_t bytesTransferred);
     void tcpHandleSend(const boost::system::error_code &error, std::size_t bytesTransferred);
+    void StartSend(); // sendMutex must be held
+
+    // Ring of encoded messages, the one at sendHead is being written while sending is set
+    std::mutex sendMutex;
+    std::vector<MessageBuffer> sendQueue;
+    size_t sendHead;
+    size_t sendCount;
+    bool sending;
+    size_t queuedSnapshot; // Slot of the snapshot waiting to go out, if there is one
+    uint64_t backloggedSince; // When the queue last went over half full, 0 while it isn't
+    bool overflowed;
+
+    MessageBuffer tcpRecvBuffer;
+    std::atomic<uint8_t> clientId; // From YouAreConnected, sent on the tick and read by the receives on the io thread
 
-    boost::array<uint8_t, sizeof(TCPMessage)> tcpSendBuffer;
-    boost::array<uint8_t, sizeof(TCPMessage)> tcpRecvBuffer;
+    // There's only ever one read and one write in flight, so each reuses the same handler storage. Sends start on
+    // the tick thread as often as the io thread, where asio's own recycling wouldn't get the memory back
+    HandlerMemory receiveHandler;
+    HandlerMemory sendHandler;
 
-    Channel<TCPMessage, std::queue<TCPMessage> > *tcpMessageChannel;
+    Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > *tcpMessageChannel;
 
     tcp::socket socket;
 };
@@ -0,0 +1,5 @@
+#pragma once
+#include <cstdint>
+
+// Pins the calling thread to one core, returns false if that isn't supported here or the core doesn't exist
+bool PinThreadToCore(uint32_t core);
@@ -0,0 +1,214 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <vector>
+#include <array>
+
+// Hierarchical timing wheel (Varghese & Lauck), advanced from the tick rather than from the io_service so that
+// thousands of per-client timers cost nothing more than a few list links each.
+// Time is split into granules of ResolutionUs. Level 0 has one slot per granule, each level above covers
+// SlotCount times the span of the one below. Timers are intrusive doubly linked list nodes held in a pool,
+// so Schedule and Cancel are O(1), and Advance is O(1) per granule plus the timers that actually fire or cascade.
+// Not thread safe, everything should happen on the thread which calls Advance (i.e. the tick).
+template<typename PayloadType, unsigned int SlotBits = 6, unsigned int NumLevels = 4>
+class TimingWheel
+{
+public:
+    using TimerHandle = uint64_t; // Generation in the high 32 bits, pool index in the low 32
+    static const TimerHandle InvalidTimer = 0;
+
+    TimingWheel(const uint64_t InResolutionUs, const uint64_t InStartTime, const size_t InitialCapacity = 64)
+        : resolution(InResolutionUs)
+        , startTime(InStartTime)
+        , currentGranule(0)
+        , freeHead(NilIndex)
+        , numScheduled(0)
+    {
+        assert(resolution > 0);
+        for (auto &level : slots)
+        {
+            level.fill(NilIndex);
+        }
+        nodes.reserve(InitialCapacity);
+    }
+
+    // Schedule payload to fire after delayUs. Always rounds up to at least one granule so that something
+    // rescheduling itself from inside a callback can't fire again in the same Advance. Delays longer than
+    // the wheel can span (SlotCount^NumLevels granules) are clamped to the span
+    TimerHandle Schedule(const uint64_t delayUs, const PayloadType &payload)
+    {
+        uint64_t granules = (delayUs + resolution - 1) / resolution;
+        if (granules == 0) granules = 1;
+        if (granules >= MaxGranules) granules = MaxGranules - 1;
+
+        uint32_t index = AllocateNode();
+        Node &node = nodes[index];
+        node.expiry = currentGranule + granules;
+        node.payload = payload;
+        Link(index);
+        numScheduled++;
+        return MakeHandle(index, node.generation);
+    }
+
+    // Returns false if the timer already fired or was already cancelled
+    bool Cancel(const TimerHandle handle)
+    {
+        if (!IsScheduled(handle))
+        {
+            return false;
+        }
+        uint32_t index = static_cast<uint32_t>(handle & 0xFFFFFFFF);
+        Unlink(index);
+        FreeNode(index);
+        numScheduled--;
+        return true;
+    }
+
+    bool IsScheduled(const TimerHandle handle) const
+    {
+        uint32_t index = static_cast<uint32_t>(handle & 0xFFFFFFFF);
+        uint32_t generation = static_cast<uint32_t>(handle >> 32);
+        return handle != InvalidTimer
+            && index < nodes.size()
+            && nodes[index].generation == generation
+            && nodes[index].level != FreeLevel;
+    }
+
+    // Moves the wheel up to now, calling callback(payload) for everything that expired on the way.
+    // Callbacks are free to Schedule or Cancel, including cancelling timers due in the same granule.
+    template<typename Callback>
+    void Advance(const uint64_t now, Callback &&callback)
+    {
+        if (now < startTime) return;
+        const uint64_t targetGranule = (now - startTime) / resolution;
+        while (currentGranule < targetGranule)
+        {
+            currentGranule++;
+
+            // Pull timers down from the coarser levels whenever the level below wraps
+            for (unsigned int level = 1; level < NumLevels; level++)
+            {
+                if ((currentGranule & (SlotMask << (SlotBits * (level - 1)))) != 0) break;
+                Cascade(level, static_cast<uint32_t>((currentGranule >> (SlotBits * level)) & SlotMask));
+            }
+
+            uint32_t &head = slots[0][currentGranule & SlotMask];
+            while (head != NilIndex)
+            {
+                uint32_t index = head;
+                Unlink(index);
+                PayloadType payload = nodes[index].payload; // Copy out first, the callback may grow the pool
+                FreeNode(index);
+                numScheduled--;
+                callback(payload);
+            }
+        }
+    }
+
+    inline size_t GetNumScheduled() const { return numScheduled; }
+    inline uint64_t GetResolution() const { return resolution; }
+
+private:
+    static const uint32_t NilIndex = 0xFFFFFFFF;
+    static const uint8_t FreeLevel = 0xFF;
+    static const uint64_t SlotCount = 1ull << SlotBits;
+    static const uint64_t SlotMask = SlotCount - 1;
+    static const uint64_t MaxGranules = 1ull << (SlotBits * NumLevels);
+
+    struct Node
+    {
+        uint64_t expiry; // Absolute granule
+        uint32_t prev;
+        uint32_t next;
+        uint32_t generation;
+        uint8_t level;
+        uint8_t slot;
+        PayloadType payload;
+    };
+
+    static inline TimerHandle MakeHandle(const uint32_t index, const uint32_t generation)
+    {
+        return (static_cast<uint64_t>(generation) << 32) | index;
+    }
+
+    uint32_t AllocateNode()
+    {
+        uint32_t index;
+        if (freeHead != NilIndex)
+        {
+            index = freeHead;
+            freeHead = nodes[index].next;
+        }
+        else
+        {
+            index = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(Node());
+            nodes[index].generation = 0;
+        }
+        nodes[index].generation++;
+        if (nodes[index].generation == 0) nodes[index].generation = 1; // Keep handles from ever being InvalidTimer
+        return index;
+    }
+
+    void FreeNode(const uint32_t index)
+    {
+        nodes[index].level = FreeLevel;
+        nodes[index].next = freeHead;
+        freeHead = index;
+    }
+
+    void Link(const uint32_t index)
+    {
+        Node &node = nodes[index];
+        uint64_t delta = node.expiry - currentGranule;
+        unsigned int level = 0;
+        while (level < NumLevels - 1 && delta >= (1ull << (SlotBits * (level + 1))))
+        {
+            level++;
+        }
+        node.level = static_cast<uint8_t>(level);
+        node.slot = static_cast<uint8_t>((node.expiry >> (SlotBits * level)) & SlotMask);
+
+        uint32_t &head = slots[level][node.slot];
+        node.prev = NilIndex;
+        node.next = head;
+        if (head != NilIndex) nodes[head].prev = index;
+        head = index;
+    }
+
+    void Unlink(const uint32_t index)
+    {
+        Node &node = nodes[index];
+        if (node.prev != NilIndex) nodes[node.prev].next = node.next;
+        else slots[node.level][node.slot] = node.next;
+        if (node.next != NilIndex) nodes[node.next].prev = node.prev;
+    }
+
+    void Cascade(const unsigned int level, const uint32_t slot)
+    {
+        uint32_t index = slots[level][slot];
+        slots[level][slot] = NilIndex;
+        while (index != NilIndex)
+        {
+            uint32_t next = nodes[index].next;
+            Link(index);
+            index = next;
+        }
+    }
+
+    uint64_t resolution;
+    uint64_t startTime;
+    uint64_t currentGranule;
+
+    std::vector<Node> nodes;
+    uint32_t freeHead;
+    size_t numScheduled;
+    std::array<std::array<uint32_t, SlotCount>, NumLevels> slots;
+};
+
+// std::array::fill takes both by reference, so unoptimised builds need them defined somewhere
+template<typename PayloadType, unsigned int SlotBits, unsigned int NumLevels>
+const typename TimingWheel<PayloadType, SlotBits, NumLevels>::TimerHandle TimingWheel<PayloadType, SlotBits, NumLevels>::InvalidTimer;
+template<typename PayloadType, unsigned int SlotBits, unsigned int NumLevels>
+const uint32_t TimingWheel<PayloadType, SlotBits, NumLevels>::NilIndex;
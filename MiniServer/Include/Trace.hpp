@@ -0,0 +1,112 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <string>
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Scoped spans and flow events for following a message from the socket through the tick and back out, written
+// as Chrome trace JSON (chrome://tracing or ui.perfetto.dev) whenever asked for with Trace::WriteChromeJson.
+// Each thread records into a ring of its own, so recording is a couple of timestamp reads and a store with no
+// locks or allocation, and a thread that records a lot only loses its own oldest events. Nothing is recorded
+// until Trace::Enable, and with MINISERVER_TRACING 0 the macros compile to nothing at all.
+// Names have to be string literals (or otherwise live forever), only the pointer is kept
+#ifndef MINISERVER_TRACING
+#define MINISERVER_TRACING 1
+#endif
+
+enum class TracePhase : uint8_t
+{
+    Span, // arg is the duration
+    FlowStart, // arg is the flow id, for this and the next two
+    FlowStep,
+    FlowEnd
+};
+
+struct TraceEvent
+{
+    uint64_t time; // TraceNow ticks
+    uint64_t arg;
+    const char *name;
+    TracePhase phase;
+};
+
+// Flow ids, so a message keeps the same one from receive to relay and no two kinds of flow collide
+inline uint64_t TracePlayerUpdateFlow(uint8_t id, uint16_t sequence) { return (static_cast<uint64_t>(id) << 16) | sequence; }
+inline uint64_t TraceBatchFlow(uint64_t batch) { return (1ull << 63) | batch; }
+
+namespace Trace
+{
+    extern std::atomic<bool> enabled;
+
+    inline bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+    void Enable(bool enable);
+
+    // Called by each thread as it starts, otherwise it shows up by number
+    void SetThreadName(const char *name);
+
+    // Every thread's events so far into one file. Any thread, recording carries on meanwhile
+    bool WriteChromeJson(const std::string &path);
+
+    void Record(TracePhase phase, const char *name, uint64_t time, uint64_t arg);
+}
+
+// The cheapest clock there is: the time stamp counter on x86 (converted when written out), nanoseconds elsewhere
+inline uint64_t TraceNow()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *InName)
+        : name(InName)
+        , start(Trace::IsEnabled() ? TraceNow() : 0)
+    {
+    }
+    ~TraceSpan()
+    {
+        if (start != 0)
+        {
+            Trace::Record(TracePhase::Span, name, start, TraceNow() - start);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan &operator=(const TraceSpan&) = delete;
+
+private:
+    const char *name;
+    uint64_t start;
+};
+
+// Flows join up spans, on whatever thread, that handled the same thing. Each event attaches to the span it's in
+inline void TraceFlow(TracePhase phase, const char *name, uint64_t id)
+{
+    if (Trace::IsEnabled())
+    {
+        Trace::Record(phase, name, TraceNow(), id);
+    }
+}
+
+#if MINISERVER_TRACING
+#define MINISERVER_TRACE_CONCAT_INNER(a, b) a##b
+#define MINISERVER_TRACE_CONCAT(a, b) MINISERVER_TRACE_CONCAT_INNER(a, b)
+#define MINISERVER_TRACE_SPAN(name) TraceSpan MINISERVER_TRACE_CONCAT(traceSpan, __LINE__)(name)
+#define MINISERVER_TRACE_FLOW(phase, name, id) TraceFlow(TracePhase::phase, name, id)
+#else
+#define MINISERVER_TRACE_SPAN(name) do {} while (0)
+#define MINISERVER_TRACE_FLOW(phase, name, id) do {} while (0)
+#endif
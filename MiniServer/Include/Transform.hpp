@@ -36,10 +36,10 @@ public:
         , rotation(0.f, Vector3(0.f, 1.f, 0.f))
     {}
 
-    inline void SetPosition(Vector3& NewPos)  { pos = NewPos; }
-    inline void SetScale(Vector3& NewScale)   { scale = NewScale; }
-    inline void SetRotation(Rotation& NewRot) { rotation = NewRot; }
-    inline void SetPreRotation(Rotation& NewPreRot) { preRotation = NewPreRot; }
+    inline void SetPosition(const Vector3& NewPos)  { pos = NewPos; }
+    inline void SetScale(const Vector3& NewScale)   { scale = NewScale; }
+    inline void SetRotation(const Rotation& NewRot) { rotation = NewRot; }
+    inline void SetPreRotation(const Rotation& NewPreRot) { preRotation = NewPreRot; }
 
     inline const Vector3& GetPosition()  const { return pos; }
     inline       Vector3& GetPosition()        { return pos; }
@@ -62,4 +62,5 @@ private:
     TransformInheritance transformInheritance;
 
     friend Object;
+    template<typename T> friend struct WireSchema; // So the wire format can reach the members directly, see ProtocolSchema.hpp
 };
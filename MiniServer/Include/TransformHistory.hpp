@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include "Protocol.hpp"
+
+// One recorded frame of every player's transform, stored as structure of arrays so that each component for all
+// 16 players is exactly one 64 byte cache line. Interpolating two frames is then a handful of straight-line
+// loops over aligned float[16] which the compiler turns into SIMD without any help.
+struct alignas(64) TransformFrame
+{
+    alignas(64) float posX[16];
+    alignas(64) float posY[16];
+    alignas(64) float posZ[16];
+    alignas(64) float scaleX[16];
+    alignas(64) float scaleY[16];
+    alignas(64) float scaleZ[16];
+    alignas(64) float rotX[16]; // Rotations as unit quaternions, which unlike axis and angle can be blended
+    alignas(64) float rotY[16];
+    alignas(64) float rotZ[16];
+    alignas(64) float rotW[16];
+    uint64_t timestamp; // Server monotonic microseconds when the frame was taken
+    uint64_t tick; // Server tick the frame was taken on
+    uint16_t activeMask; // Bit n set if player n was connected
+
+    inline bool IsActive(const uint8_t id) const { return (activeMask & (1u << id)) != 0; }
+    void GetTransform(const uint8_t id, Transform &out) const;
+};
+
+// Fixed size ring of TransformFrames, recorded at a steady interval, for rewinding the world to what a given
+// client saw when it acted (lag compensation). Because frames are evenly spaced the two frames either side of
+// a query time can be found by arithmetic, so the cost of a rewind doesn't depend on how deep the history is.
+// Memory is depth * sizeof(TransformFrame), allocated once up front.
+class TransformHistory
+{
+public:
+    // Depth is rounded up to a power of two. Depth * interval is how far back a rewind can reach
+    TransformHistory(uint32_t InDepth, uint64_t InIntervalUs);
+
+    inline bool ShouldRecord(const uint64_t now) const { return now >= nextRecordTime; }
+    void Record(uint64_t now, uint64_t tick, const std::array<PlayerRecord, 16> &records, const std::array<bool, 16> &active);
+
+    // Fill out with the state of the world at time, interpolated between the frames either side (positions and
+    // scales linearly, rotations along the shorter arc between them).
+    // Times newer than the latest frame give the latest frame, times older than the oldest kept frame fail
+    bool Sample(uint64_t time, TransformFrame &out) const;
+
+    inline uint64_t GetOldestTime() const { return count == 0 ? 0 : FrameAt(OldestIndex()).timestamp; }
+    inline uint64_t GetNewestTime() const { return count == 0 ? 0 : FrameAt(count - 1).timestamp; }
+    inline uint32_t GetDepth() const { return depth; }
+    inline size_t GetMemoryUsage() const { return storage.size(); }
+
+private:
+    inline uint64_t OldestIndex() const { return count > depth ? count - depth : 0; }
+    inline TransformFrame &FrameAt(const uint64_t index) { return frames[index & mask]; }
+    inline const TransformFrame &FrameAt(const uint64_t index) const { return frames[index & mask]; }
+
+    std::vector<uint8_t> storage; // Over-allocated so frames can be aligned regardless of what new gives us
+    TransformFrame *frames;
+    uint32_t depth;
+    uint32_t mask;
+    uint64_t interval;
+    uint64_t count; // Total frames ever recorded, the newest is at count - 1
+    uint64_t nextRecordTime;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <boost/asio.hpp>
+#include "Channel.hpp"
+#include "ProtocolSchema.hpp"
+#include "QueuedTCPMessage.hpp"
+#include "SharedRef.hpp"
+#include "UDPReceivePool.hpp"
+#include "PacketAggregator.hpp"
+
+// What Server is written against instead of sockets, so the same server logic can run over real networking
+// (SocketTransport) or entirely in process (MemoryTransport, for benchmarking the tick without the kernel).
+// A transport brings in two kinds of traffic: datagrams, which it writes into receive pool slabs and hands to the
+// TransportHandler, and stream connections, one per client that has one, which write whatever they receive
+// into the server's TCP message channel
+
+// A client's ordered, reliable connection for control messages. TCP over real sockets
+class StreamConnection
+{
+public:
+    enum class SendResult : uint8_t
+    {
+        Queued,
+        Superseded, // A snapshot replaced an older one that hadn't gone out yet
+        Dropped, // A snapshot with the queue full, the next one will catch the client up
+        Overflow // Anything else with the queue full. It's lost, so the connection is as good as broken (see IsSlowConsumer)
+    };
+
+    virtual ~StreamConnection() {}
+
+    virtual void StartReceive() = 0;
+    virtual SendResult Send(TCPMessage &msg) = 0; // Safe from any thread
+    virtual void Close() = 0;
+    // True once the client has overflowed its queue, or kept it more than half full for longer than timeoutUs
+    virtual bool IsSlowConsumer(uint64_t now, uint64_t timeoutUs) = 0;
+};
+
+// Implemented by the server, called by the transport from whichever thread its traffic arrives on
+class TransportHandler
+{
+public:
+    virtual ~TransportHandler() {}
+
+    virtual void OnStreamAccepted(SharedPtr<StreamConnection> connection) = 0;
+    // Checks a datagram written into slab and passes it on to the tick. Returns false if it didn't keep the slab,
+    // which still belongs to the transport and can be received into again
+    virtual bool OnDatagram(uint16_t slab, std::size_t bytes, const boost::asio::ip::udp::endpoint &from) = 0;
+    virtual void OnDatagramDropped() = 0; // Arrived with no free slab to put it in
+};
+
+class Transport
+{
+public:
+    virtual ~Transport() {}
+
+    // Starts listening. Datagrams go into receivePool's slabs, sends come out of sendPool, and stream connections
+    // deliver into tcpMessageChannel
+    virtual bool Start(TransportHandler &handler, UDPReceivePool &receivePool, UDPSendBufferPool &sendPool, Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > &tcpMessageChannel) = 0;
+    // Stops any threads of its own. Anything running on the io_service it was given is the owner's to stop first
+    virtual void Stop() = 0;
+
+    // Start and end of each tick, for transports driven by the tick thread rather than one of their own
+    virtual void Poll() {}
+    virtual void Flush() {}
+
+    // Tick thread. Sends buffer to to, and releases it back to its pool once it's gone. to has to stay put until
+    // the next Flush
+    virtual void Send(UDPSendBuffer *buffer, const boost::asio::ip::udp::endpoint &to) = 0;
+    // Whether Send can reach to. A server with several transports sends through the first one that can, so a
+    // transport for some clients only says no to everyone else, and the catch all (sockets) goes last
+    virtual bool Owns(const boost::asio::ip::udp::endpoint &to) const { return true; }
+
+    virtual uint64_t GetSyscallCount() const { return 0; } // Made on the tick thread, for those that count them
+};
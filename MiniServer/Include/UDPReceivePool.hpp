@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <boost/asio/ip/udp.hpp>
+#include "Protocol.hpp"
+#include "SpscRing.hpp"
+
+// Slabs for incoming datagrams, so the kernel writes a message exactly once and everything after that works on
+// it where it lies. The io thread takes a free slab, receives into it, checks it in place and publishes its index
+// to the tick thread, which reads it straight out of the slab and hands it back once nothing refers to it any more
+// (PlayerUpdates can sit in a jitter buffer for a few ticks first).
+// Two SPSC rings do the handover, filled from io thread to tick and free from tick back to io thread, so nothing
+// is locked and nothing is copied but the 2 byte index.
+// With several receive threads (ServerConfig::udpShards) each gets a shard of its own, SlabCount slabs and their
+// pair of rings. A slab's index says which shard it belongs to, so only Acquire needs to be told
+class UDPReceivePool
+{
+public:
+    static const uint16_t SlabCount = 2048; // Per shard. Comfortably more than 16 full jitter buffers plus a tick's worth in flight
+    static const uint16_t MaxShards = 31; // Indexes of every shard's slabs have to fit under NoSlab
+    static const uint16_t NoSlab = 0xFFFF;
+    static const size_t SlabHeadroom = 48; // Free space in front of each message, the io_uring backend has the kernel put the sender's address there
+
+    explicit UDPReceivePool(uint16_t ShardCount = 1);
+
+    inline UDPMessage &Get(uint16_t slab) { return slabs[slab].message; }
+    inline uint8_t *GetWithHeadroom(uint16_t slab) { return slabs[slab].headroom; }
+    // Who sent it. Only kept for the messages that need it (Reliable and Ack), everything else says who it's from
+    // in its id and is dealt with by what that id may do
+    inline boost::asio::ip::udp::endpoint &GetSender(uint16_t slab) { return slabs[slab].sender; }
+    inline uint16_t GetShardCount() const { return static_cast<uint16_t>(shards.size()); }
+
+    // The shard's io thread (or whoever is feeding the server, e.g. Replay)
+    bool Acquire(uint16_t shard, uint16_t &slab) { return shards[shard]->freeSlabs.TryPop(slab); }
+    void Publish(uint16_t slab) { shards[slab / SlabCount]->filledSlabs.TryPush(slab); } // Can't fail, there are only SlabCount slabs to go round
+
+    // Tick thread
+    template<typename Callback>
+    size_t ConsumeAll(Callback &&callback)
+    {
+        size_t consumed = 0;
+        for (auto &shard : shards)
+        {
+            consumed += shard->filledSlabs.PopAll(callback);
+        }
+        return consumed;
+    }
+    void Release(uint16_t slab) { shards[slab / SlabCount]->freeSlabs.TryPush(slab); }
+    bool Empty() const
+    {
+        for (auto &shard : shards)
+        {
+            if (!shard->filledSlabs.Empty())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    struct Slab
+    {
+        uint8_t headroom[SlabHeadroom];
+        UDPMessage message;
+        boost::asio::ip::udp::endpoint sender; // After the message, the headroom has to run straight into it
+    };
+
+    struct Shard
+    {
+        // One spare slot each since a ring of N holds N - 1
+        SpscRing<uint16_t, SlabCount * 2> freeSlabs;
+        SpscRing<uint16_t, SlabCount * 2> filledSlabs;
+    };
+
+    std::vector<Slab> slabs;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
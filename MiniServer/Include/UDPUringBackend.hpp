@@ -0,0 +1,128 @@
+#pragma once
+#ifdef MINISERVER_IO_URING
+#include <cstring>
+#include <cerrno>
+#include <boost/asio.hpp>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "IoUring.hpp"
+#include "UDPReceivePool.hpp"
+#include "PacketAggregator.hpp"
+
+// UDP through io_uring rather than asio, driven entirely by the tick thread (see ServerConfig::udpIoUring).
+// One multishot recvmsg stays armed the whole time. The receive pool's slabs are its provided buffer ring, with the
+// slab index as the buffer id, and each slab's headroom takes the recvmsg header and sender's address so the
+// message lands exactly where Get(slab) expects it. Sends are zero copy straight out of the send pool's buffers,
+// which are registered with the kernel up front. Nothing goes to the kernel until Submit at the end of the tick and
+// completions are read without a syscall, so however many datagrams come and go a tick costs at most one
+// io_uring_enter.
+// UDP only. TCP, and the snapshots that go over it, are still sent and received through asio on the io thread.
+// Moving them here means sending snapshots from the tick rather than the io thread's timer, since only the tick
+// may touch the ring, and framing a byte stream out of provided buffers. That's left for its own change
+class UDPUringBackend
+{
+public:
+    UDPUringBackend();
+    ~UDPUringBackend();
+
+    // Takes every free slab in shard 0 of receivePool, and registers whatever buffers sendPool has so far (any it
+    // grows later are sent from unregistered)
+    bool Open(uint16_t port, UDPReceivePool &InReceivePool, UDPSendBufferPool &sendPool);
+
+    // Runs whatever has completed, calling receive(uint16_t slab, size_t bytes, const udp::endpoint &from) for each
+    // datagram. receive returns false if it didn't keep the slab. Then hands the kernel back any slabs released
+    // since last time. Returns the number of datagrams received
+    template<typename ReceiveFunc>
+    size_t Poll(ReceiveFunc &&receive)
+    {
+        size_t received = 0;
+        ring.ForEachCompletion([&](const io_uring_cqe &cqe)
+        {
+            if (cqe.user_data == ReceiveTag)
+            {
+                if ((cqe.flags & IORING_CQE_F_MORE) == 0)
+                {
+                    receiveArmed = false; // Ran out of slabs, or failed. Armed again below
+                }
+                if (cqe.res < 0)
+                {
+                    if (cqe.res != -ENOBUFS)
+                    {
+                        receiveErrors++;
+                    }
+                    return;
+                }
+                const uint16_t slab = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                const io_uring_recvmsg_out *header = reinterpret_cast<const io_uring_recvmsg_out*>(receivePool->GetWithHeadroom(slab) + HeaderOffset);
+                if ((header->flags & MSG_TRUNC) != 0 || header->namelen > NameLength)
+                {
+                    receiveErrors++; // Too big to be a message
+                    receivePool->Release(slab);
+                    return;
+                }
+                boost::asio::ip::udp::endpoint from;
+                memcpy(from.data(), header + 1, header->namelen);
+                from.resize(header->namelen);
+                received++;
+                if (!receive(slab, static_cast<size_t>(header->payloadlen), from))
+                {
+                    receivePool->Release(slab);
+                }
+            }
+            else
+            {
+                // A zero copy send completes twice, once sent and again once the kernel is done with the buffer.
+                // Without IORING_CQE_F_MORE on the first there's no second coming
+                MINISERVER_TRACE_SPAN("UDP send complete");
+                UDPSendBuffer *buffer = reinterpret_cast<UDPSendBuffer*>(cqe.user_data);
+                if ((cqe.flags & IORING_CQE_F_NOTIF) != 0 || (cqe.flags & IORING_CQE_F_MORE) == 0)
+                {
+                    UDPSendBufferPool::Release(buffer);
+                }
+                if ((cqe.flags & IORING_CQE_F_NOTIF) == 0 && cqe.res < 0)
+                {
+                    sendErrors++;
+                }
+            }
+        });
+        datagramsReceived += received;
+        ProvideFreeSlabs();
+        if (!receiveArmed)
+        {
+            ArmReceive();
+        }
+        return received;
+    }
+
+    // Queues buffer to go to to once the tick calls Submit, and releases it back to its pool when it's gone.
+    // to has to stay put until then
+    void Send(UDPSendBuffer *buffer, const boost::asio::ip::udp::endpoint &to);
+    void Submit(); // Once a tick
+
+    inline uint64_t GetSyscallCount() const { return ring.GetEnterCount(); }
+    inline uint64_t GetDatagramsReceived() const { return datagramsReceived; }
+    inline uint64_t GetDatagramsSent() const { return datagramsSent; }
+    inline uint64_t GetErrorCount() const { return receiveErrors + sendErrors; }
+
+private:
+    static const uint64_t ReceiveTag = 1; // Sends are tagged with their buffer's address, which is never odd
+    static const uint16_t BufferGroup = 0;
+    static const size_t NameLength = sizeof(sockaddr_in6);
+    static const size_t HeaderOffset = UDPReceivePool::SlabHeadroom - sizeof(io_uring_recvmsg_out) - NameLength;
+    static_assert(sizeof(io_uring_recvmsg_out) + NameLength <= UDPReceivePool::SlabHeadroom, "Slab headroom too small for the recvmsg header");
+
+    void ProvideFreeSlabs();
+    void ArmReceive();
+
+    IoUring ring;
+    int socketFd;
+    UDPReceivePool *receivePool;
+    msghdr receiveHeader; // Only its name and control lengths are used, to lay out each receive's buffer
+    uint32_t registeredBuffers;
+    bool receiveArmed;
+    uint64_t datagramsReceived;
+    uint64_t datagramsSent;
+    uint64_t receiveErrors;
+    uint64_t sendErrors;
+};
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "SeqLock.hpp"
+
+// Each tick's players, published by the server into a named shared memory object (ServerConfig::worldExportName)
+// for any number of other processes on the same host to read whenever they like. Readers only ever load from the
+// mapping, so the server never knows they're there, and reading is a copy with no syscalls.
+// The layout is part of the interface and only changes along with WorldExportRegion::CurrentVersion: fixed size
+// fields, no pointers, host byte order. Anything that can map memory and follow the SeqLock rules can read it,
+// WorldExportReader is the C++ way.
+// Linux (POSIX shared memory) only, elsewhere opening either end fails
+
+struct WorldExportPlayer
+{
+    uint8_t id;
+    uint8_t active; // 0 for a free slot, the rest of the record is whatever it was last
+    uint8_t unused[2];
+    float position[3];
+    float scale[3];
+    float rotationDegrees;
+    float rotationAxis[3];
+};
+static_assert(sizeof(WorldExportPlayer) == 44, "WorldExportPlayer is part of the export's layout");
+
+struct WorldExportFrame
+{
+    static const uint32_t PlayerCount = 16;
+    uint64_t tick;
+    uint64_t publishedUs; // CLOCK_MONOTONIC in microseconds, so a reader can tell how old it is
+    WorldExportPlayer players[PlayerCount];
+};
+static_assert(sizeof(WorldExportFrame) == 16 + 16 * 44, "WorldExportFrame is part of the export's layout");
+
+// The whole object. The header is written once when the server creates it, magic last, and never changes after
+struct WorldExportRegion
+{
+    static const uint32_t Magic = 0x4557534D; // "MSWE"
+    static const uint32_t CurrentVersion = 1;
+
+    std::atomic<uint32_t> magic; // Until this reads Magic the rest isn't set up yet
+    uint32_t version;
+    uint32_t regionSize; // sizeof(WorldExportRegion), so a reader built against a different layout can tell
+    uint32_t playerCount;
+    std::atomic<uint32_t> live; // Cleared when the server closes it, a new server makes a new object under the same name
+    uint32_t unused[3];
+    SeqLock<WorldExportFrame> frame; // 32 bit sequence, 4 bytes padding, then the frame as 64 bit words
+};
+static_assert(offsetof(WorldExportRegion, frame) == 32, "WorldExportRegion's header is part of the export's layout");
+
+// The server's end, Publish is called from the tick
+class WorldExportWriter
+{
+public:
+    WorldExportWriter();
+    ~WorldExportWriter();
+
+    WorldExportWriter(const WorldExportWriter&) = delete;
+    WorldExportWriter &operator=(const WorldExportWriter&) = delete;
+
+    // name is a shm_open name, like "/MiniServerWorld". Replaces anything left under it by a server that didn't
+    // close cleanly, readers still holding that find it isn't live any more
+    bool Open(const std::string &name);
+    void Close();
+    inline bool IsOpen() const { return region != nullptr; }
+
+    void Publish(const WorldExportFrame &frame) { region->frame.Publish(frame); }
+
+private:
+    std::string name;
+    WorldExportRegion *region;
+};
+
+// A consumer's end, read only
+class WorldExportReader
+{
+public:
+    WorldExportReader();
+    ~WorldExportReader();
+
+    WorldExportReader(const WorldExportReader&) = delete;
+    WorldExportReader &operator=(const WorldExportReader&) = delete;
+
+    // False if there's no server exporting under name, or it's a different layout
+    bool Open(const std::string &name);
+    void Close();
+    inline bool IsOpen() const { return region != nullptr; }
+
+    // False once the server has gone, in which case Close and Open again to pick up the next one
+    inline bool IsLive() const { return region->live.load(std::memory_order_acquire) != 0; }
+    // Frames published so far, to check for a new one without copying anything
+    inline uint32_t GetVersion() const { return region->frame.GetVersion(); }
+    // The latest frame, only ever waits for a write that's already under way
+    inline void Read(WorldExportFrame &out) const { region->frame.Read(out); }
+
+private:
+    const WorldExportRegion *region;
+};
@@ -1,6 +1,5 @@
 #pragma once
 #include <cmath>
-using std::sqrtf;
 
 class Vector3 
 {
@@ -43,7 +42,7 @@ public:
 
     inline float magnitude()
     {
-        return sqrtf(magnitudeSqrd());
+        return std::sqrt(magnitudeSqrd());
     }
 
     inline float magnitudeSqrd()
@@ -179,7 +178,7 @@ public:
 
     inline float magnitude()
     {
-        return sqrtf(magnitudeSqrd());
+        return std::sqrt(magnitudeSqrd());
     }
 
     inline float magnitudeSqrd()
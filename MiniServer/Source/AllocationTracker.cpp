@@ -0,0 +1,181 @@
+#include "AllocationTracker.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static const char *const TagNames[] =
+{
+    "Other",
+    "Tick",
+    "Channel",
+    "TcpSend",
+    "TcpReceive",
+    "UdpSocket",
+    "Accept",
+    "Snapshots",
+    "Spectators"
+};
+static_assert(sizeof(TagNames) / sizeof(TagNames[0]) == static_cast<size_t>(AllocationTag::Count), "One name per AllocationTag");
+
+const char *AllocationTagName(AllocationTag tag)
+{
+    return tag < AllocationTag::Count ? TagNames[static_cast<size_t>(tag)] : "?";
+}
+
+#ifdef MINISERVER_COUNT_ALLOCATIONS
+namespace
+{
+    const size_t TagCount = static_cast<size_t>(AllocationTag::Count);
+    const uint32_t MaxThreads = 256; // Any more share the last slot
+
+    // Only the owning thread writes its counts, unless it's the shared last slot, the atomics are for Report
+    struct ThreadAllocations
+    {
+        std::atomic<uint64_t> allocations[TagCount];
+        std::atomic<uint64_t> bytes[TagCount];
+    };
+
+    // Fixed and zero initialised, since anything that allocated here would come straight back into operator new
+    ThreadAllocations threads[MaxThreads];
+    std::atomic<uint32_t> threadCount(0);
+
+    thread_local ThreadAllocations *threadAllocations = nullptr;
+    thread_local uint32_t threadIndex = 0;
+    thread_local AllocationTag currentTag = AllocationTag::Other;
+    thread_local uint64_t heapAllocations = 0;
+
+    void Count(size_t size)
+    {
+        heapAllocations++;
+        if (threadAllocations == nullptr)
+        {
+            threadIndex = threadCount.fetch_add(1, std::memory_order_relaxed);
+            threadAllocations = &threads[threadIndex < MaxThreads ? threadIndex : MaxThreads - 1];
+        }
+        const size_t tag = static_cast<size_t>(currentTag);
+        if (threadIndex < MaxThreads - 1)
+        {
+            threadAllocations->allocations[tag].store(threadAllocations->allocations[tag].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            threadAllocations->bytes[tag].store(threadAllocations->bytes[tag].load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+        }
+        else
+        {
+            threadAllocations->allocations[tag].fetch_add(1, std::memory_order_relaxed);
+            threadAllocations->bytes[tag].fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+}
+
+AllocationScope::AllocationScope(AllocationTag tag)
+    : previous(currentTag)
+{
+    currentTag = tag;
+}
+
+AllocationScope::~AllocationScope()
+{
+    currentTag = previous;
+}
+
+AllocationTracker::Counts AllocationTracker::ThreadCounts(AllocationTag tag)
+{
+    if (threadAllocations == nullptr)
+    {
+        return { 0, 0 };
+    }
+    const size_t index = static_cast<size_t>(tag);
+    return { threadAllocations->allocations[index].load(std::memory_order_relaxed), threadAllocations->bytes[index].load(std::memory_order_relaxed) };
+}
+
+AllocationTracker::Counts AllocationTracker::TotalCounts(AllocationTag tag)
+{
+    const size_t index = static_cast<size_t>(tag);
+    const uint32_t count = threadCount.load(std::memory_order_relaxed);
+    Counts total = { 0, 0 };
+    for (uint32_t i = 0; i < count && i < MaxThreads; i++)
+    {
+        total.allocations += threads[i].allocations[index].load(std::memory_order_relaxed);
+        total.bytes += threads[i].bytes[index].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void AllocationTracker::Report(std::ostream & out)
+{
+    const uint32_t count = threadCount.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count && i < MaxThreads; i++)
+    {
+        out << "Thread " << i << (i == MaxThreads - 1 ? " (and any after)" : "") << (&threads[i] == threadAllocations ? " (this one)" : "") << ":";
+        for (size_t tag = 0; tag < TagCount; tag++)
+        {
+            const uint64_t allocations = threads[i].allocations[tag].load(std::memory_order_relaxed);
+            if (allocations > 0)
+            {
+                out << " " << TagNames[tag] << " " << allocations << " (" << threads[i].bytes[tag].load(std::memory_order_relaxed) << " bytes)";
+            }
+        }
+        out << std::endl;
+    }
+}
+
+uint64_t HeapAllocationCount()
+{
+    return heapAllocations;
+}
+
+void *operator new(size_t size)
+{
+    Count(size);
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+#else
+AllocationTracker::Counts AllocationTracker::ThreadCounts(AllocationTag)
+{
+    return { 0, 0 };
+}
+
+AllocationTracker::Counts AllocationTracker::TotalCounts(AllocationTag)
+{
+    return { 0, 0 };
+}
+
+void AllocationTracker::Report(std::ostream & out)
+{
+    out << "Allocations aren't being counted, build with MINISERVER_COUNT_ALLOCATIONS" << std::endl;
+}
+
+uint64_t HeapAllocationCount()
+{
+    return 0;
+}
+#endif
@@ -0,0 +1,260 @@
+#include "Capture.hpp"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+static const char CaptureMagic[8] = { 'M', 'S', 'C', 'A', 'P', 'T', 'U', 'R' };
+static const uint32_t CaptureVersion = 2; // 2: UDPMessage gained a sequence number
+static const uint64_t CaptureInitialSize = 16 * 1024 * 1024; // Doubled whenever it fills up
+
+// Grow the file to size without writing all the bytes in between, so it stays sparse on disk
+static bool ExtendFile(const std::string &path, uint64_t size)
+{
+    std::fstream stream(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!stream)
+    {
+        return false;
+    }
+    stream.seekp(static_cast<std::streamoff>(size - 1));
+    stream.put(0);
+    return static_cast<bool>(stream);
+}
+
+CaptureWriter::CaptureWriter()
+    : base(nullptr)
+    , mappedSize(0)
+    , writeOffset(0)
+    , indexIntervalUs(0)
+    , nextIndexTime(0)
+    , lastTick(UINT64_MAX)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    Close();
+}
+
+bool CaptureWriter::Open(const std::string & InPath, uint64_t InIndexIntervalUs)
+{
+    Close();
+    path = InPath;
+    indexIntervalUs = InIndexIntervalUs;
+    nextIndexTime = 0;
+    lastTick = UINT64_MAX;
+    index.clear();
+
+    // fstream won't create a file with in|out, so touch it first
+    {
+        std::ofstream create(path, std::ios::binary | std::ios::trunc);
+        if (!create)
+        {
+            std::cout << "Error: could not create capture file " << path << std::endl;
+            return false;
+        }
+    }
+    if (!ExtendFile(path, CaptureInitialSize) || !Map(CaptureInitialSize))
+    {
+        return false;
+    }
+
+    CaptureFileHeader header;
+    memcpy(header.magic, CaptureMagic, sizeof(CaptureMagic));
+    header.version = CaptureVersion;
+    header.headerSize = sizeof(CaptureFileHeader);
+    header.dataEnd = sizeof(CaptureFileHeader);
+    header.indexOffset = 0;
+    header.indexCount = 0;
+    header.indexIntervalUs = indexIntervalUs;
+    memcpy(base, &header, sizeof(header));
+    writeOffset = sizeof(CaptureFileHeader);
+    return true;
+}
+
+bool CaptureWriter::Map(uint64_t size)
+{
+    try
+    {
+        region = boost::interprocess::mapped_region(); // Drop the old view before remapping
+        file = boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_write);
+        region = boost::interprocess::mapped_region(file, boost::interprocess::read_write, 0, static_cast<std::size_t>(size));
+    }
+    catch (const boost::interprocess::interprocess_exception &e)
+    {
+        std::cout << "Error: could not map capture file " << path << ": " << e.what() << std::endl;
+        base = nullptr;
+        return false;
+    }
+    base = static_cast<uint8_t*>(region.get_address());
+    mappedSize = size;
+    return true;
+}
+
+void CaptureWriter::Append(CaptureRecordKind kind, uint8_t id, const void * payload, uint16_t size, uint64_t tick, uint64_t timestamp)
+{
+    if (base == nullptr)
+    {
+        return;
+    }
+
+    const uint64_t needed = sizeof(CaptureRecordHeader) + size;
+    if (writeOffset + needed > mappedSize)
+    {
+        // Rare, and doubling keeps it that way. Everything written so far is already in the file
+        uint64_t newSize = mappedSize * 2;
+        if (!ExtendFile(path, newSize) || !Map(newSize))
+        {
+            std::cout << "Error: capture file could not grow, recording stopped" << std::endl;
+            return;
+        }
+    }
+
+    if (tick != lastTick && timestamp >= nextIndexTime)
+    {
+        index.push_back({ tick, timestamp, writeOffset });
+        nextIndexTime = timestamp + indexIntervalUs;
+    }
+    lastTick = tick;
+
+    CaptureRecordHeader header;
+    header.size = size;
+    header.kind = kind;
+    header.id = id;
+    header.tick = tick;
+    header.timestamp = timestamp;
+    memcpy(base + writeOffset, &header, sizeof(header));
+    if (size > 0)
+    {
+        memcpy(base + writeOffset + sizeof(header), payload, size);
+    }
+    writeOffset += needed;
+
+    // Publish the record last so a reader (or a post-crash read) never sees half of one
+    reinterpret_cast<CaptureFileHeader*>(base)->dataEnd = writeOffset;
+}
+
+void CaptureWriter::Close()
+{
+    if (base == nullptr)
+    {
+        return;
+    }
+
+    const uint64_t indexBytes = index.size() * sizeof(CaptureIndexEntry);
+    if (writeOffset + indexBytes > mappedSize)
+    {
+        uint64_t newSize = writeOffset + indexBytes;
+        if (!ExtendFile(path, newSize) || !Map(newSize))
+        {
+            return; // Still readable front to back, just not seekable
+        }
+    }
+    if (indexBytes > 0)
+    {
+        memcpy(base + writeOffset, index.data(), static_cast<size_t>(indexBytes));
+    }
+    CaptureFileHeader *header = reinterpret_cast<CaptureFileHeader*>(base);
+    header->indexOffset = writeOffset;
+    header->indexCount = index.size();
+
+    region.flush();
+    region = boost::interprocess::mapped_region();
+    file = boost::interprocess::file_mapping();
+    base = nullptr;
+    // The file is left at its mapped size, everything past the index is a sparse hole
+}
+
+CaptureReader::CaptureReader()
+    : base(nullptr)
+    , headerSize(0)
+    , dataEnd(0)
+    , readOffset(0)
+    , indexEntries(nullptr)
+    , indexCount(0)
+{
+}
+
+bool CaptureReader::Open(const std::string & path)
+{
+    try
+    {
+        file = boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_only);
+        region = boost::interprocess::mapped_region(file, boost::interprocess::read_only);
+    }
+    catch (const boost::interprocess::interprocess_exception &e)
+    {
+        std::cout << "Error: could not open capture file " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    const uint8_t *mapped = static_cast<const uint8_t*>(region.get_address());
+    const uint64_t fileSize = region.get_size();
+    CaptureFileHeader header;
+    if (fileSize < sizeof(header))
+    {
+        std::cout << "Error: " << path << " is too small to be a capture" << std::endl;
+        return false;
+    }
+    memcpy(&header, mapped, sizeof(header));
+    if (memcmp(header.magic, CaptureMagic, sizeof(CaptureMagic)) != 0 || header.version != CaptureVersion || header.dataEnd > fileSize)
+    {
+        std::cout << "Error: " << path << " is not a capture this server understands" << std::endl;
+        return false;
+    }
+
+    base = mapped;
+    headerSize = header.headerSize;
+    dataEnd = header.dataEnd;
+    readOffset = headerSize;
+    if (header.indexOffset != 0 && header.indexOffset + header.indexCount * sizeof(CaptureIndexEntry) <= fileSize)
+    {
+        indexEntries = reinterpret_cast<const CaptureIndexEntry*>(base + header.indexOffset);
+        indexCount = header.indexCount;
+    }
+    return true;
+}
+
+bool CaptureReader::Next(CaptureRecordHeader & header, const uint8_t *& payload)
+{
+    if (base == nullptr || readOffset + sizeof(CaptureRecordHeader) > dataEnd)
+    {
+        return false;
+    }
+    memcpy(&header, base + readOffset, sizeof(header));
+    if (readOffset + sizeof(header) + header.size > dataEnd)
+    {
+        return false;
+    }
+    payload = base + readOffset + sizeof(header);
+    readOffset += sizeof(header) + header.size;
+    return true;
+}
+
+void CaptureReader::SeekToTime(uint64_t timestamp)
+{
+    Rewind();
+    if (indexCount > 0)
+    {
+        const CaptureIndexEntry *end = indexEntries + indexCount;
+        const CaptureIndexEntry *entry = std::upper_bound(indexEntries, end, timestamp,
+            [](uint64_t time, const CaptureIndexEntry &e) { return time < e.timestamp; });
+        if (entry != indexEntries)
+        {
+            readOffset = (entry - 1)->offset;
+        }
+    }
+
+    // Step forward from the index entry to the exact tick
+    uint64_t offset = readOffset;
+    CaptureRecordHeader header;
+    const uint8_t *payload;
+    while (Next(header, payload))
+    {
+        if (header.timestamp >= timestamp)
+        {
+            readOffset = offset;
+            return;
+        }
+        offset = readOffset;
+    }
+}
@@ -0,0 +1,71 @@
+#include "FrameArena.hpp"
+#include <cstdlib>
+#include <new>
+
+static inline size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+FrameArena::FrameArena(size_t InCapacity)
+    : capacity(InCapacity)
+    , offset(0)
+    , highWater(0)
+    , overflowBytes(0)
+    , overflowCount(0)
+{
+    block = static_cast<uint8_t*>(::operator new(capacity));
+}
+
+FrameArena::~FrameArena()
+{
+    Reset();
+    ::operator delete(block);
+}
+
+void *FrameArena::Allocate(size_t size, size_t alignment)
+{
+    // Offsets are aligned relative to the block, which new gives us at max_align_t or better
+    size_t start = AlignUp(offset, alignment);
+    if (alignment <= alignof(std::max_align_t) && start + size <= capacity)
+    {
+        offset = start + size;
+        return block + start;
+    }
+
+    // Out of room (or an alignment we can't promise), fall back to the heap until the next Reset
+    void *ptr = ::operator new(size + alignment);
+    overflowBlocks.push_back(ptr);
+    overflowBytes += size + alignment;
+    overflowCount++;
+    size_t address = reinterpret_cast<size_t>(ptr);
+    return reinterpret_cast<void*>(AlignUp(address, alignment));
+}
+
+void FrameArena::Reset()
+{
+    size_t used = offset + overflowBytes;
+    if (used > highWater) highWater = used;
+
+    for (void *ptr : overflowBlocks)
+    {
+        ::operator delete(ptr);
+    }
+    overflowBlocks.clear();
+
+    if (overflowBytes > 0)
+    {
+        // Last frame didn't fit, size up so the next one like it will
+        ::operator delete(block);
+        capacity = AlignUp(highWater + highWater / 2, 4096);
+        block = static_cast<uint8_t*>(::operator new(capacity));
+    }
+    overflowBytes = 0;
+    offset = 0;
+}
+
+FrameArena &FrameArena::ThreadLocal()
+{
+    thread_local FrameArena arena;
+    return arena;
+}
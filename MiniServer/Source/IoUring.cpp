@@ -0,0 +1,223 @@
+#include "IoUring.hpp"
+#ifdef MINISERVER_IO_URING
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int SysSetup(unsigned entries, io_uring_params *params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int SysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int SysRegister(int fd, unsigned opcode, const void *arg, unsigned count)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+IoUring::IoUring()
+    : ringFd(-1)
+    , sqRing(nullptr)
+    , sqRingSize(0)
+    , cqRing(nullptr)
+    , cqRingSize(0)
+    , sqes(nullptr)
+    , sqesSize(0)
+    , sqLocalTail(0)
+    , bufferRing(nullptr)
+    , bufferRingSize(0)
+    , bufferRingMask(0)
+    , bufferRingLocalTail(0)
+    , enterCount(0)
+{
+}
+
+IoUring::~IoUring()
+{
+    Close();
+}
+
+bool IoUring::Init(uint32_t sqEntries, uint32_t cqEntries)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = cqEntries;
+    ringFd = SysSetup(sqEntries, &params);
+    if (ringFd < 0)
+    {
+        return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+    {
+        sqRingSize = cqRingSize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+        sqRing = nullptr;
+        Close();
+        return false;
+    }
+    if (singleMmap)
+    {
+        cqRing = sqRing;
+    }
+    else
+    {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            cqRing = nullptr;
+            Close();
+            return false;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqeMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqeMap == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(sqeMap);
+
+    uint8_t *sq = static_cast<uint8_t*>(sqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqFlags = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+    sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntryCount = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sqLocalTail = *sqTail;
+    // Submissions always go in order, so the indirection array just maps every slot to itself
+    unsigned *sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntryCount; i++)
+    {
+        sqArray[i] = i;
+    }
+
+    uint8_t *cq = static_cast<uint8_t*>(cqRing);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+void IoUring::Close()
+{
+    if (bufferRing != nullptr)
+    {
+        munmap(bufferRing, bufferRingSize);
+        bufferRing = nullptr;
+    }
+    if (sqes != nullptr)
+    {
+        munmap(sqes, sqesSize);
+        sqes = nullptr;
+    }
+    if (cqRing != nullptr && cqRing != sqRing)
+    {
+        munmap(cqRing, cqRingSize);
+    }
+    cqRing = nullptr;
+    if (sqRing != nullptr)
+    {
+        munmap(sqRing, sqRingSize);
+        sqRing = nullptr;
+    }
+    if (ringFd >= 0)
+    {
+        close(ringFd); // Anything still in flight is cancelled
+        ringFd = -1;
+    }
+}
+
+io_uring_sqe *IoUring::GetSqe()
+{
+    const unsigned head = reinterpret_cast<std::atomic<unsigned>*>(sqHead)->load(std::memory_order_acquire);
+    if (sqLocalTail - head >= sqEntryCount)
+    {
+        return nullptr;
+    }
+    io_uring_sqe *sqe = &sqes[sqLocalTail & sqMask];
+    sqLocalTail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUring::Submit()
+{
+    const unsigned toSubmit = sqLocalTail - *sqTail;
+    const bool overflowed = (reinterpret_cast<std::atomic<unsigned>*>(sqFlags)->load(std::memory_order_relaxed) & IORING_SQ_CQ_OVERFLOW) != 0;
+    if (toSubmit == 0 && !overflowed)
+    {
+        return 0; // Nothing to say, so no syscall
+    }
+    reinterpret_cast<std::atomic<unsigned>*>(sqTail)->store(sqLocalTail, std::memory_order_release);
+    enterCount++;
+    const int submitted = SysEnter(ringFd, toSubmit, 0, overflowed ? IORING_ENTER_GETEVENTS : 0);
+    return submitted < 0 ? -errno : submitted;
+}
+
+bool IoUring::RegisterBuffers(const iovec * buffers, unsigned count)
+{
+    return SysRegister(ringFd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+}
+
+bool IoUring::SetupBufferRing(uint16_t groupId, uint16_t entries)
+{
+    if ((entries & (entries - 1)) != 0)
+    {
+        return false; // Has to be a power of two
+    }
+    bufferRingSize = entries * sizeof(io_uring_buf);
+    void *ring = mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0); // Page aligned, as the kernel wants
+    if (ring == MAP_FAILED)
+    {
+        return false;
+    }
+    bufferRing = static_cast<io_uring_buf_ring*>(ring);
+    bufferRing->tail = 0;
+    bufferRingMask = static_cast<uint16_t>(entries - 1);
+    bufferRingLocalTail = 0;
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+    reg.ring_entries = entries;
+    reg.bgid = groupId;
+    if (SysRegister(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+    {
+        munmap(bufferRing, bufferRingSize);
+        bufferRing = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void IoUring::AddBuffer(void * address, uint32_t length, uint16_t bufferId)
+{
+    // Not bufferRing->bufs, in C++ the kernel header's flexible array comes out 8 bytes further in than in C
+    io_uring_buf &buffer = reinterpret_cast<io_uring_buf*>(bufferRing)[bufferRingLocalTail & bufferRingMask];
+    buffer.addr = reinterpret_cast<uint64_t>(address);
+    buffer.len = length;
+    buffer.bid = bufferId;
+    bufferRingLocalTail++;
+}
+
+void IoUring::CommitBuffers()
+{
+    reinterpret_cast<std::atomic<uint16_t>*>(&bufferRing->tail)->store(bufferRingLocalTail, std::memory_order_release);
+}
+#endif
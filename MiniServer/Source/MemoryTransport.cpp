@@ -0,0 +1,128 @@
+#include "MemoryTransport.hpp"
+#include <cstring>
+#include <string>
+
+// A simulated client's end of its stream connection, every send arrives the moment it's made
+class MemoryConnection : public StreamConnection
+{
+public:
+    MemoryConnection(MemoryTransport &InTransport, uint32_t InClient) : transport(&InTransport), clientIndex(InClient), client(&InTransport.GetClient(InClient)) {}
+
+    void StartReceive() override {} // Its client writes straight into the server's channel, see MemoryTransport::SendControl
+
+    SendResult Send(TCPMessage &msg) override
+    {
+        if (msg.type == TCPMessageType::YouAreConnected)
+        {
+            client->id = msg.data.youAreConnectedData.id;
+            client->connected = true;
+            transport->RequestDatagrams(clientIndex);
+        }
+        client->controlMessagesReceived++;
+        return SendResult::Queued;
+    }
+
+    void Close() override
+    {
+        client->connected = false;
+        client->id = UDPUnassignedId;
+    }
+
+    bool IsSlowConsumer(uint64_t now, uint64_t timeoutUs) override { return false; } // Never anything queued
+
+private:
+    MemoryTransport *transport;
+    uint32_t clientIndex;
+    MemoryClient *client;
+};
+
+MemoryTransport::MemoryTransport(uint32_t clientCount)
+    : handler(nullptr)
+    , receivePool(nullptr)
+    , tcpMessageChannel(nullptr)
+    , clients(clientCount)
+    , heldSlab(UDPReceivePool::NoSlab)
+    , datagramsDelivered(0)
+    , bytesDelivered(0)
+    , datagramsLost(0)
+{
+    for (uint32_t i = 0; i < clientCount; i++)
+    {
+        clients[i].endpoint = udp::endpoint(boost::asio::ip::address_v4::loopback(), static_cast<uint16_t>(i + 1));
+    }
+}
+
+bool MemoryTransport::Start(TransportHandler & InHandler, UDPReceivePool & InReceivePool, UDPSendBufferPool & sendPool, Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > & InTcpMessageChannel)
+{
+    handler = &InHandler;
+    receivePool = &InReceivePool;
+    tcpMessageChannel = &InTcpMessageChannel;
+    return true;
+}
+
+void MemoryTransport::Send(UDPSendBuffer * buffer, const udp::endpoint & to)
+{
+    MINISERVER_TRACE_SPAN("Memory send");
+    const uint32_t client = static_cast<uint32_t>(to.port()) - 1;
+    if (client < clients.size() && to.address().is_loopback())
+    {
+        clients[client].datagramsReceived++;
+        clients[client].bytesReceived += buffer->size;
+        datagramsDelivered++;
+        bytesDelivered += buffer->size;
+    }
+    else
+    {
+        datagramsLost++;
+    }
+    UDPSendBufferPool::Release(buffer);
+}
+
+void MemoryTransport::Connect(uint32_t client)
+{
+    handler->OnStreamAccepted(SharedPtr<StreamConnection>(MakeShareable(new MemoryConnection(*this, client))));
+}
+
+void MemoryTransport::RequestDatagrams(uint32_t client)
+{
+    MemoryClient &memoryClient = clients[client];
+    // Same as a real client, which has to be told its id before it can say where its datagrams go
+    char host[16] = "127.0.0.1";
+    char service[5] = {};
+    const std::string port = std::to_string(memoryClient.endpoint.port());
+    memcpy(service, port.data(), port.size()); // At most 5 digits, which the server doesn't need terminated
+    TCPMessageData data;
+    data.ipv4ConnectData = TCPMessageIWantToConnectIPv4Data(memoryClient.id, host, service);
+    TCPMessage request =
+    {
+        TCPMessageType::IWantToConnectIPv4,
+        0,
+        data
+    };
+    SendControl(client, request); // Straight into the channel, the tick that connected it reads it next
+}
+
+bool MemoryTransport::SendDatagram(uint32_t client, const UDPMessage & msg)
+{
+    uint16_t slab = heldSlab;
+    if (slab == UDPReceivePool::NoSlab && !receivePool->Acquire(0, slab))
+    {
+        handler->OnDatagramDropped();
+        return false;
+    }
+    heldSlab = UDPReceivePool::NoSlab;
+    const size_t bytes = WireEncode(msg, reinterpret_cast<uint8_t*>(&receivePool->Get(slab)), sizeof(UDPMessage));
+    if (!handler->OnDatagram(slab, bytes, clients[client].endpoint))
+    {
+        heldSlab = slab;
+        return false;
+    }
+    return true;
+}
+
+void MemoryTransport::SendControl(uint32_t client, TCPMessage & msg)
+{
+    QueuedTCPMessage queued = MakeQueuedTCPMessage(msg);
+    StampSender(queued, clients[client].id);
+    tcpMessageChannel->Write(queued);
+}
@@ -0,0 +1,41 @@
+#include "PacketAggregator.hpp"
+
+UDPSendBufferPool::UDPSendBufferPool(size_t InitialCount)
+    : cursor(0)
+{
+    buffers.reserve(InitialCount);
+    for (size_t i = 0; i < InitialCount; i++)
+    {
+        buffers.emplace_back(new UDPSendBuffer());
+        buffers.back()->inUse.store(false, std::memory_order_relaxed);
+        buffers.back()->index = static_cast<uint32_t>(i);
+        buffers.back()->size = 0;
+        buffers.back()->traceFlow = 0;
+    }
+}
+
+UDPSendBuffer * UDPSendBufferPool::Acquire()
+{
+    const size_t count = buffers.size();
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t index = (cursor + i) % count;
+        UDPSendBuffer *buffer = buffers[index].get();
+        if (!buffer->inUse.load(std::memory_order_acquire))
+        {
+            buffer->inUse.store(true, std::memory_order_relaxed);
+            cursor = index + 1;
+            return buffer;
+        }
+    }
+
+    // Everything is still out on the socket, more buffers it is
+    buffers.emplace_back(new UDPSendBuffer());
+    UDPSendBuffer *buffer = buffers.back().get();
+    buffer->inUse.store(true, std::memory_order_relaxed);
+    buffer->index = static_cast<uint32_t>(buffers.size() - 1);
+    buffer->size = 0;
+    buffer->traceFlow = 0;
+    cursor = 0;
+    return buffer;
+}
@@ -0,0 +1,169 @@
+#include "ProtocolSchema.hpp"
+
+// Which union member is live for each message type, indexed by the type. Rows with no encode are types that
+// never carry that union, and fail to decode
+static constexpr WireUnionCase<TCPMessageData> TCPDataCases[] =
+{
+    MINISERVER_WIRE_UNION_CASE(TCPMessageData, ipv4ConnectData), // IWantToConnectIPv4
+    MINISERVER_WIRE_UNION_CASE(TCPMessageData, ipv6ConnectData), // IWantToConnectIPv6
+    MINISERVER_WIRE_UNION_CASE(TCPMessageData, youAreConnectedData), // YouAreConnected
+    MINISERVER_WIRE_UNION_CASE(TCPMessageData, iAmDisconnectingData), // IAmDisconnecting
+    MINISERVER_WIRE_UNION_CASE(TCPMessageData, connectTellData), // ConnectTell
+    MINISERVER_WIRE_UNION_CASE(TCPMessageData, disconnectTellData), // DisconnectTell
+    MINISERVER_WIRE_UNION_CASE(TCPMessageData, snapshotData), // Snapshot
+    MINISERVER_WIRE_UNION_CASE(TCPMessageData, pingPongData), // Ping
+    MINISERVER_WIRE_UNION_CASE(TCPMessageData, pingPongData), // Pong
+    MINISERVER_WIRE_UNION_CASE(TCPMessageData, roomRedirectData) // RoomRedirect
+};
+static_assert(sizeof(TCPDataCases) / sizeof(TCPDataCases[0]) == WireEnum<TCPMessageType>::Count, "One row per TCPMessageType");
+
+static constexpr WireUnionCase<UDPReliableControlData> UDPControlCases[] =
+{
+    MINISERVER_WIRE_UNION_CASE(UDPReliableControlData, ipv4ConnectData), // IWantToConnectIPv4
+    { nullptr, nullptr, nullptr, 0 }, // IWantToConnectIPv6, the datagram's own address is used instead
+    MINISERVER_WIRE_UNION_CASE(UDPReliableControlData, youAreConnectedData), // YouAreConnected
+    MINISERVER_WIRE_UNION_CASE(UDPReliableControlData, iAmDisconnectingData), // IAmDisconnecting
+    MINISERVER_WIRE_UNION_CASE(UDPReliableControlData, connectTellData), // ConnectTell
+    MINISERVER_WIRE_UNION_CASE(UDPReliableControlData, disconnectTellData), // DisconnectTell
+    { nullptr, nullptr, nullptr, 0 }, // Snapshot, too big for a datagram
+    { nullptr, nullptr, nullptr, 0 }, // Ping, UDPMessageType::Ping instead
+    { nullptr, nullptr, nullptr, 0 }, // Pong, UDPMessageType::Pong instead
+    { nullptr, nullptr, nullptr, 0 } // RoomRedirect, the lobby is TCP only
+};
+static_assert(sizeof(UDPControlCases) / sizeof(UDPControlCases[0]) == WireEnum<TCPMessageType>::Count, "One row per TCPMessageType");
+
+static constexpr WireUnionCase<UDPMessageData> UDPDataCases[] =
+{
+    MINISERVER_WIRE_UNION_CASE(UDPMessageData, playerUpdateData), // PlayerUpdate
+    MINISERVER_WIRE_UNION_CASE(UDPMessageData, actuallyUpdateData), // ActuallyUpdate
+    MINISERVER_WIRE_UNION_CASE(UDPMessageData, stillThereData), // StillThere
+    MINISERVER_WIRE_UNION_CASE(UDPMessageData, stillHereData), // StillHere
+    MINISERVER_WIRE_UNION_CASE(UDPMessageData, reliableData), // Reliable
+    MINISERVER_WIRE_UNION_CASE(UDPMessageData, ackData), // Ack
+    MINISERVER_WIRE_UNION_CASE(UDPMessageData, pingPongData), // Ping
+    MINISERVER_WIRE_UNION_CASE(UDPMessageData, pingPongData) // Pong
+};
+static_assert(sizeof(UDPDataCases) / sizeof(UDPDataCases[0]) == WireEnum<UDPMessageType>::Count, "One row per UDPMessageType");
+
+// Writes the live member of a union and zeroes the rest, so nothing left over in memory goes out on the wire
+template<typename Union>
+static void EncodeUnion(const WireUnionCase<Union> &row, const Union &value, uint8_t *out)
+{
+    row.encode(value, out);
+    memset(out + row.size, 0, sizeof(Union) - row.size);
+}
+
+void WireCodec<TCPMessage>::Encode(const TCPMessage & value, uint8_t * out)
+{
+    WireCodec<TCPMessageType>::Encode(value.type, out);
+    WireCodec<uint64_t>::Encode(value.unixTimestamp, out + 1);
+    EncodeUnion(TCPDataCases[static_cast<uint8_t>(value.type)], value.data, out + 9);
+}
+
+bool WireCodec<TCPMessage>::Decode(const uint8_t * in, TCPMessage & value)
+{
+    if (!WireCodec<TCPMessageType>::Decode(in, value.type))
+    {
+        return false;
+    }
+    WireCodec<uint64_t>::Decode(in + 1, value.unixTimestamp);
+    return TCPDataCases[static_cast<uint8_t>(value.type)].decode(in + 9, value.data);
+}
+
+bool WireCodec<TCPMessage>::Validate(const TCPMessage & value)
+{
+    return WireCodec<TCPMessageType>::Validate(value.type)
+        && TCPDataCases[static_cast<uint8_t>(value.type)].validate(value.data);
+}
+
+void WireClearUnused<TCPMessage>::Clear(const TCPMessage & value, uint8_t * out)
+{
+    if (WireCodec<TCPMessageType>::Validate(value.type))
+    {
+        const size_t used = TCPDataCases[static_cast<uint8_t>(value.type)].size;
+        memset(out + 9 + used, 0, sizeof(TCPMessageData) - used);
+    }
+}
+
+void WireCodec<UDPReliableData>::Encode(const UDPReliableData & value, uint8_t * out)
+{
+    WireCodec<uint8_t>::Encode(value.id, out);
+    WireCodec<uint16_t>::Encode(value.sequence, out + 1);
+    WireCodec<uint16_t>::Encode(value.ack, out + 3);
+    WireCodec<uint32_t>::Encode(value.ackBits, out + 5);
+    WireCodec<TCPMessageType>::Encode(value.controlType, out + 9);
+    const WireUnionCase<UDPReliableControlData> &row = UDPControlCases[static_cast<uint8_t>(value.controlType)];
+    if (row.encode != nullptr)
+    {
+        EncodeUnion(row, value.control, out + 10);
+    }
+    else
+    {
+        memset(out + 10, 0, sizeof(UDPReliableControlData));
+    }
+}
+
+bool WireCodec<UDPReliableData>::Decode(const uint8_t * in, UDPReliableData & value)
+{
+    WireCodec<uint8_t>::Decode(in, value.id);
+    WireCodec<uint16_t>::Decode(in + 1, value.sequence);
+    WireCodec<uint16_t>::Decode(in + 3, value.ack);
+    WireCodec<uint32_t>::Decode(in + 5, value.ackBits);
+    if (!WireCodec<TCPMessageType>::Decode(in + 9, value.controlType))
+    {
+        return false;
+    }
+    const WireUnionCase<UDPReliableControlData> &row = UDPControlCases[static_cast<uint8_t>(value.controlType)];
+    return row.decode != nullptr && row.decode(in + 10, value.control);
+}
+
+bool WireCodec<UDPReliableData>::Validate(const UDPReliableData & value)
+{
+    if (!WireCodec<TCPMessageType>::Validate(value.controlType))
+    {
+        return false;
+    }
+    const WireUnionCase<UDPReliableControlData> &row = UDPControlCases[static_cast<uint8_t>(value.controlType)];
+    return row.validate != nullptr && row.validate(value.control);
+}
+
+void WireCodec<UDPMessage>::Encode(const UDPMessage & value, uint8_t * out)
+{
+    WireCodec<UDPMessageType>::Encode(value.type, out);
+    WireCodec<uint16_t>::Encode(value.sequence, out + 1);
+    WireCodec<uint64_t>::Encode(value.unixTimestamp, out + 3);
+    EncodeUnion(UDPDataCases[static_cast<uint8_t>(value.type)], value.data, out + 11);
+}
+
+bool WireCodec<UDPMessage>::Decode(const uint8_t * in, UDPMessage & value)
+{
+    if (!WireCodec<UDPMessageType>::Decode(in, value.type))
+    {
+        return false;
+    }
+    WireCodec<uint16_t>::Decode(in + 1, value.sequence);
+    WireCodec<uint64_t>::Decode(in + 3, value.unixTimestamp);
+    return UDPDataCases[static_cast<uint8_t>(value.type)].decode(in + 11, value.data);
+}
+
+bool WireCodec<UDPMessage>::Validate(const UDPMessage & value)
+{
+    return WireCodec<UDPMessageType>::Validate(value.type)
+        && UDPDataCases[static_cast<uint8_t>(value.type)].validate(value.data);
+}
+
+void WireClearUnused<UDPMessage>::Clear(const UDPMessage & value, uint8_t * out)
+{
+    if (!WireCodec<UDPMessageType>::Validate(value.type))
+    {
+        return;
+    }
+    size_t used = UDPDataCases[static_cast<uint8_t>(value.type)].size;
+    if (value.type == UDPMessageType::Reliable)
+    {
+        // The control message is a union too, only what controlType says is live
+        const TCPMessageType controlType = value.data.reliableData.controlType;
+        used = 10 + (WireCodec<TCPMessageType>::Validate(controlType) ? UDPControlCases[static_cast<uint8_t>(controlType)].size : 0);
+    }
+    memset(out + 11 + used, 0, sizeof(UDPMessageData) - used);
+}
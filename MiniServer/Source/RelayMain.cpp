@@ -0,0 +1,61 @@
+#include <iostream>
+#include <functional>
+#include <string>
+#include "SpectatorRelay.hpp"
+
+// Usage: MiniServerRelay --upstream <host> <port> [--port <port>] [--delay <ms>] [--max <subscribers>]
+// Takes the spectator stream from a server's spectatorPort, or another relay, and serves it on again, see SpectatorRelay.hpp
+int main(int argc, char *argv[])
+{
+    SpectatorRelayConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--upstream" && i + 2 < argc)
+        {
+            config.upstreamHost = argv[++i];
+            config.upstreamPort = static_cast<uint16_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--port" && i + 1 < argc)
+        {
+            config.port = static_cast<uint16_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--delay" && i + 1 < argc)
+        {
+            config.delayMs = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--max" && i + 1 < argc)
+        {
+            config.maxSubscribers = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+    }
+    if (config.upstreamPort == 0)
+    {
+        std::cout << "Usage: MiniServerRelay --upstream <host> <port> [--port <port>] [--delay <ms>] [--max <subscribers>]" << std::endl;
+        return 1;
+    }
+
+    boost::asio::io_service io_service;
+    SpectatorRelay relay(io_service, config);
+    if (!relay.Start())
+    {
+        return 1;
+    }
+
+    // Report on the io thread, where the counts live
+    boost::asio::deadline_timer reportTimer(io_service, boost::posix_time::seconds(5));
+    std::function<void(const boost::system::error_code&)> report = [&](const boost::system::error_code &error)
+    {
+        if (error)
+        {
+            return;
+        }
+        std::cout << relay.GetSubscriberCount() << " spectators, " << relay.GetFramesReceived() << " snapshots in, "
+            << relay.GetFramesSent() << " out, " << relay.GetFramesSuperseded() << " superseded" << std::endl;
+        reportTimer.expires_at(reportTimer.expires_at() + boost::posix_time::seconds(5));
+        reportTimer.async_wait(report);
+    };
+    reportTimer.async_wait(report);
+    io_service.run();
+    return 0;
+}
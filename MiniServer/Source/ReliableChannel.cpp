@@ -0,0 +1,188 @@
+#include "ReliableChannel.hpp"
+#include "GenericMemory.hpp"
+
+void ReliableChannel::Reset(uint8_t InId)
+{
+    id = InId;
+    for (auto &out : sendWindow)
+    {
+        out.inFlight = false;
+    }
+    for (auto &in : receiveWindow)
+    {
+        in.present = false;
+    }
+    backlogHead = 0;
+    backlogCount = 0;
+    stalled = false;
+    nextSendSequence = 0;
+    oldestUnacked = 0;
+    smoothedRtt = 0;
+    rttVariance = 0;
+    hasRttSample = false;
+    retransmits = 0;
+    nextDeliverSequence = 0;
+    remoteLatest = 0xFFFF; // So the first sequence (0) counts as newer
+    receivedBits = 0;
+    hasReceived = false;
+    ackPending = false;
+}
+
+void ReliableChannel::Send(TCPMessageType type, const UDPReliableControlData & data)
+{
+    if (backlogCount == BacklogSize)
+    {
+        stalled = true;
+        return;
+    }
+    BackloggedMessage &queued = backlog[(backlogHead + backlogCount) % BacklogSize];
+    queued.type = type;
+    queued.data = data;
+    backlogCount++;
+    FillWindow();
+}
+
+void ReliableChannel::FillWindow()
+{
+    while (backlogCount > 0 && static_cast<uint16_t>(nextSendSequence - oldestUnacked) < WindowSize)
+    {
+        OutgoingMessage &out = sendWindow[nextSendSequence % WindowSize];
+        out.inFlight = true;
+        out.sequence = nextSendSequence;
+        out.sends = 0;
+        out.lastSent = 0;
+        out.type = backlog[backlogHead].type;
+        out.data = backlog[backlogHead].data;
+        backlogHead = (backlogHead + 1) % BacklogSize;
+        backlogCount--;
+        nextSendSequence++;
+    }
+}
+
+void ReliableChannel::BuildPacket(const OutgoingMessage & out, UDPMessage & packet)
+{
+    packet.type = UDPMessageType::Reliable;
+    packet.sequence = 0; // Reliable messages have their own
+    packet.unixTimestamp = 0;
+    UDPReliableData &reliable = packet.data.reliableData;
+    reliable.id = id;
+    reliable.sequence = out.sequence;
+    reliable.ack = remoteLatest;
+    reliable.ackBits = receivedBits;
+    reliable.controlType = out.type;
+    reliable.control = out.data;
+    ackPending = false; // Piggybacked
+}
+
+void ReliableChannel::Receive(const UDPMessage & packet, uint64_t now)
+{
+    if (packet.type == UDPMessageType::Ack)
+    {
+        ProcessAck(packet.data.ackData.ack, packet.data.ackData.ackBits, now);
+        return;
+    }
+
+    const UDPReliableData &reliable = packet.data.reliableData;
+    if (reliable.id != UDPUnassignedId)
+    {
+        // Handshake packets from a client without an id can't be acking anything of ours yet
+        ProcessAck(reliable.ack, reliable.ackBits, now);
+    }
+
+    const uint16_t sequence = reliable.sequence;
+    ackPending = true; // Even duplicates get acked, the last ack might be what went missing
+
+    // Note it in the ack state
+    if (!hasReceived || SequenceGreaterThan(sequence, remoteLatest))
+    {
+        const uint16_t shift = hasReceived ? SequenceDistance(sequence, remoteLatest) : 0;
+        if (hasReceived)
+        {
+            receivedBits = shift >= 32 ? 0 : (receivedBits << shift);
+            if (shift <= 32) receivedBits |= 1u << (shift - 1); // The old latest is now in the bitfield
+        }
+        remoteLatest = sequence;
+        hasReceived = true;
+    }
+    else if (sequence != remoteLatest)
+    {
+        const uint16_t behind = SequenceDistance(remoteLatest, sequence);
+        if (behind <= 32) receivedBits |= 1u << (behind - 1);
+    }
+
+    // And hold it for in order delivery if it is new
+    if (SequenceLessThan(sequence, nextDeliverSequence) || SequenceDistance(sequence, nextDeliverSequence) >= WindowSize)
+    {
+        return; // Already delivered, or so far ahead the sender must be broken
+    }
+    IncomingMessage &in = receiveWindow[sequence % WindowSize];
+    if (!in.present)
+    {
+        in.present = true;
+        in.sequence = sequence;
+        in.type = reliable.controlType;
+        in.data = reliable.control;
+    }
+}
+
+bool ReliableChannel::Deliver(TCPMessageType & type, UDPReliableControlData & data)
+{
+    IncomingMessage &in = receiveWindow[nextDeliverSequence % WindowSize];
+    if (!in.present || in.sequence != nextDeliverSequence)
+    {
+        return false;
+    }
+    type = in.type;
+    data = in.data;
+    in.present = false;
+    nextDeliverSequence++;
+    return true;
+}
+
+void ReliableChannel::ProcessAck(uint16_t ack, uint32_t ackBits, uint64_t now)
+{
+    Acknowledge(ack, now);
+    while (ackBits)
+    {
+        Acknowledge(static_cast<uint16_t>(ack - 1 - CountTrailingZeros(ackBits)), now);
+        ackBits &= ackBits - 1;
+    }
+
+    while (oldestUnacked != nextSendSequence && !sendWindow[oldestUnacked % WindowSize].inFlight)
+    {
+        oldestUnacked++;
+    }
+    FillWindow();
+}
+
+void ReliableChannel::Acknowledge(uint16_t sequence, uint64_t now)
+{
+    if (SequenceLessThan(sequence, oldestUnacked) || !SequenceLessThan(sequence, nextSendSequence))
+    {
+        return; // Not something we have in flight
+    }
+    OutgoingMessage &out = sendWindow[sequence % WindowSize];
+    if (!out.inFlight || out.sequence != sequence)
+    {
+        return;
+    }
+    out.inFlight = false;
+
+    // Karn's rule, only time messages that went out once, otherwise we don't know which send this acks
+    if (out.sends == 1)
+    {
+        const uint64_t rtt = now - out.lastSent;
+        if (!hasRttSample)
+        {
+            smoothedRtt = rtt;
+            rttVariance = rtt / 2;
+            hasRttSample = true;
+        }
+        else
+        {
+            const uint64_t delta = smoothedRtt > rtt ? smoothedRtt - rtt : rtt - smoothedRtt;
+            rttVariance = (3 * rttVariance + delta) / 4;
+            smoothedRtt = (7 * smoothedRtt + rtt) / 8;
+        }
+    }
+}
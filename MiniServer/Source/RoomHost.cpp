@@ -0,0 +1,162 @@
+#include "RoomHost.hpp"
+#include <iostream>
+
+RoomHost::RoomHost(const RoomHostConfig & InConfig)
+    : config(InConfig)
+    , stopping(false)
+    , lobbyAcceptor(lobbyService)
+    , lobbySocket(lobbyService)
+{
+    for (uint32_t i = 0; i < config.roomCount; i++)
+    {
+        rooms.push_back(MakeUnique<Room>());
+    }
+}
+
+RoomHost::~RoomHost()
+{
+    Stop();
+}
+
+void RoomHost::Start()
+{
+    stopping.store(false);
+    for (uint32_t i = 0; i < rooms.size(); i++)
+    {
+        Room &room = *rooms[i];
+        room.tickThread = MakeUnique<std::thread>(&RoomHost::RoomThreadFunc, this, std::ref(room), i);
+    }
+
+    tcp::endpoint lobbyEndpoint(tcp::v4(), config.lobbyPort);
+    lobbyAcceptor.open(lobbyEndpoint.protocol());
+    lobbyAcceptor.set_option(tcp::acceptor::reuse_address(true));
+    lobbyAcceptor.bind(lobbyEndpoint);
+    lobbyAcceptor.listen();
+    LobbyAccept();
+    lobbyThread = MakeUnique<std::thread>([this]() { lobbyService.run(); });
+}
+
+void RoomHost::Stop()
+{
+    stopping.store(true);
+    for (auto &room : rooms)
+    {
+        if (room->tickThread.IsValid() && room->tickThread->joinable())
+        {
+            room->tickThread->join();
+        }
+    }
+    if (lobbyThread.IsValid() && lobbyThread->joinable())
+    {
+        lobbyService.stop();
+        lobbyThread->join();
+    }
+}
+
+void RoomHost::RoomThreadFunc(Room & room, uint32_t index)
+{
+    Trace::SetThreadName("Room tick");
+    if (config.pinThreads && !PinThreadToCore(index % std::thread::hardware_concurrency()))
+    {
+        std::cout << "Warning: couldn't pin room " << index << " to a core" << std::endl;
+    }
+
+    // Created here rather than in Start so everything the room allocates is first touched from its own core
+    ServerConfig roomConfig = config.roomConfig;
+    roomConfig.tcpPort = static_cast<uint16_t>(config.firstRoomPort + index);
+    roomConfig.udpPort = static_cast<uint16_t>(config.firstRoomPort + index);
+    if (!roomConfig.worldExportName.empty())
+    {
+        roomConfig.worldExportName += std::to_string(index); // Each room's world under a name of its own
+    }
+    if (!roomConfig.capturePath.empty())
+    {
+        roomConfig.capturePath += std::to_string(index); // Otherwise every room writes over the same file
+    }
+    if (!roomConfig.ipcSocketPath.empty())
+    {
+        roomConfig.ipcSocketPath += std::to_string(index); // Only one of them could bind it
+    }
+    if (roomConfig.spectatorPort != 0)
+    {
+        roomConfig.spectatorPort = static_cast<uint16_t>(roomConfig.spectatorPort + index);
+    }
+    pServer server = MakeUnique<Server>(room.ioService, roomConfig);
+
+    const uint64_t interval = static_cast<uint64_t>(config.tickIntervalMs) * 1000;
+    uint64_t nextTick = MonotonicMicroseconds();
+    while (!stopping.load(std::memory_order_relaxed))
+    {
+        server->Tick();
+        room.ticks.store(room.ticks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        room.players.store(server->GetPlayerCount(), std::memory_order_relaxed);
+
+        nextTick += interval;
+        const uint64_t now = MonotonicMicroseconds();
+        if (nextTick > now)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(nextTick - now));
+        }
+        else
+        {
+            nextTick = now; // Fell behind, don't try to catch up with a burst of ticks
+        }
+    }
+}
+
+void RoomHost::LobbyAccept()
+{
+    lobbyAcceptor.async_accept(lobbySocket, boost::bind(&RoomHost::lobbyHandleAccept, this, boost::asio::placeholders::error));
+}
+
+void RoomHost::lobbyHandleAccept(const boost::system::error_code & error)
+{
+    if (!error)
+    {
+        size_t best = 0;
+        for (size_t i = 1; i < rooms.size(); i++)
+        {
+            if (rooms[i]->players.load(std::memory_order_relaxed) < rooms[best]->players.load(std::memory_order_relaxed))
+            {
+                best = i;
+            }
+        }
+
+        const uint16_t port = static_cast<uint16_t>(config.firstRoomPort + best);
+        TCPMessageData data;
+        data.roomRedirectData =
+        {
+            static_cast<uint16_t>(best),
+            port,
+            port
+        };
+        TCPMessage redirect =
+        {
+            TCPMessageType::RoomRedirect,
+            static_cast<uint64_t>(std::time(nullptr)),
+            data
+        };
+        boost::array<uint8_t, WireSize<TCPMessage>::value> buffer;
+        WireEncode(redirect, buffer.c_array(), buffer.size());
+        boost::system::error_code writeError;
+        boost::asio::write(lobbySocket, boost::asio::buffer(buffer), writeError); // Fits in a fresh socket's send buffer, so this won't block
+        if (writeError)
+        {
+            std::cout << "Error: " << writeError.message() << std::endl;
+        }
+#ifdef _DEBUG
+        std::cout << "Lobby sent a client to room " << best << std::endl;
+#endif
+    }
+    else if (error == boost::asio::error::operation_aborted)
+    {
+        return; // Shutting down
+    }
+    else
+    {
+        std::cout << "Error: " << error.message() << std::endl;
+    }
+    boost::system::error_code closeError;
+    lobbySocket.close(closeError);
+    LobbyAccept();
+}
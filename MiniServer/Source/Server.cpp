@@ -1,12 +1,36 @@
 #include "Server.hpp"
+#include "SocketTransport.hpp"
+#include "ShmTransport.hpp"
 #include <iostream>
 
-Server::Server(boost::asio::io_service & io_service)
-    : ioService(&io_service)
-    , acceptor(io_service, tcp::endpoint(tcp::v4(), 4443))
-    , udpSocket(io_service)
+// A receive shard per UDP socket, and one more for the shared memory clients' thread
+static uint16_t ReceiveShardCount(const ServerConfig &config)
+{
+    if (config.offline)
+    {
+        return 1;
+    }
+    return static_cast<uint16_t>(config.udpShards + (config.ipcSocketPath.empty() ? 0 : 1));
+}
+
+Server::Server(boost::asio::io_service & io_service, const ServerConfig &InConfig, Transport *InTransport)
+    : tcpSnapshotTimer(io_service, boost::posix_time::millisec(InConfig.snapshotIntervalMs))
+    , timerActive(false)
+    , udpReceivePool(ReceiveShardCount(InConfig))
+    , udpPacketsDropped(0)
+    , udpPacketsHandled(0)
+    , udpBytesCopied(0)
+    , ioService(&io_service)
     , idPool(16)
-    , tcpSnapshotTimer(io_service, boost::posix_time::millisec(200)) // Arbitrary, but every 1/5s feels reasonable
+    , replayFailed(false)
+    , config(InConfig)
+    , nextPingTime(0)
+    , tickCount(0)
+    , ticksWithHeapAllocations(0)
+    , nextAllocationWarningTime(0)
+    , traceBatches(0)
+    , transformHistory(InConfig.historyFrames, static_cast<uint64_t>(InConfig.historyIntervalMs) * 1000)
+    , timerWheel(static_cast<uint64_t>(InConfig.timerResolutionMs) * 1000, MonotonicMicroseconds())
 {
     PlayerRecord fillerRecord;
     fillerRecord.id = -1;
@@ -14,109 +38,511 @@ Server::Server(boost::asio::io_service & io_service)
     playerRecords.fill(fillerRecord);
     oldPlayerRecords.fill(fillerRecord);
     activePlayers.fill(false);
-    playerRecordHistory.fill({ false, static_cast<uint64_t>(std::time(nullptr)) });
+    udpOnlyClients.fill(false);
+    latestSequences.fill(0);
+    priorityConfig.nearDistance = config.priorityNearDistance;
+    priorityConfig.falloffDistance = config.priorityFalloffDistance;
+    priorityConfig.bytesPerSecond = config.updateBytesPerSecond;
+    priorityConfig.burstBytes = config.updateBurstBytes;
+    for (auto &buffer : jitterBuffers)
+    {
+        buffer.Configure(config.jitterBufferDepth, static_cast<uint64_t>(config.jitterIntervalMs) * 1000);
+    }
+    lastHeardFrom.fill(0);
+    heartbeatTimers.fill(EventWheel::InvalidTimer);
+    idleTimers.fill(EventWheel::InvalidTimer);
+    if (!config.worldExportName.empty() && !worldExport.Open(config.worldExportName))
+    {
+        std::cout << "Warning: couldn't export the world to shared memory as " << config.worldExportName << std::endl;
+    }
+    PublishWorld(); // So there's something to read before the first tick
+
+    tcpConnections.fill(SharedPtr<StreamConnection>(nullptr));
+    PublishStreamConnections();
+
+    if (!config.capturePath.empty())
+    {
+        captureWriter.Open(config.capturePath, static_cast<uint64_t>(config.captureIndexIntervalMs) * 1000);
+    }
+
+    if (InTransport != nullptr)
+    {
+        transports.push_back(InTransport);
+        InTransport->Start(*this, udpReceivePool, udpSendPool, tcpMessageChannel);
+        return; // Driven by whoever passed it in, between ticks
+    }
+    if (config.offline)
+    {
+        return; // No sockets and no io thread, messages only arrive through Replay
+    }
 
-    udpInit(io_service);
-    tcpConnections.fill(SharedPtr<TCPConnection>(nullptr));
-    StartAccepting();
-    ioServiceThread = MakeUnique<std::thread>(std::mem_fun(&Server::ioServiceThreadFunc), this);
+#ifdef __linux__
+    if (!config.ipcSocketPath.empty())
+    {
+        std::unique_ptr<Transport> shm(new ShmTransport(config.ipcSocketPath, static_cast<uint16_t>(udpReceivePool.GetShardCount() - 1)));
+        if (shm->Start(*this, udpReceivePool, udpSendPool, tcpMessageChannel))
+        {
+            transports.push_back(shm.get());
+            ownedTransports.push_back(std::move(shm));
+        }
+    }
+#else
+    if (!config.ipcSocketPath.empty())
+    {
+        std::cout << "Warning: shared memory clients need Linux, local clients will have to use sockets" << std::endl;
+    }
+#endif
+    // Last, it takes whatever the others don't
+    ownedTransports.push_back(std::unique_ptr<Transport>(new SocketTransport(io_service, config)));
+    transports.push_back(ownedTransports.back().get());
+    transports.back()->Start(*this, udpReceivePool, udpSendPool, tcpMessageChannel);
+    if (config.spectatorPort != 0)
+    {
+        SpectatorRelayConfig spectatorConfig;
+        spectatorConfig.port = config.spectatorPort;
+        spectatorConfig.delayMs = config.spectatorDelayMs;
+        spectators = MakeUnique<SpectatorRelay>(io_service, spectatorConfig);
+        if (!spectators->Start())
+        {
+            spectators = nullptr;
+        }
+        else if (!timerActive.exchange(true))
+        {
+            tcpSnapshotTimer.async_wait(MakeAllocatingHandler(snapshotTimerHandler, boost::bind(&Server::SendSnapshots, this))); // Spectators want snapshots before any player connects
+        }
+    }
+    ioServiceThread = MakeUnique<std::thread>(&Server::ioServiceThreadFunc, this);
 }
 
 Server::~Server()
 {
-    ioService->stop();
-    ioService->reset(); // Probably not needed, but means if some how the server is destroyed but the io_service is reused it'll run again
-    ioServiceThread->join();
+    captureWriter.Close();
+    worldExport.Close();
+    if (ioServiceThread.IsValid())
+    {
+        ioService->stop();
+        ioServiceThread->join();
+        ioService->reset(); // Probably not needed, but means if some how the server is destroyed but the io_service is reused it'll run again. Not until the thread has seen the stop, or it can miss it and never return
+    }
+    for (Transport *transport : transports)
+    {
+        transport->Stop();
+    }
+    if (spectators.IsValid())
+    {
+        spectators->Stop();
+    }
 }
 
-void Server::StartAccepting()
+void Server::SendSnapshots()
 {
-    SharedPtr<TCPConnection> newConnection = TCPConnection::Create(acceptor.get_io_service(), &tcpMessageChannel);
-    acceptor.async_accept(
-        newConnection->GetSocket(),
-        boost::bind(&Server::tcpHandleAccept, this, newConnection, boost::asio::placeholders::error)
-    );
+    AllocationScope allocationScope(AllocationTag::Snapshots);
+    // From the last finished tick, this runs on the io thread while the tick carries on with the next
+    WorldState world;
+    publishedWorld.Read(world);
+    TCPMessageData snapshot;
+    snapshot.snapshotData =
+    {
+        world.records.data()
+    };
+    TCPMessage snapshotMsg =
+    {
+        TCPMessageType::Snapshot,
+        static_cast<uint64_t>(std::time(nullptr)),
+        snapshot
+    };
+    if (spectators.IsValid())
+    {
+        spectators->Publish(snapshotMsg);
+    }
+    SharedPtr<StreamConnections> connections;
+    {
+        std::unique_lock<std::mutex> lock(publishedConnectionsMutex);
+        connections = publishedConnections;
+    }
+    for (auto &connection : *connections)
+    {
+        if (connection.IsValid())
+        {
+            // A client still working through the last one gets this written over it, or skipped if its queue is full
+            if (connection->Send(snapshotMsg) == StreamConnection::SendResult::Queued)
+            {
+                std::cout << "Snapshot sent" << std::endl;
+            }
+        }
+    }
+
+    // Go again from when this one was due rather than from now, so the interval doesn't drift
+    tcpSnapshotTimer.expires_at(tcpSnapshotTimer.expires_at() + boost::posix_time::millisec(config.snapshotIntervalMs));
+    tcpSnapshotTimer.async_wait(MakeAllocatingHandler(snapshotTimerHandler, boost::bind(&Server::SendSnapshots, this)));
 }
 
-void Server::SendSnapshots()
+void Server::PublishWorld()
 {
-    for (auto &connection : tcpConnections)
+    WorldState world;
+    world.tick = tickCount;
+    world.records = playerRecords;
+    world.active = activePlayers;
+    publishedWorld.Publish(world);
+
+    if (worldExport.IsOpen())
     {
-        if (connection.IsValid())
+        WorldExportFrame frame;
+        frame.tick = tickCount;
+        frame.publishedUs = MonotonicMicroseconds();
+        for (uint32_t i = 0; i < WorldExportFrame::PlayerCount; i++)
         {
-            // Send them a snapshot
-            TCPMessageData snapshot;
-            snapshot.snapshotData =
+            const Transform &transform = playerRecords[i].transform;
+            WorldExportPlayer &player = frame.players[i];
+            player.id = playerRecords[i].id;
+            player.active = activePlayers[i] ? 1 : 0;
+            player.unused[0] = player.unused[1] = 0;
+            const Vector3 &position = transform.GetPosition();
+            const Vector3 &scale = transform.GetScale();
+            const Rotation &rotation = transform.GetRotation();
+            player.position[0] = position.x; player.position[1] = position.y; player.position[2] = position.z;
+            player.scale[0] = scale.x; player.scale[1] = scale.y; player.scale[2] = scale.z;
+            player.rotationDegrees = rotation.deg;
+            player.rotationAxis[0] = rotation.axis.x; player.rotationAxis[1] = rotation.axis.y; player.rotationAxis[2] = rotation.axis.z;
+        }
+        worldExport.Publish(frame);
+    }
+}
+
+void Server::SendPings(uint64_t now)
+{
+    for (int id = 0; id < 16; id++)
+    {
+        if (activePlayers[id] && (tcpConnections[id].IsValid() || udpOnlyClients[id]))
+        {
+            const ClockSync &sync = clockSync[id];
+            TCPMessageData data;
+            data.pingPongData =
             {
-                playerRecords.data()
+                static_cast<uint8_t>(id),
+                now,
+                sync.GetClockOffset(),
+                sync.GetSmoothedRtt()
             };
-            TCPMessage snapshotMsg =
+            TCPMessage pingMsg =
             {
-                TCPMessageType::Snapshot,
+                TCPMessageType::Ping,
                 static_cast<uint64_t>(std::time(nullptr)),
-                snapshot
+                data
             };
-            connection->Send(snapshotMsg);
-            std::cout << "Snapshot sent" << std::endl;
+            SendControl(static_cast<uint8_t>(id), pingMsg);
         }
     }
 }
 
-void Server::udpInit(boost::asio::io_service &io_service)
+void Server::StartPlayerTimers(uint8_t id, uint64_t now)
 {
-    udpSocket = udp::socket(io_service, udp::endpoint(udp::v4(), 4443));
-    udpReceive();
+    lastHeardFrom[id] = now;
+    heartbeatTimers[id] = timerWheel.Schedule(static_cast<uint64_t>(config.heartbeatIntervalMs) * 1000, { ScheduledEventType::Heartbeat, id });
+    idleTimers[id] = timerWheel.Schedule(static_cast<uint64_t>(config.idleTimeoutMs) * 1000, { ScheduledEventType::IdleTimeout, id });
 }
 
-void Server::udpSend(UDPMessage &msg, udp::endpoint udpEndpoint)
+void Server::HandleScheduledEvent(const ScheduledEvent & event, uint64_t now)
 {
-    memcpy(udpSendBuffer.c_array(), reinterpret_cast<uint8_t*>(&msg), sizeof(UDPMessage));
-    udpSocket.async_send_to(
-        boost::asio::buffer(udpSendBuffer),
-        udpEndpoint,
-        boost::bind(&Server::udpHandleSend, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)
-    );
-    std::cout << "UDP Message supposedly sent" << std::endl;
+    const uint8_t id = event.id;
+    if (!activePlayers[id])
+    {
+        return; // They left before this came due
+    }
+
+    switch (event.type)
+    {
+    case ScheduledEventType::Heartbeat:
+    {
+        const uint64_t heartbeatInterval = static_cast<uint64_t>(config.heartbeatIntervalMs) * 1000;
+        if (now - lastHeardFrom[id] >= heartbeatInterval && udpConnections[id].port() != 0)
+        {
+            UDPMessage probe;
+            probe.type = UDPMessageType::StillThere;
+            probe.sequence = 0;
+            probe.unixTimestamp = static_cast<uint64_t>(std::time(nullptr));
+            probe.data.stillThereData.sender = UDPMessageSender::Server;
+            udpQueue(id, probe);
+        }
+        heartbeatTimers[id] = timerWheel.Schedule(heartbeatInterval, event);
+        break;
+    }
+    case ScheduledEventType::IdleTimeout:
+    {
+        // Updates only bump lastHeardFrom, rather than cancelling and rescheduling this every packet
+        // we just check on expiry and push it back by however long is left
+        const uint64_t idleTimeout = static_cast<uint64_t>(config.idleTimeoutMs) * 1000;
+        const uint64_t idleFor = now - lastHeardFrom[id];
+        if (idleFor >= idleTimeout)
+        {
+            std::cout << "PlayerID: " << static_cast<char>(id + 48) << " timed out" << std::endl;
+            DisconnectPlayer(id, DisconnectType::Timeout);
+        }
+        else
+        {
+            idleTimers[id] = timerWheel.Schedule(idleTimeout - idleFor, event);
+        }
+        break;
+    }
+    }
 }
 
-void Server::udpReceive()
+void Server::DisconnectPlayer(uint8_t id, DisconnectType reason)
 {
-    udpSocket.async_receive(
-        boost::asio::buffer(udpRecvBuffer),
-        boost::bind(&Server::udpHandleReceive, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)
-    );
+    if (tcpConnections[id].IsValid())
+    {
+        tcpConnections[id]->Close();
+        tcpConnections[id].Reset();
+        PublishStreamConnections();
+    }
+    if (udpOnlyClients[id])
+    {
+        reliableChannels[id].Reset(UDPUnassignedId);
+        udpConnections[id] = udp::endpoint();
+        udpOnlyClients[id] = false;
+    }
+    activePlayers[id] = false;
+    udpAggregators[id].Discard();
+    jitterBuffers[id].Clear([this](uint16_t slab) { udpReceivePool.Release(slab); });
+    playerRecords[id].id = UDPUnassignedId;
+    for (auto &priorities : updatePriorities)
+    {
+        priorities.Forget(id);
+    }
+    ReleaseId(id);
+    timerWheel.Cancel(heartbeatTimers[id]);
+    timerWheel.Cancel(idleTimers[id]);
+    heartbeatTimers[id] = EventWheel::InvalidTimer;
+    idleTimers[id] = EventWheel::InvalidTimer;
+
+    // Tell all the other clients
+    TCPMessageData disconnectData;
+    disconnectData.disconnectTellData =
+    {
+        id,
+        reason
+    };
+    TCPMessage disconMsg =
+    {
+        TCPMessageType::DisconnectTell,
+        static_cast<uint64_t>(std::time(nullptr)),
+        disconnectData
+    };
+
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        if (activePlayers[i])
+        {
+            SendControl(i, disconMsg);
+        }
+    }
 }
 
-void Server::udpHandleReceive(const boost::system::error_code & error, std::size_t bytesTransferred)
+bool Server::ReserveId(uint8_t & id)
 {
-    if (!error)
+    std::unique_lock<std::mutex> lock(idPoolMutex);
+    if (idPool.GetNumUsed() >= 16)
     {
-        assert(bytesTransferred == UDPMessageSize); // Check the message we just received is the right size
-        UDPMessage *recvdMsg = reinterpret_cast<UDPMessage*>(udpRecvBuffer.c_array());
-        udpMessageChannel.Write(*recvdMsg);
-        std::cout << "UDP Message received" << std::endl;
+        return false; // Full
     }
-    else
+    id = static_cast<uint8_t>(idPool.GetNextID());
+    return true;
+}
+
+bool Server::ReserveReplayId(uint8_t id)
+{
     {
-        std::cout << "Error: " << error.message() << std::endl;
-#ifdef _DEBUG
-        abort();
-#endif
+        std::unique_lock<std::mutex> lock(idPoolMutex);
+        if (id < 16 && idPool.GetNumUsed() < 16 && idPool.ReserveID(id))
+        {
+            return true;
+        }
     }
+    std::cout << "Error: capture connects ID " << static_cast<uint32_t>(id) << " while it's in use, stopping the replay" << std::endl;
+    replayFailed = true;
+    return false;
+}
 
-    udpReceive(); // Back to the grind...
+void Server::ReleaseId(uint8_t id)
+{
+    std::unique_lock<std::mutex> lock(idPoolMutex);
+    idPool.ReturnID(id);
 }
 
-void Server::udpHandleSend(const boost::system::error_code & error, std::size_t bytesTransferred)
+void Server::SendControl(uint8_t id, TCPMessage & msg)
 {
-    if (!error)
+    if (tcpConnections[id].IsValid())
     {
-        std::cout << "UDP Message sent! " << std::endl;
+        tcpConnections[id]->Send(msg);
+        return;
     }
-    else
+    if (!udpOnlyClients[id])
     {
-        std::cout << "Error: " << error.message() << std::endl;
+        return;
     }
+
+    switch (msg.type)
+    {
+    case TCPMessageType::YouAreConnected:
+    case TCPMessageType::ConnectTell:
+    case TCPMessageType::DisconnectTell:
+    {
+        // Every member of UDPReliableControlData has the same layout as in TCPMessageData
+        UDPReliableControlData data;
+        memcpy(static_cast<void*>(&data), &msg.data, sizeof(UDPReliableControlData));
+        reliableChannels[id].Send(msg.type, data);
+        break;
+    }
+    case TCPMessageType::Ping:
+    {
+        // Unreliable, a resent ping would carry its first send's time and put the resend delay in the rtt.
+        // A lost one is just a missed sample, the next tick's SendPings is soon enough
+        UDPMessage packet;
+        packet.type = UDPMessageType::Ping;
+        packet.sequence = 0;
+        packet.unixTimestamp = msg.unixTimestamp;
+        packet.data.pingPongData = msg.data.pingPongData;
+        udpQueue(id, packet);
+        break;
+    }
+    default:
+        break; // Snapshots are too big for a datagram, UDP-only clients are brought up to date with ConnectTells instead
+    }
+}
+
+void Server::OnPlayerConnected(uint8_t id, uint64_t now)
+{
+    if (captureWriter.IsOpen())
+    {
+        captureWriter.RecordConnect(id, tickCount, now);
+    }
+    StartPlayerTimers(id, now);
+    jitterBuffers[id].Clear([this](uint16_t slab) { udpReceivePool.Release(slab); });
+    updatePriorities[id].Reset();
+    playerRecords[id].id = id;
+
+    // Communicate the new connection to all the other clients
+    TCPMessageData newConData;
+    newConData.connectTellData =
+    {
+        playerRecords[id]
+    };
+    TCPMessage newConMsg =
+    {
+        TCPMessageType::ConnectTell,
+        static_cast<uint64_t>(std::time(nullptr)),
+        newConData
+    };
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        if (activePlayers[i] && i != id) // No point telling the new connection about itself
+        {
+            SendControl(i, newConMsg);
+        }
+    }
+
+    if (udpOnlyClients[id])
+    {
+        // No snapshot for them, so introduce everyone already here one at a time instead
+        for (uint8_t i = 0; i < 16; i++)
+        {
+            if (activePlayers[i] && i != id)
+            {
+                TCPMessageData existingData;
+                existingData.connectTellData =
+                {
+                    playerRecords[i]
+                };
+                TCPMessage existingMsg =
+                {
+                    TCPMessageType::ConnectTell,
+                    static_cast<uint64_t>(std::time(nullptr)),
+                    existingData
+                };
+                SendControl(id, existingMsg);
+            }
+        }
+    }
+}
+
+void Server::udpQueue(uint8_t id, const UDPMessage & msg)
+{
+    if (udpConnections[id].port() == 0)
+    {
+        return; // Don't know where they are yet
+    }
+    udpAggregators[id].Append(udpSendPool, msg, [this, id](UDPSendBuffer *buffer) { udpSendDatagram(id, buffer); });
+}
+
+void Server::udpFlush()
+{
+    MINISERVER_TRACE_SPAN("Flush");
+    for (uint8_t id = 0; id < 16; id++)
+    {
+        udpAggregators[id].Flush([this, id](UDPSendBuffer *buffer) { udpSendDatagram(id, buffer); });
+    }
+}
+
+void Server::udpSendDatagram(uint8_t id, UDPSendBuffer * buffer)
+{
+    MINISERVER_TRACE_SPAN("Send batch");
+#if MINISERVER_TRACING
+    if (Trace::IsEnabled())
+    {
+        buffer->traceFlow = TraceBatchFlow(++traceBatches);
+        MINISERVER_TRACE_FLOW(FlowStart, "UDP batch", buffer->traceFlow);
+    }
+#endif
+    for (Transport *transport : transports)
+    {
+        if (transport->Owns(udpConnections[id]))
+        {
+            transport->Send(buffer, udpConnections[id]);
+            return;
+        }
+    }
+    UDPSendBufferPool::Release(buffer); // Offline, nothing to send it on
+}
+
+bool Server::OnDatagram(uint16_t slab, std::size_t bytesTransferred, const udp::endpoint & from)
+{
+    MINISERVER_TRACE_SPAN("UDP receive");
+    // Decoded and checked where the kernel put it (on little endian hosts decoding is just the checks),
+    // anything bad just gets received over
+    UDPMessage &msg = udpReceivePool.Get(slab);
+    if (!WireDecode(reinterpret_cast<const uint8_t*>(&msg), bytesTransferred, msg))
+    {
+        udpPacketsDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (msg.type == UDPMessageType::Pong)
+    {
+        msg.data.pingPongData.destinationTimestamp = MonotonicMicroseconds();
+    }
+    if (msg.type == UDPMessageType::Reliable && msg.data.reliableData.id == UDPUnassignedId)
+    {
+        // Only place we still know who sent it. Rare enough to copy, and the slab can go straight back to work
+        udpHandshakeChannel.Write({ msg, from, false, UDPUnassignedId });
+        return false;
+    }
+    if (msg.type == UDPMessageType::Reliable || msg.type == UDPMessageType::Ack || msg.type == UDPMessageType::Pong)
+    {
+        udpReceivePool.GetSender(slab) = from; // The handlers check it's who the id belongs to
+    }
+#ifdef _DEBUG
+    std::cout << "UDP Message received" << std::endl;
+#endif
+    if (msg.type == UDPMessageType::PlayerUpdate)
+    {
+        MINISERVER_TRACE_FLOW(FlowStart, "PlayerUpdate", TracePlayerUpdateFlow(msg.data.actuallyUpdateData.playerData.id, msg.sequence));
+    }
+    udpReceivePool.Publish(slab);
+    return true;
+}
+
+void Server::OnDatagramDropped()
+{
+    udpPacketsDropped.fetch_add(1, std::memory_order_relaxed);
 }
 
 void Server::udpHandleResolve(const boost::system::error_code & error, udp::resolver::iterator endpointIter, const uint8_t id)
@@ -135,14 +561,37 @@ void Server::udpHandleResolve(const boost::system::error_code & error, udp::reso
     }
 }
 
-void Server::tcpHandleAccept(SharedPtr<TCPConnection> newConnection, const boost::system::error_code & error)
+void Server::OnStreamAccepted(SharedPtr<StreamConnection> newConnection)
 {
-    if (!error)
+    AllocationScope allocationScope(AllocationTag::Accept);
+    // Everything about players belongs to the tick, which takes it from here, see AcceptStream
+    streamAcceptChannel.Write({ newConnection, UDPUnassignedId });
+}
+
+void Server::AcceptStream(PendingStream & pending, uint64_t now)
+{
+    SharedPtr<StreamConnection> &newConnection = pending.connection;
+    uint8_t id;
+    if (!newConnection.IsValid())
+    {
+        id = pending.replayId; // Offline, from Replay
+        if (!ReserveReplayId(id))
+        {
+            return;
+        }
+    }
+    else if (!ReserveId(id))
+    {
+        std::cout << "Server full, turning away connection" << std::endl;
+        newConnection->Close();
+        return;
+    }
+    tcpConnections[id] = newConnection;
+    udpOnlyClients[id] = false;
+    clockSync[id].Reset();
+    activePlayers[id] = true;
+    if (newConnection.IsValid())
     {
-        // Give the new connection an id and store it
-        uint8_t id = static_cast<uint8_t>(idPool.GetNextID());
-        tcpConnections[id].Reset(); // Make sure we clear anything which may be lingering
-        tcpConnections[id] = newConnection;
         newConnection->StartReceive();
         // Tell the new client who they are
         TCPMessageData data;
@@ -161,7 +610,7 @@ void Server::tcpHandleAccept(SharedPtr<TCPConnection> newConnection, const boost
         std::cout << "ID: " << static_cast<char>(id + 48) << " assigned to new connection" << std::endl;
 #endif
 
-        // Send them a snapshot
+        // Send them a snapshot, as of the last tick
         TCPMessageData snapshot;
         snapshot.snapshotData =
         {
@@ -175,172 +624,678 @@ void Server::tcpHandleAccept(SharedPtr<TCPConnection> newConnection, const boost
         };
         newConnection->Send(snapshotMsg);
 
-        // Communicate the new connection to all the other clients
-        TCPMessageData newConData;
-        newConData.connectTellData =
+        if (!timerActive.exchange(true)) // Not armed yet, so nothing on the io thread is touching it
         {
-            playerRecords[id]
-        };
-        TCPMessage newConMsg =
+            tcpSnapshotTimer.async_wait(MakeAllocatingHandler(snapshotTimerHandler, boost::bind(&Server::SendSnapshots, this)));
+        }
+    }
+    OnPlayerConnected(id, now);
+}
+
+void Server::PublishStreamConnections()
+{
+    SharedPtr<StreamConnections> connections = MakeShareable(new StreamConnections(tcpConnections));
+    std::unique_lock<std::mutex> lock(publishedConnectionsMutex);
+    publishedConnections = connections;
+}
+
+
+bool Server::Tick()
+{
+    return Tick(MonotonicMicroseconds());
+}
+
+bool Server::Tick(uint64_t now)
+{
+    MINISERVER_TRACE_SPAN("Tick");
+    AllocationScope allocationScope(AllocationTag::Tick);
+    // Everything transient this tick comes out of the arena, which is emptied here rather than freed piecemeal
+    FrameArena &arena = FrameArena::ThreadLocal();
+    arena.Reset();
+#ifdef MINISERVER_COUNT_ALLOCATIONS
+    const uint64_t heapAllocationsAtStart = HeapAllocationCount();
+#endif
+
+    if (now >= nextPingTime)
+    {
+        SendPings(now);
+        nextPingTime = now + static_cast<uint64_t>(config.pingIntervalMs) * 1000;
+    }
+
+    // Take on anyone whose connection was accepted since last tick
+    if (!streamAcceptChannel.Empty())
+    {
+        ArenaVector<PendingStream> accepted{ ArenaAllocator<PendingStream>(arena) };
+        streamAcceptChannel.ReadAll(accepted);
+        for (PendingStream &pending : accepted)
         {
-            TCPMessageType::ConnectTell,
-            static_cast<uint64_t>(std::time(nullptr)),
-            newConData
-        };
+            AcceptStream(pending, now);
+        }
+        PublishStreamConnections();
+    }
+    timerWheel.Advance(now, [this, now](const ScheduledEvent &event) { HandleScheduledEvent(event, now); });
 
-        for (int i = 0; i < 16; i++)
+    // Drop clients that can't keep up before their send queues cost anything more. For UDP-only clients that's
+    // a ReliableChannel that filled its backlog or gave up resending
+    const uint64_t slowConsumerTimeout = static_cast<uint64_t>(config.slowConsumerTimeoutMs) * 1000;
+    for (uint8_t id = 0; id < 16; id++)
+    {
+        if (activePlayers[id] && ((tcpConnections[id].IsValid() && tcpConnections[id]->IsSlowConsumer(now, slowConsumerTimeout))
+            || (udpOnlyClients[id] && reliableChannels[id].IsStalled())))
         {
-            if (activePlayers[i] && i != id) // No point telling the new connection about itself
+            std::cout << "Client " << static_cast<int>(id) << " fell too far behind, disconnecting" << std::endl;
+            DisconnectPlayer(id, DisconnectType::SlowConsumer);
+        }
+    }
+    
+    // Take each channel's backlog in one go rather than locking once per message
+    if (!tcpMessageChannel.Empty())
+    {
+        MINISERVER_TRACE_SPAN("TCP messages");
+        ArenaVector<QueuedTCPMessage> tcpMessages{ ArenaAllocator<QueuedTCPMessage>(arena) };
+        tcpMessages.reserve(16);
+        tcpMessageChannel.ReadAll(tcpMessages);
+        for (QueuedTCPMessage &msg : tcpMessages)
+        {
+            if (captureWriter.IsOpen())
             {
-                tcpConnections[i]->Send(newConMsg);
+                captureWriter.RecordTCP(MakeTCPMessage(msg), tickCount, now); // Captures keep the full TCPMessage, so older ones still replay
             }
+            tcpHandleMessage(msg, now);
         }
+    }
 
-        if (!timerActive)
+    if (!udpHandshakeChannel.Empty())
+    {
+        ArenaVector<PendingHandshake> handshakes{ ArenaAllocator<PendingHandshake>(arena) };
+        udpHandshakeChannel.ReadAll(handshakes);
+        for (PendingHandshake &handshake : handshakes)
         {
-            tcpSnapshotTimer.async_wait(boost::bind(&Server::SendSnapshots, this));
-            timerActive = true;
+            udpHandleHandshake(handshake, now);
         }
     }
-    else
+
+    for (Transport *transport : transports)
     {
-        std::cout << "Error: " << error.message() << std::endl;
+        transport->Poll(); // Anything a transport does on this thread rather than its own, e.g. io_uring's receives
+    }
+
+    // UDP messages are read where they were received, and the slab goes back unless a jitter buffer kept it
+    udpPacketsHandled += udpReceivePool.ConsumeAll([this, now](uint16_t slab)
+    {
+        MINISERVER_TRACE_SPAN("Handle datagram");
+        UDPMessage &msg = udpReceivePool.Get(slab);
+        if (msg.type == UDPMessageType::PlayerUpdate)
+        {
+            MINISERVER_TRACE_FLOW(FlowStep, "PlayerUpdate", TracePlayerUpdateFlow(msg.data.actuallyUpdateData.playerData.id, msg.sequence));
+        }
+        if (captureWriter.IsOpen())
+        {
+            captureWriter.RecordUDP(msg, tickCount, now);
+        }
+        if (!udpHandleMessage(msg, slab, now))
+        {
+            udpReceivePool.Release(slab);
+        }
+    });
+
+    // Apply whatever PlayerUpdates are due, in order, which relays them on to everyone else too
+    for (uint8_t id = 0; id < 16; id++)
+    {
+        if (activePlayers[id])
+        {
+            jitterBuffers[id].Release(now, [this](uint16_t slab)
+            {
+                MINISERVER_TRACE_SPAN("Apply update");
+                UDPMessage &msg = udpReceivePool.Get(slab);
+                MINISERVER_TRACE_FLOW(FlowStep, "PlayerUpdate", TracePlayerUpdateFlow(msg.data.actuallyUpdateData.playerData.id, msg.sequence));
+                ApplyPlayerUpdate(msg);
+                udpReceivePool.Release(slab);
+            });
+        }
+    }
+
+    {
+        MINISERVER_TRACE_SPAN("Send player updates");
+        SendPlayerUpdates(now);
+    }
+
+    // Send, resend and ack control messages for the clients without TCP
+    const uint64_t minRto = static_cast<uint64_t>(config.reliableMinRtoMs) * 1000;
+    for (uint8_t id = 0; id < 16; id++)
+    {
+        if (activePlayers[id] && udpOnlyClients[id])
+        {
+            reliableChannels[id].Update(now, minRto, [this, id](UDPMessage &packet) { udpQueue(id, packet); });
+        }
+    }
+
+    // Everything queued for each client this tick goes out together
+    udpFlush();
+    for (Transport *transport : transports)
+    {
+        transport->Flush();
+    }
+
+    if (transformHistory.ShouldRecord(now))
+    {
+        transformHistory.Record(now, tickCount, playerRecords, activePlayers);
+    }
+    PublishWorld();
+    tickCount++;
+
+#ifdef MINISERVER_COUNT_ALLOCATIONS
+    const uint64_t tickAllocations = HeapAllocationCount() - heapAllocationsAtStart;
+    if (tickAllocations > 0)
+    {
+        ticksWithHeapAllocations++;
+        if (config.allocationFreeAfterTicks != 0 && tickCount > config.allocationFreeAfterTicks)
+        {
+            std::cout << "Error: " << tickAllocations << " heap allocations in tick " << tickCount - 1 << ", which should have stopped allocating by now" << std::endl;
+            AllocationTracker::Report(std::cout);
+            abort();
+        }
+        if (now >= nextAllocationWarningTime) // Once a second is plenty to notice
+        {
+            std::cout << "Warning: " << tickAllocations << " heap allocations in tick " << tickCount - 1 << " ("
+                << ticksWithHeapAllocations << " ticks have allocated so far, arena high water " << arena.GetHighWater() << " bytes)" << std::endl;
+            nextAllocationWarningTime = now + 1000000;
+        }
+    }
+#endif
+
+    return true;
+}
+
+void Server::tcpHandleMessage(QueuedTCPMessage & msg, uint64_t now)
+{
+    // Indexed by type, so dispatch is a bounds check and an indirect call rather than a switch
+    using Handler = void (Server::*)(QueuedTCPMessage&, uint64_t);
+    static constexpr Handler handlers[] =
+    {
+        &Server::tcpHandleConnectIPv4, // IWantToConnectIPv4
+        &Server::tcpHandleConnectIPv6, // IWantToConnectIPv6
+        &Server::tcpHandleUnexpected, // YouAreConnected
+        &Server::tcpHandleDisconnecting, // IAmDisconnecting
+        &Server::tcpHandleUnexpected, // ConnectTell
+        &Server::tcpHandleUnexpected, // DisconnectTell
+        &Server::tcpHandleUnexpected, // Snapshot
+        &Server::tcpHandleUnexpected, // Ping
+        &Server::tcpHandlePong, // Pong
+        &Server::tcpHandleUnexpected // RoomRedirect
+    };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == WireEnum<TCPMessageType>::Count, "One handler per TCPMessageType");
+
+    const uint8_t type = static_cast<uint8_t>(msg.type);
+    if (type >= WireEnum<TCPMessageType>::Count)
+    {
+        tcpHandleUnexpected(msg, now);
+        return;
+    }
+    (this->*handlers[type])(msg, now);
+}
+
+void Server::tcpHandleConnectIPv4(QueuedTCPMessage & msg, uint64_t now)
+{
+    TCPMessageIWantToConnectIPv4Data data = msg.data.ipv4ConnectData;
+    // Neither string is guaranteed to be terminated, the service can fill its whole 5 chars
+    udpSetEndpoint(data.id, udp::v4(), std::string(data.host, strnlen(data.host, sizeof(data.host))), std::string(data.service, strnlen(data.service, sizeof(data.service))));
+}
+
+void Server::tcpHandleConnectIPv6(QueuedTCPMessage & msg, uint64_t now)
+{
+    TCPMessageIWantToConnectIPv6Data data = msg.data.ipv6ConnectData;
+    udpSetEndpoint(data.id, udp::v6(), std::string(data.host, strnlen(data.host, sizeof(data.host))), std::string(data.service, strnlen(data.service, sizeof(data.service))));
+}
+
+void Server::udpSetEndpoint(uint8_t id, const udp &protocol, const std::string &host, const std::string &service)
+{
+    if (id >= 16)
+    {
+        return;
+    }
+    // Clients send a numeric address and port, which don't need the resolver (or an io thread to run it on)
+    boost::system::error_code error;
+    const boost::asio::ip::address address = boost::asio::ip::make_address(host, error);
+    char *end = nullptr;
+    const unsigned long port = strtoul(service.c_str(), &end, 10);
+    if (!error && !service.empty() && *end == '\0' && port <= 0xFFFF)
+    {
+        udpConnections[id] = udp::endpoint(address, static_cast<uint16_t>(port));
+        return;
+    }
+    if (!ioServiceThread.IsValid())
+    {
+        std::cout << "Error: can't resolve " << host << ":" << service << " without an io thread" << std::endl;
+        return;
+    }
+    udp::resolver::query query(protocol, host, service);
+    udp::resolver resolver(*ioService);
+    resolver.async_resolve(
+        query,
+        boost::bind(&Server::udpHandleResolve, this, boost::asio::placeholders::error, boost::asio::placeholders::iterator, id)
+    );
+}
+
+void Server::tcpHandleDisconnecting(QueuedTCPMessage & msg, uint64_t now)
+{
+    TCPMessageIAmDisconnectingData data = msg.data.iAmDisconnectingData;
+    if (data.id < 16 && activePlayers[data.id])
+    {
+        DisconnectPlayer(data.id, DisconnectType::Standard);
+    }
+}
+
+void Server::tcpHandlePong(QueuedTCPMessage & msg, uint64_t now)
+{
+    HandlePong(msg.data.pingPongData, now);
+}
+
+void Server::HandlePong(const TCPMessagePingPongData & data, uint64_t now)
+{
+    if (data.id < 16 && activePlayers[data.id])
+    {
+        lastHeardFrom[data.id] = now;
+        clockSync[data.id].AddSample(data);
 #ifdef _DEBUG
-        abort();
+        std::cout << "PlayerID: " << static_cast<char>(data.id + 48) << " RTT: " << clockSync[data.id].GetSmoothedRtt()
+            << "us Jitter: " << clockSync[data.id].GetJitter() << "us Offset: " << clockSync[data.id].GetClockOffset() << "us" << std::endl;
 #endif
     }
+}
 
-    StartAccepting(); // Wait for a new connection
+void Server::tcpHandleUnexpected(QueuedTCPMessage & msg, uint64_t now)
+{
+    std::cout << "Unrecognised TCP Message Type!" << std::endl;
 }
 
+bool Server::udpHandleMessage(UDPMessage & msg, uint16_t slab, uint64_t now)
+{
+    // As tcpHandleMessage
+    using Handler = bool (Server::*)(UDPMessage&, uint16_t, uint64_t);
+    static constexpr Handler handlers[] =
+    {
+        &Server::udpHandlePlayerUpdate, // PlayerUpdate
+        &Server::udpHandleUnexpected, // ActuallyUpdate
+        &Server::udpHandleUnexpected, // StillThere
+        &Server::udpHandleStillHere, // StillHere
+        &Server::udpHandleReliable, // Reliable
+        &Server::udpHandleReliable, // Ack
+        &Server::udpHandleUnexpected, // Ping
+        &Server::udpHandlePong // Pong
+    };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == WireEnum<UDPMessageType>::Count, "One handler per UDPMessageType");
 
-bool Server::Tick()
+    const uint8_t type = static_cast<uint8_t>(msg.type);
+    if (type >= WireEnum<UDPMessageType>::Count)
+    {
+        return udpHandleUnexpected(msg, slab, now);
+    }
+    return (this->*handlers[type])(msg, slab, now);
+}
+
+bool Server::udpHandlePlayerUpdate(UDPMessage & msg, uint16_t slab, uint64_t now)
 {
-    for (auto &record : playerRecordHistory)
+    const uint8_t id = msg.data.actuallyUpdateData.playerData.id;
+    if (id >= 16 || !activePlayers[id])
     {
-        record.UpdatedThisFrame = false;
+        return false;
     }
-    
-    while (!tcpMessageChannel.Empty())
+    lastHeardFrom[id] = now;
+    // Late and duplicate updates are dropped here, the rest keep their slab and come out through ApplyPlayerUpdate
+    return jitterBuffers[id].Insert(msg.sequence, slab, [this](uint16_t dropped) { udpReceivePool.Release(dropped); })
+        == JitterBuffer<uint16_t>::InsertResult::Accepted;
+}
+
+bool Server::udpHandleStillHere(UDPMessage & msg, uint16_t slab, uint64_t now)
+{
+    if (msg.data.stillHereData.id < 16)
     {
-        TCPMessage msg = tcpMessageChannel.Read();
-        switch (msg.type)
-        {
-        case TCPMessageType::IWantToConnectIPv4:
+        lastHeardFrom[msg.data.stillHereData.id] = now;
+    }
+    return false;
+}
+
+bool Server::udpHandlePong(UDPMessage & msg, uint16_t slab, uint64_t now)
+{
+    const uint8_t id = msg.data.pingPongData.id;
+    if (id < 16 && udpOnlyClients[id] && udpReceivePool.GetSender(slab) == udpConnections[id])
+    {
+        HandlePong(msg.data.pingPongData, now);
+    }
+    return false;
+}
+
+bool Server::udpHandleReliable(UDPMessage & msg, uint16_t slab, uint64_t now)
+{
+    const uint8_t id = msg.type == UDPMessageType::Reliable ? msg.data.reliableData.id : msg.data.ackData.id;
+    if (id >= 16 || !udpOnlyClients[id] || udpReceivePool.GetSender(slab) != udpConnections[id])
+    {
+        return false; // Not from the address that handshook for the id, so not theirs to speak for
+    }
+    lastHeardFrom[id] = now;
+    reliableChannels[id].Receive(msg, now);
+    if (msg.type == UDPMessageType::Reliable)
+    {
+        udpBytesCopied += sizeof(UDPReliableControlData); // Held in the channel until it can be delivered in order
+    }
+    udpDeliverReliable(id, now);
+    return false;
+}
+
+bool Server::udpHandleUnexpected(UDPMessage & msg, uint16_t slab, uint64_t now)
+{
+    std::cout << "Unrecognised UDP Message Type!" << std::endl;
+    return false;
+}
+
+void Server::ApplyPlayerUpdate(UDPMessage & msg)
+{
+    const PlayerRecord &newRecord = msg.data.actuallyUpdateData.playerData;
+    oldPlayerRecords[newRecord.id] = playerRecords[newRecord.id]; // Save the old record
+    playerRecords[newRecord.id] = newRecord; // Store the new record, the one copy out of the slab
+    udpBytesCopied += sizeof(PlayerRecord);
+
+#ifdef _DEBUG
+    Vector3 playerPos = newRecord.transform.GetPosition();
+    std::cout << "PlayerID: " << static_cast<char>(newRecord.id+48) << " Pos(" << playerPos.x << ", " << playerPos.y << ", " << playerPos.z << ")" << std::endl;
+#endif
+
+    // The other clients hear about it when their budgets allow, see SendPlayerUpdates. The sequence goes with it
+    // so they can order it too
+    latestSequences[newRecord.id] = msg.sequence;
+    for (uint8_t id = 0; id < 16; id++)
+    {
+        if (activePlayers[id] && id != newRecord.id)
         {
-            TCPMessageIWantToConnectIPv4Data data = msg.data.ipv4ConnectData;
-            udp::resolver::query query(udp::v4(), data.host, data.service);
-            udp::resolver resolver(*ioService);
-            resolver.async_resolve(
-                query,
-                boost::bind(&Server::udpHandleResolve, this, boost::asio::placeholders::error, boost::asio::placeholders::iterator, data.id)
-            );
-            break;
+            updatePriorities[id].MarkChanged(newRecord.id);
         }
-        case TCPMessageType::IWantToConnectIPv6:
+    }
+}
+
+void Server::SendPlayerUpdates(uint64_t now)
+{
+    UDPMessage relay;
+    memset(static_cast<void*>(&relay), 0, sizeof(relay));
+    relay.type = UDPMessageType::PlayerUpdate;
+    relay.unixTimestamp = static_cast<uint64_t>(std::time(nullptr));
+    relay.data.playerUpdateData.sender = UDPMessageSender::Server;
+
+    for (uint8_t id = 0; id < 16; id++)
+    {
+        if (!activePlayers[id])
         {
-            TCPMessageIWantToConnectIPv6Data data = msg.data.ipv6ConnectData;
-            udp::resolver::query query(udp::v6(), data.host, data.service);
-            udp::resolver resolver(*ioService);
-            resolver.async_resolve(
-                query,
-                boost::bind(&Server::udpHandleResolve, this, boost::asio::placeholders::error, boost::asio::placeholders::iterator, data.id)
-            );
-            break;
+            continue;
         }
-        case TCPMessageType::IAmDisconnecting:
+        // Always the newest state, however long the update waited
+        updatePriorities[id].Select(now, playerRecords[id].transform.GetPosition(), playerRecords, priorityConfig, WireSize<UDPMessage>::value,
+            [this, id, &relay](uint8_t player)
         {
-            TCPMessageIAmDisconnectingData data = msg.data.iAmDisconnectingData;
-            tcpConnections[data.id]->Close();
-            tcpConnections[data.id].Reset();
-            activePlayers[data.id] = false;
-            idPool.ReturnID(data.id);
+            // Just a step on the update's flow, it's inside Send player updates, a span for each of these is most of a tick's events
+            MINISERVER_TRACE_FLOW(FlowStep, "PlayerUpdate", TracePlayerUpdateFlow(player, latestSequences[player]));
+            relay.sequence = latestSequences[player];
+            relay.data.playerUpdateData.playerData = playerRecords[player];
+            udpQueue(id, relay);
+        });
+    }
+}
 
-            // Tell all the other clients
-            TCPMessageData disconnectData;
-            disconnectData.disconnectTellData =
-            {
-                data.id,
-                DisconnectType::Standard
-            };
-            TCPMessage disconMsg =
-            {
-                TCPMessageType::DisconnectTell,
-                static_cast<uint64_t>(std::time(nullptr)),
-                disconnectData
-            };
+static void ToCaptureEndpoint(const udp::endpoint &endpoint, CaptureEndpoint &out)
+{
+    memset(&out, 0, sizeof(out));
+    out.isV6 = endpoint.address().is_v6() ? 1 : 0;
+    if (out.isV6)
+    {
+        auto bytes = endpoint.address().to_v6().to_bytes();
+        memcpy(out.address, bytes.data(), bytes.size());
+    }
+    else
+    {
+        auto bytes = endpoint.address().to_v4().to_bytes();
+        memcpy(out.address, bytes.data(), bytes.size());
+    }
+    out.port = endpoint.port();
+}
 
-            for (int i = 0; i < 16; i++)
-            {
-                if (activePlayers[i])
-                {
-                    tcpConnections[i]->Send(disconMsg);
-                }
-            }
+static udp::endpoint FromCaptureEndpoint(const CaptureEndpoint &endpoint)
+{
+    if (endpoint.isV6)
+    {
+        boost::asio::ip::address_v6::bytes_type bytes;
+        memcpy(bytes.data(), endpoint.address, bytes.size());
+        return udp::endpoint(boost::asio::ip::address_v6(bytes), endpoint.port);
+    }
+    boost::asio::ip::address_v4::bytes_type bytes;
+    memcpy(bytes.data(), endpoint.address, bytes.size());
+    return udp::endpoint(boost::asio::ip::address_v4(bytes), endpoint.port);
+}
 
-            break;
-        }
-        case TCPMessageType::Pong:
+void Server::udpHandleHandshake(PendingHandshake & handshake, uint64_t now)
+{
+    udpBytesCopied += 2 * sizeof(UDPMessage); // Into the handshake channel and back out
+    if (captureWriter.IsOpen())
+    {
+        CaptureHandshake record;
+        ToCaptureEndpoint(handshake.endpoint, record.endpoint);
+        record.msg = handshake.msg;
+        captureWriter.RecordHandshake(record, tickCount, now);
+    }
+
+    // A resend from someone we've already let in, because they haven't heard back yet
+    for (uint8_t id = 0; id < 16; id++)
+    {
+        if (udpOnlyClients[id] && udpConnections[id] == handshake.endpoint)
         {
-            // Work out roundtrip time here
-            break;
+            lastHeardFrom[id] = now;
+            reliableChannels[id].Receive(handshake.msg, now); // Just gets acked again
+            udpDeliverReliable(id, now);
+            return;
         }
-        default:
-            std::cout << "Unrecognised TCP Message Type!" << std::endl;
-            break;
+    }
+
+    if (handshake.msg.data.reliableData.controlType != TCPMessageType::IWantToConnectIPv4
+        && handshake.msg.data.reliableData.controlType != TCPMessageType::IWantToConnectIPv6)
+    {
+        return; // Anything else from a stranger is noise
+    }
+
+    uint8_t id = handshake.replayId;
+    if (handshake.replayed)
+    {
+        // Whatever id the capture gave it, and if it gave it none it was turned away then too
+        if (id == UDPUnassignedId || !ReserveReplayId(id))
+        {
+            return;
         }
     }
+    else if (!ReserveId(id))
+    {
+        std::cout << "Server full, ignoring UDP handshake" << std::endl;
+        return;
+    }
+    udpConnections[id] = handshake.endpoint;
+    udpOnlyClients[id] = true;
+    clockSync[id].Reset();
+    reliableChannels[id].Reset(id);
+    reliableChannels[id].Receive(handshake.msg, now);
+    udpDeliverReliable(id, now);
+
+    // Tell the new client who they are
+    TCPMessageData data;
+    data.youAreConnectedData =
+    {
+        id
+    };
+    TCPMessage response =
+    {
+        TCPMessageType::YouAreConnected,
+        static_cast<uint64_t>(std::time(nullptr)),
+        data
+    };
+    SendControl(id, response);
+#ifdef _DEBUG
+    std::cout << "ID: " << static_cast<char>(id + 48) << " assigned to new UDP client" << std::endl;
+#endif
 
-    while (!udpMessageChannel.Empty())
+    activePlayers[id] = true;
+    OnPlayerConnected(id, now);
+}
+
+void Server::udpDeliverReliable(uint8_t id, uint64_t now)
+{
+    QueuedTCPMessage control;
+    UDPReliableControlData data;
+    while (udpOnlyClients[id] && reliableChannels[id].Deliver(control.type, data))
     {
-        UDPMessage msg = udpMessageChannel.Read();
-        switch (msg.type)
+        if (control.type == TCPMessageType::IWantToConnectIPv4 || control.type == TCPMessageType::IWantToConnectIPv6)
         {
-        case UDPMessageType::PlayerUpdate:
+            continue; // The handshake, already dealt with
+        }
+        control.unixTimestamp = static_cast<uint64_t>(std::time(nullptr));
+        memcpy(static_cast<void*>(&control.data), &data, sizeof(UDPReliableControlData)); // Same layouts, the queued form just has the IPv6 connect as well
+
+        StampSender(control, id);
+        tcpHandleMessage(control, now);
+    }
+}
+
+bool Server::Replay(CaptureReader & reader, uint64_t & replayed)
+{
+    // Records are grouped by the tick that handled them, so feed each group back through the channels and
+    // run a Tick over it. Recorded times are shifted to start from now so the timing wheel and history,
+    // which were set up against the live clock, see a sensible timeline
+    const uint64_t timeBase = MonotonicMicroseconds();
+    uint64_t firstTimestamp = 0;
+    uint64_t currentTick = UINT64_MAX;
+    uint64_t tickTime = timeBase;
+    replayed = 0;
+    // A UDP client's handshake is recorded with the Connect that let it in straight after it, so each tick's
+    // handshakes wait here until the Connect (if there is one) can be put with them
+    std::vector<PendingHandshake> handshakes;
+    bool lastWasHandshake = false;
+
+    CaptureRecordHeader header;
+    const uint8_t *payload;
+    bool more = reader.Next(header, payload);
+    if (more)
+    {
+        firstTimestamp = header.timestamp;
+    }
+    while (true)
+    {
+        if (!more || header.tick != currentTick)
         {
-            PlayerRecord &newRecord = msg.data.actuallyUpdateData.playerData;
-            if (playerRecordHistory[newRecord.id].UpdatedThisFrame)
+            if (currentTick != UINT64_MAX)
             {
-                if (playerRecordHistory[newRecord.id].timestamp > msg.unixTimestamp) // Stored record is newer than the one in the message
+                for (PendingHandshake &handshake : handshakes)
                 {
-                    break;
+                    udpHandshakeChannel.Write(handshake);
                 }
-                // Else the one we're looking at is newer so let's store it
+                handshakes.clear();
+                lastWasHandshake = false;
+                Tick(tickTime);
             }
-            oldPlayerRecords[newRecord.id] = playerRecords[newRecord.id]; // Save the old record
-            playerRecords[newRecord.id] = newRecord; // Store the new record
-            playerRecordHistory[newRecord.id].UpdatedThisFrame = true;
-            playerRecordHistory[newRecord.id].timestamp = msg.unixTimestamp;
-            
-            Vector3 playerPos = newRecord.transform.GetPosition();
-            std::cout << "PlayerID: " << static_cast<char>(newRecord.id+48) << " Pos(" << playerPos.x << ", " << playerPos.y << ", " << playerPos.z << ")" << std::endl;
-
-
-            // Inform all the other connected clients of this new data
-            UDPMessage newMsg = msg;
-            msg.unixTimestamp = static_cast<uint64_t>(std::time(nullptr)); // Update the timestamp
-            msg.data.playerUpdateData.sender = UDPMessageSender::Server;
-
+            if (!more || replayFailed)
+            {
+                break;
+            }
+            currentTick = header.tick;
+            tickTime = timeBase + (header.timestamp - firstTimestamp);
+        }
 
-            for (int id = 0; id < 16; id++)
+        // Next only checks the record fits in the file, whether it holds what its kind says is checked here
+        bool corrupt = false;
+        const bool afterHandshake = lastWasHandshake;
+        lastWasHandshake = header.kind == CaptureRecordKind::Handshake;
+        switch (header.kind)
+        {
+        case CaptureRecordKind::UDP:
+        {
+            // Offline there is no io thread, so this stands in for it on the producer side of the pool
+            uint16_t slab;
+            if (udpReceivePool.Acquire(0, slab))
             {
-                if (activePlayers[id] && id != newRecord.id)
+                UDPMessage &msg = udpReceivePool.Get(slab);
+                if (!WireDecode(payload, header.size, msg)) // Same checks as a live datagram gets in OnDatagram
                 {
-                    udpSend(newMsg, udpConnections[id]);
+                    udpReceivePool.Release(slab);
+                    corrupt = true;
+                    break;
                 }
+                if (msg.type == UDPMessageType::Reliable || msg.type == UDPMessageType::Ack || msg.type == UDPMessageType::Pong)
+                {
+                    // Captures don't keep senders, take it as coming from whoever the id belonged to
+                    const uint8_t id = msg.type == UDPMessageType::Reliable ? msg.data.reliableData.id
+                        : msg.type == UDPMessageType::Ack ? msg.data.ackData.id : msg.data.pingPongData.id;
+                    udpReceivePool.GetSender(slab) = id < 16 ? udpConnections[id] : udp::endpoint();
+                }
+                udpReceivePool.Publish(slab);
+            }
+            else
+            {
+                udpPacketsDropped.fetch_add(1, std::memory_order_relaxed);
             }
-
             break;
         }
-        case UDPMessageType::StillHere:
+        case CaptureRecordKind::TCP:
         {
+            TCPMessage msg;
+            if (!WireDecode(payload, header.size, msg))
+            {
+                corrupt = true;
+                break;
+            }
+            tcpMessageChannel.Write(MakeQueuedTCPMessage(msg));
+            break;
+        }
+        case CaptureRecordKind::Connect:
+        {
+            if (header.size != 0)
+            {
+                corrupt = true;
+                break;
+            }
+            if (afterHandshake)
+            {
+                handshakes.back().replayId = static_cast<uint8_t>(header.id); // The handshake let them in, and connects them once
+            }
+            else
+            {
+                streamAcceptChannel.Write({ SharedPtr<StreamConnection>(nullptr), static_cast<uint8_t>(header.id) }); // AcceptStream reserves the id
+            }
+            break;
+        }
+        case CaptureRecordKind::Handshake:
+        {
+            CaptureHandshake handshake;
+            if (header.size != sizeof(CaptureHandshake)
+                || !WireDecode(payload + offsetof(CaptureHandshake, msg), sizeof(UDPMessage), handshake.msg))
+            {
+                corrupt = true;
+                break;
+            }
+            memcpy(&handshake.endpoint, payload, sizeof(CaptureEndpoint));
+            if (handshake.endpoint.isV6 > 1)
+            {
+                corrupt = true;
+                break;
+            }
+            handshakes.push_back({ handshake.msg, FromCaptureEndpoint(handshake.endpoint), true, UDPUnassignedId });
             break;
         }
         default:
-            std::cout << "Unrecognised UDP Message Type!" << std::endl;
+            corrupt = true; // Not a kind this build writes
+            break;
+        }
+        if (corrupt)
+        {
+            std::cout << "Error: capture record " << replayed << " is corrupt (kind " << static_cast<uint32_t>(header.kind)
+                << ", " << header.size << " bytes), stopping the replay" << std::endl;
+            replayFailed = true;
             break;
         }
+        replayed++;
+        more = reader.Next(header, payload);
     }
-
-    return true;
+    return !replayFailed;
 }
@@ -0,0 +1,189 @@
+#include "ShmClient.hpp"
+#ifdef __linux__
+#include <ctime>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+ShmClient::ShmClient()
+    : socketFd(-1)
+    , toServerEvent(-1)
+    , toClientEvent(-1)
+    , segment(nullptr)
+    , slot(0)
+    , id(UDPUnassignedId)
+    , wakeups(0)
+{
+}
+
+ShmClient::~ShmClient()
+{
+    Detach();
+}
+
+bool ShmClient::Attach(const std::string & socketPath)
+{
+    Detach();
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+    socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socketFd < 0 || connect(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        Detach();
+        return false;
+    }
+
+    // The segment and both eventfds come with the attach info, or the server turned us away
+    ShmAttachInfo info;
+    iovec iov = { &info, sizeof(info) };
+    int fds[3] = { -1, -1, -1 };
+    union
+    {
+        cmsghdr header;
+        uint8_t buffer[CMSG_SPACE(sizeof(fds))];
+    } control;
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+    const ssize_t received = recvmsg(socketFd, &msg, MSG_CMSG_CLOEXEC);
+    const cmsghdr *fdHeader = received == static_cast<ssize_t>(sizeof(info)) ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (fdHeader == nullptr || fdHeader->cmsg_type != SCM_RIGHTS || fdHeader->cmsg_len != CMSG_LEN(sizeof(fds)))
+    {
+        Detach();
+        return false;
+    }
+    memcpy(fds, CMSG_DATA(fdHeader), sizeof(fds));
+    toServerEvent = fds[1];
+    toClientEvent = fds[2];
+    void *memory = MAP_FAILED;
+    if (info.version == ShmAttachInfo::CurrentVersion && info.segmentSize == sizeof(ShmSegment))
+    {
+        memory = mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    }
+    close(fds[0]);
+    if (memory == MAP_FAILED)
+    {
+        Detach();
+        return false;
+    }
+    segment = static_cast<ShmSegment*>(memory);
+    slot = info.slot;
+    return true;
+}
+
+void ShmClient::Detach()
+{
+    if (segment != nullptr)
+    {
+        munmap(segment, sizeof(ShmSegment));
+        segment = nullptr;
+    }
+    for (int *fd : { &socketFd, &toServerEvent, &toClientEvent })
+    {
+        if (*fd >= 0)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    id = UDPUnassignedId;
+}
+
+bool ShmClient::SendControl(TCPMessage & msg)
+{
+    uint8_t bytes[WireSize<TCPMessage>::value];
+    const size_t size = WireEncode(msg, bytes, sizeof(bytes));
+    return Write(ShmFrameKind::Control, bytes, size);
+}
+
+bool ShmClient::SendDatagram(const UDPMessage & msg)
+{
+    uint8_t bytes[WireSize<UDPMessage>::value];
+    const size_t size = WireEncode(msg, bytes, sizeof(bytes));
+    return Write(ShmFrameKind::Datagram, bytes, size);
+}
+
+bool ShmClient::Write(ShmFrameKind kind, const uint8_t * bytes, size_t size)
+{
+    if (segment == nullptr)
+    {
+        return false;
+    }
+    bool wake = false;
+    if (!segment->toServer.Write(kind, bytes, size, wake))
+    {
+        return false;
+    }
+    if (wake)
+    {
+        const uint64_t one = 1;
+        ssize_t written = write(toServerEvent, &one, sizeof(one));
+        (void)written;
+        wakeups++;
+    }
+    return true;
+}
+
+bool ShmClient::Wait(int timeoutMs)
+{
+    ShmRing &ring = segment->toClient;
+    if (!ring.Empty())
+    {
+        return true;
+    }
+    if (timeoutMs == 0 || !ring.PrepareToWait())
+    {
+        return !ring.Empty();
+    }
+    pollfd fds[2] =
+    {
+        { toClientEvent, POLLIN, 0 },
+        { socketFd, POLLIN | POLLRDHUP, 0 }
+    };
+    poll(fds, 2, timeoutMs);
+    ring.DoneWaiting();
+    if ((fds[0].revents & POLLIN) != 0)
+    {
+        uint64_t value;
+        ssize_t bytesRead = read(toClientEvent, &value, sizeof(value));
+        (void)bytesRead;
+    }
+    if (fds[1].revents != 0 && ring.Empty())
+    {
+        Detach(); // The server closed our connection, or went away
+        return false;
+    }
+    return !ring.Empty();
+}
+
+void ShmClient::OnConnected(uint8_t InId)
+{
+    id = InId;
+    // Same as a socket client saying where to send its datagrams, the address is the one the server knows this
+    // client's datagrams by
+    char host[16] = "0.0.0.0";
+    char service[5] = {};
+    const std::string port = std::to_string(slot + 1);
+    memcpy(service, port.data(), port.size());
+    TCPMessageData data;
+    data.ipv4ConnectData = TCPMessageIWantToConnectIPv4Data(id, host, service);
+    TCPMessage request =
+    {
+        TCPMessageType::IWantToConnectIPv4,
+        static_cast<uint64_t>(std::time(nullptr)),
+        data
+    };
+    SendControl(request);
+}
+#endif
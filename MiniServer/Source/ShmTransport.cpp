@@ -0,0 +1,486 @@
+#include "ShmTransport.hpp"
+#ifdef __linux__
+#include <iostream>
+#include <ctime>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "Clock.hpp"
+
+// Stream connection for a shared memory client, its control messages go straight into its ring
+class ShmConnection : public StreamConnection
+{
+public:
+    ShmConnection(ShmTransport &InTransport, uint16_t InSlot, uint32_t InGeneration)
+        : transport(&InTransport)
+        , slot(InSlot)
+        , generation(InGeneration)
+        , overflowed(false)
+    {}
+
+    void StartReceive() override {} // The transport's thread reads everything the client sends
+
+    SendResult Send(TCPMessage &msg) override
+    {
+        uint8_t bytes[WireSize<TCPMessage>::value];
+        const size_t size = WireEncode(msg, bytes, sizeof(bytes));
+        if (msg.type == TCPMessageType::YouAreConnected)
+        {
+            transport->SetClientId(slot, generation, msg.data.youAreConnectedData.id);
+        }
+        if (!transport->WriteToClient(slot, generation, ShmFrameKind::Control, bytes, size))
+        {
+            if (msg.type == TCPMessageType::Snapshot)
+            {
+                return SendResult::Dropped;
+            }
+            overflowed.store(true, std::memory_order_relaxed);
+            return SendResult::Overflow;
+        }
+        return SendResult::Queued;
+    }
+
+    void Close() override
+    {
+        transport->Kick(slot, generation);
+    }
+
+    // No queue of our own to be backed up, a client that has let its ring fill is as far behind as it can get
+    bool IsSlowConsumer(uint64_t now, uint64_t timeoutUs) override { return overflowed.load(std::memory_order_relaxed); }
+
+private:
+    ShmTransport *transport;
+    uint16_t slot;
+    uint32_t generation;
+    std::atomic<bool> overflowed;
+};
+
+// What each epoll event is for, packed into its data with the slot it belongs to
+enum class ShmEventSource : uint32_t
+{
+    Listen,
+    Stop,
+    ClientSocket,
+    ClientEvent
+};
+
+static uint64_t EpollTag(ShmEventSource source, uint16_t slot)
+{
+    return (static_cast<uint64_t>(source) << 32) | slot;
+}
+
+static bool EpollAdd(int epollFd, int fd, uint32_t events, uint64_t tag)
+{
+    epoll_event event;
+    event.events = events;
+    event.data.u64 = tag;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+static void Signal(int eventFd)
+{
+    const uint64_t one = 1;
+    ssize_t written = write(eventFd, &one, sizeof(one));
+    (void)written; // Only fails if the counter is about to overflow, in which case the reader has plenty to wake for
+}
+
+ShmTransport::ShmTransport(const std::string & InSocketPath, uint16_t InReceiveShard)
+    : socketPath(InSocketPath)
+    , receiveShard(InReceiveShard)
+    , handler(nullptr)
+    , receivePool(nullptr)
+    , tcpMessageChannel(nullptr)
+    , listenFd(-1)
+    , epollFd(-1)
+    , stopEvent(-1)
+    , heldSlab(UDPReceivePool::NoSlab)
+    , wakeups(0)
+{
+}
+
+ShmTransport::~ShmTransport()
+{
+    Stop();
+}
+
+bool ShmTransport::Start(TransportHandler & InHandler, UDPReceivePool & InReceivePool, UDPSendBufferPool & sendPool, Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > & InTcpMessageChannel)
+{
+    handler = &InHandler;
+    receivePool = &InReceivePool;
+    tcpMessageChannel = &InTcpMessageChannel;
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        std::cout << "Warning: shared memory socket path too long, local clients will have to use sockets" << std::endl;
+        return false;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+    unlink(socketPath.c_str()); // Left behind by a server that didn't get to clean up
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    stopEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (listenFd < 0 || epollFd < 0 || stopEvent < 0
+        || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listenFd, MaxClients) != 0
+        || !EpollAdd(epollFd, listenFd, EPOLLIN, EpollTag(ShmEventSource::Listen, 0))
+        || !EpollAdd(epollFd, stopEvent, EPOLLIN, EpollTag(ShmEventSource::Stop, 0)))
+    {
+        std::cout << "Warning: couldn't listen for shared memory clients on " << socketPath << ", local clients will have to use sockets" << std::endl;
+        Stop();
+        return false;
+    }
+    receiveThread = MakeUnique<std::thread>(&ShmTransport::ReceiveThreadFunc, this);
+    return true;
+}
+
+void ShmTransport::Stop()
+{
+    if (receiveThread.IsValid())
+    {
+        Signal(stopEvent);
+        receiveThread->join();
+        receiveThread = nullptr;
+    }
+    for (uint16_t slot = 0; slot < MaxClients; slot++)
+    {
+        if (slots[slot].attached)
+        {
+            slots[slot].kicked = true; // No one left to tell
+            DetachClient(slot);
+        }
+    }
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+        unlink(socketPath.c_str());
+        listenFd = -1;
+    }
+    if (epollFd >= 0)
+    {
+        close(epollFd);
+        epollFd = -1;
+    }
+    if (stopEvent >= 0)
+    {
+        close(stopEvent);
+        stopEvent = -1;
+    }
+}
+
+bool ShmTransport::Owns(const udp::endpoint & to) const
+{
+    return to.address().is_v4() && to.address().to_v4() == boost::asio::ip::address_v4::any() && to.port() >= 1 && to.port() <= MaxClients;
+}
+
+void ShmTransport::Send(UDPSendBuffer * buffer, const udp::endpoint & to)
+{
+    MINISERVER_TRACE_SPAN("Shm send");
+    Slot &client = slots[to.port() - 1];
+    {
+        std::unique_lock<std::mutex> lock(client.sendMutex);
+        if (client.attached)
+        {
+            WriteLocked(client, ShmFrameKind::Datagram, buffer->data.data(), buffer->size); // Dropped if it's full, as it would be by a socket
+        }
+    }
+    UDPSendBufferPool::Release(buffer);
+}
+
+bool ShmTransport::WriteToClient(uint16_t slot, uint32_t generation, ShmFrameKind kind, const uint8_t * bytes, size_t size)
+{
+    Slot &client = slots[slot];
+    std::unique_lock<std::mutex> lock(client.sendMutex);
+    if (!client.attached || client.generation != generation)
+    {
+        return false;
+    }
+    return WriteLocked(client, kind, bytes, size);
+}
+
+bool ShmTransport::WriteLocked(Slot & client, ShmFrameKind kind, const uint8_t * bytes, size_t size)
+{
+    bool wake = false;
+    if (!client.segment->toClient.Write(kind, bytes, size, wake))
+    {
+        return false;
+    }
+    if (wake)
+    {
+        Signal(client.toClientEvent);
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void ShmTransport::Kick(uint16_t slot, uint32_t generation)
+{
+    Slot &client = slots[slot];
+    std::unique_lock<std::mutex> lock(client.sendMutex);
+    if (client.attached && client.generation == generation)
+    {
+        client.kicked = true;
+        shutdown(client.socketFd, SHUT_RDWR); // The client sees it closed, and so does the receive thread, which frees the slot
+    }
+}
+
+void ShmTransport::SetClientId(uint16_t slot, uint32_t generation, uint8_t id)
+{
+    Slot &client = slots[slot];
+    std::unique_lock<std::mutex> lock(client.sendMutex);
+    if (client.generation == generation)
+    {
+        client.clientId = id;
+    }
+}
+
+void ShmTransport::ReceiveThreadFunc()
+{
+    Trace::SetThreadName("Shm receive");
+    epoll_event events[MaxClients * 2 + 2];
+    while (true)
+    {
+        bool starved = false;
+        for (uint16_t slot = 0; slot < MaxClients; slot++)
+        {
+            if (slots[slot].attached && !ReadClient(slot))
+            {
+                starved = true;
+            }
+        }
+
+        // Only sleep if every ring is still empty once its client knows to wake us. Out of slabs there's nothing to
+        // wake for, the tick gives them back without saying, so check again shortly
+        bool idle = !starved;
+        for (uint16_t slot = 0; slot < MaxClients && idle; slot++)
+        {
+            if (slots[slot].attached && !slots[slot].segment->toServer.PrepareToWait())
+            {
+                idle = false;
+            }
+        }
+        const int count = epoll_wait(epollFd, events, sizeof(events) / sizeof(events[0]), idle ? -1 : (starved ? 1 : 0));
+        for (uint16_t slot = 0; slot < MaxClients; slot++)
+        {
+            if (slots[slot].attached)
+            {
+                slots[slot].segment->toServer.DoneWaiting();
+            }
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            const ShmEventSource source = static_cast<ShmEventSource>(events[i].data.u64 >> 32);
+            const uint16_t slot = static_cast<uint16_t>(events[i].data.u64);
+            switch (source)
+            {
+            case ShmEventSource::Stop:
+                return;
+            case ShmEventSource::Listen:
+                AcceptClient();
+                break;
+            case ShmEventSource::ClientSocket:
+                if (slots[slot].attached)
+                {
+                    ReadClient(slot); // Whatever it sent on its way out
+                    if (slots[slot].attached) // Unless that was bad enough to detach it already
+                    {
+                        DetachClient(slot); // Clients never write to the socket, so anything on it means it closed
+                    }
+                }
+                break;
+            case ShmEventSource::ClientEvent:
+                if (slots[slot].attached)
+                {
+                    uint64_t value;
+                    ssize_t bytesRead = read(slots[slot].toServerEvent, &value, sizeof(value)); // Just clears it, the rings are read above
+                    (void)bytesRead;
+                }
+                break;
+            }
+        }
+    }
+}
+
+void ShmTransport::AcceptClient()
+{
+    const int socketFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (socketFd < 0)
+    {
+        return;
+    }
+    uint16_t slot = 0;
+    while (slot < MaxClients && slots[slot].attached)
+    {
+        slot++;
+    }
+    if (slot == MaxClients)
+    {
+        std::cout << "Shared memory clients full, turning away connection" << std::endl;
+        close(socketFd);
+        return;
+    }
+
+    // The segment only needs mapping here, the client gets its own mapping from the fd
+    const int memFd = memfd_create("MiniServer client", MFD_CLOEXEC);
+    void *memory = MAP_FAILED;
+    if (memFd >= 0 && ftruncate(memFd, sizeof(ShmSegment)) == 0)
+    {
+        memory = mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    }
+    const int toServerEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    const int toClientEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    bool sent = false;
+    if (memory != MAP_FAILED && toServerEvent >= 0 && toClientEvent >= 0)
+    {
+        ShmAttachInfo info;
+        info.version = ShmAttachInfo::CurrentVersion;
+        info.segmentSize = sizeof(ShmSegment);
+        info.slot = slot;
+        iovec iov = { &info, sizeof(info) };
+        const int fds[3] = { memFd, toServerEvent, toClientEvent };
+        union
+        {
+            cmsghdr header;
+            uint8_t buffer[CMSG_SPACE(sizeof(fds))];
+        } control;
+        memset(&control, 0, sizeof(control));
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+        cmsghdr *fdHeader = CMSG_FIRSTHDR(&msg);
+        fdHeader->cmsg_level = SOL_SOCKET;
+        fdHeader->cmsg_type = SCM_RIGHTS;
+        fdHeader->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(fdHeader), fds, sizeof(fds));
+        sent = sendmsg(socketFd, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(info));
+    }
+    if (memFd >= 0)
+    {
+        close(memFd); // Mapped (or failed), either way the fd isn't needed any more
+    }
+    if (!sent)
+    {
+        std::cout << "Error: couldn't set up a shared memory client" << std::endl;
+        if (memory != MAP_FAILED) munmap(memory, sizeof(ShmSegment));
+        if (toServerEvent >= 0) close(toServerEvent);
+        if (toClientEvent >= 0) close(toClientEvent);
+        close(socketFd);
+        return;
+    }
+
+    Slot &client = slots[slot];
+    uint32_t generation;
+    {
+        std::unique_lock<std::mutex> lock(client.sendMutex);
+        client.attached = true;
+        client.kicked = false;
+        client.clientId = UDPUnassignedId;
+        client.socketFd = socketFd;
+        client.toServerEvent = toServerEvent;
+        client.toClientEvent = toClientEvent;
+        client.segment = static_cast<ShmSegment*>(memory);
+        generation = client.generation;
+    }
+    EpollAdd(epollFd, socketFd, EPOLLIN | EPOLLRDHUP, EpollTag(ShmEventSource::ClientSocket, slot));
+    EpollAdd(epollFd, toServerEvent, EPOLLIN, EpollTag(ShmEventSource::ClientEvent, slot));
+    handler->OnStreamAccepted(SharedPtr<StreamConnection>(MakeShareable(new ShmConnection(*this, slot, generation))));
+}
+
+void ShmTransport::DetachClient(uint16_t slot)
+{
+    Slot &client = slots[slot];
+    bool tellServer;
+    uint8_t id;
+    {
+        std::unique_lock<std::mutex> lock(client.sendMutex);
+        tellServer = !client.kicked && client.clientId != UDPUnassignedId;
+        id = client.clientId;
+        client.attached = false;
+        client.generation++;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, client.socketFd, nullptr);
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, client.toServerEvent, nullptr);
+        close(client.socketFd);
+        close(client.toServerEvent);
+        close(client.toClientEvent);
+        munmap(client.segment, sizeof(ShmSegment));
+        client.socketFd = client.toServerEvent = client.toClientEvent = -1;
+        client.segment = nullptr;
+    }
+    if (tellServer)
+    {
+        // Left without saying so, which is what a dropped TCP connection would leave to the idle timeout. Here we
+        // know for sure, so say it for them
+        QueuedTCPMessage msg;
+        msg.unixTimestamp = static_cast<uint64_t>(std::time(nullptr));
+        msg.type = TCPMessageType::IAmDisconnecting;
+        msg.data.iAmDisconnectingData = { id };
+        tcpMessageChannel->Write(msg);
+    }
+}
+
+bool ShmTransport::ReadClient(uint16_t slot)
+{
+    bool starved = false;
+    bool corrupt;
+    slots[slot].segment->toServer.ReadAll([this, slot, &starved](ShmFrameKind kind, const uint8_t *bytes, size_t size)
+    {
+        if (kind == ShmFrameKind::Control)
+        {
+            TCPMessage msg;
+            if (!WireDecode(bytes, size, msg))
+            {
+                std::cout << "Error: malformed control message from a shared memory client" << std::endl;
+                return true;
+            }
+            if (msg.type == TCPMessageType::Pong)
+            {
+                msg.data.pingPongData.destinationTimestamp = MonotonicMicroseconds(); // As TCPConnection, so time in the channel isn't rtt
+            }
+            QueuedTCPMessage queued = MakeQueuedTCPMessage(msg);
+            {
+                std::unique_lock<std::mutex> lock(slots[slot].sendMutex); // The tick sets clientId
+                StampSender(queued, slots[slot].clientId);
+            }
+            tcpMessageChannel->Write(queued);
+            return true;
+        }
+
+        if (size > sizeof(UDPMessage))
+        {
+            handler->OnDatagramDropped(); // Bigger than any message, so it can't be one
+            return true;
+        }
+        if (heldSlab == UDPReceivePool::NoSlab && !receivePool->Acquire(receiveShard, heldSlab))
+        {
+            // Unlike a socket there's no need to drop it, it can wait in the ring until the tick frees some slabs,
+            // and if the ring fills the client waits too
+            heldSlab = UDPReceivePool::NoSlab;
+            starved = true;
+            return false;
+        }
+        memcpy(&receivePool->Get(heldSlab), bytes, size);
+        if (handler->OnDatagram(heldSlab, size, SlotEndpoint(slot)))
+        {
+            heldSlab = UDPReceivePool::NoSlab;
+        }
+        return true;
+    }, corrupt);
+    if (corrupt)
+    {
+        std::cout << "Error: shared memory client " << slot << " wrote a bad frame or cursor, dropping it" << std::endl;
+        DetachClient(slot);
+    }
+    return !starved;
+}
+#endif
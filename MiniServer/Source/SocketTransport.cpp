@@ -0,0 +1,283 @@
+#include "SocketTransport.hpp"
+#include "ThreadAffinity.hpp"
+#include <iostream>
+#ifdef __linux__
+#include <sys/socket.h>
+#include <linux/filter.h>
+#endif
+
+SocketTransport::SocketTransport(boost::asio::io_service & io_service, const ServerConfig & InConfig)
+    : config(InConfig)
+    , ioService(&io_service)
+    , handler(nullptr)
+    , receivePool(nullptr)
+    , tcpMessageChannel(nullptr)
+    , acceptor(io_service)
+{
+}
+
+SocketTransport::~SocketTransport()
+{
+    Stop();
+}
+
+bool SocketTransport::Start(TransportHandler & InHandler, UDPReceivePool & InReceivePool, UDPSendBufferPool & sendPool, Channel<QueuedTCPMessage, std::queue<QueuedTCPMessage> > & InTcpMessageChannel)
+{
+    handler = &InHandler;
+    receivePool = &InReceivePool;
+    tcpMessageChannel = &InTcpMessageChannel;
+
+    if (config.tcpEnabled)
+    {
+        tcp::endpoint tcpEndpoint(tcp::v4(), config.tcpPort);
+        acceptor.open(tcpEndpoint.protocol());
+        acceptor.set_option(tcp::acceptor::reuse_address(true));
+        acceptor.bind(tcpEndpoint);
+        acceptor.listen();
+        StartAccepting();
+    }
+
+#ifdef MINISERVER_IO_URING
+    if (config.udpIoUring)
+    {
+        udpUring = MakeUnique<UDPUringBackend>();
+        if (!udpUring->Open(config.udpPort, *receivePool, sendPool))
+        {
+            std::cout << "Warning: couldn't set up io_uring, falling back to asio for UDP" << std::endl;
+            udpUring = nullptr;
+        }
+    }
+    if (!udpUring.IsValid())
+    {
+        udpInit();
+    }
+#else
+    if (config.udpIoUring)
+    {
+        std::cout << "Warning: built without io_uring, using asio for UDP" << std::endl;
+    }
+    udpInit();
+#endif
+    return true;
+}
+
+void SocketTransport::Stop()
+{
+    for (size_t i = 0; i < udpShardThreads.size(); i++)
+    {
+        udpShardServices[i]->stop();
+        udpShardThreads[i]->join();
+    }
+    udpShardThreads.clear();
+}
+
+void SocketTransport::Poll()
+{
+#ifdef MINISERVER_IO_URING
+    if (udpUring.IsValid())
+    {
+        // Stands in for the io thread, datagrams go through the same checks and into the same ring
+        udpUring->Poll([this](uint16_t slab, std::size_t bytes, const udp::endpoint &from) { return handler->OnDatagram(slab, bytes, from); });
+    }
+#endif
+}
+
+void SocketTransport::Flush()
+{
+#ifdef MINISERVER_IO_URING
+    if (udpUring.IsValid())
+    {
+        udpUring->Submit(); // The one syscall this tick makes for UDP, if it needs any
+    }
+#endif
+}
+
+uint64_t SocketTransport::GetSyscallCount() const
+{
+#ifdef MINISERVER_IO_URING
+    return udpUring.IsValid() ? udpUring->GetSyscallCount() : 0;
+#else
+    return 0;
+#endif
+}
+
+void SocketTransport::StartAccepting()
+{
+    AllocationScope allocationScope(AllocationTag::Accept);
+    SharedPtr<TCPConnection> newConnection = TCPConnection::Create(*ioService, tcpMessageChannel, config.tcpSendQueueBytes);
+    acceptor.async_accept(
+        newConnection->GetSocket(),
+        boost::bind(&SocketTransport::tcpHandleAccept, this, newConnection, boost::asio::placeholders::error)
+    );
+}
+
+void SocketTransport::tcpHandleAccept(SharedPtr<TCPConnection> newConnection, const boost::system::error_code & error)
+{
+    if (!error)
+    {
+        handler->OnStreamAccepted(newConnection);
+    }
+    else
+    {
+        std::cout << "Error: " << error.message() << std::endl;
+#ifdef _DEBUG
+        abort();
+#endif
+    }
+
+    StartAccepting(); // Wait for a new connection
+}
+
+#ifdef __linux__
+// Classic BPF run by the kernel for each datagram arriving on the port, its result is the index of the socket
+// (in bind order) to deliver it to. Every client message has the sender's id at the same offset (just after
+// type, sequence and timestamp), so each client maps to a fixed shard, id % shards. Anything too short to have an
+// id fails the load, and the kernel falls back to hashing it to a shard
+static bool AttachShardSteering(udp::socket &socket, uint16_t shardCount)
+{
+    static const uint32_t IdOffset = 1 + 2 + 8;
+    static_assert(offsetof(UDPMessage, data) == IdOffset, "Sender id isn't where the steering program looks for it");
+    sock_filter code[] =
+    {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, IdOffset), // A = id
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, shardCount), // A %= shards
+        BPF_STMT(BPF_RET | BPF_A, 0)
+    };
+    sock_fprog program = { static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code };
+    return setsockopt(socket.native_handle(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == 0;
+}
+#endif
+
+void SocketTransport::udpInit()
+{
+    uint16_t shardCount = config.udpShards; // The pool can have more, for other transports
+#ifndef __linux__
+    if (shardCount > 1)
+    {
+        std::cout << "Warning: UDP shards need SO_REUSEPORT, using one socket" << std::endl;
+    }
+    shardCount = 1; // The pool still has the extra shards, they just never get used
+#endif
+
+    const udp::endpoint endpoint(udp::v4(), config.udpPort);
+    for (uint16_t shard = 0; shard < shardCount; shard++)
+    {
+        if (shard > 0)
+        {
+            udpShardServices.push_back(std::unique_ptr<boost::asio::io_service>(new boost::asio::io_service()));
+        }
+        udpShards.push_back(std::unique_ptr<UDPShard>(new UDPShard(shard == 0 ? *ioService : *udpShardServices.back())));
+        udp::socket &socket = udpShards.back()->socket;
+        socket.open(endpoint.protocol());
+#ifdef __linux__
+        if (shardCount > 1)
+        {
+            const int enable = 1;
+            setsockopt(socket.native_handle(), SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+        }
+#endif
+        socket.bind(endpoint);
+    }
+#ifdef __linux__
+    if (shardCount > 1 && !AttachShardSteering(udpShards[0]->socket, shardCount))
+    {
+        std::cout << "Warning: couldn't attach the UDP steering program, clients will be spread over shards by address" << std::endl;
+    }
+#endif
+
+    for (uint16_t shard = 0; shard < shardCount; shard++)
+    {
+        udpReceive(shard);
+    }
+    for (uint16_t shard = 1; shard < shardCount; shard++)
+    {
+        udpShardThreads.push_back(MakeUnique<std::thread>([this, shard]()
+        {
+            PinThreadToCore(shard % std::thread::hardware_concurrency());
+            Trace::SetThreadName("UDP shard");
+            udpShardServices[shard - 1]->run();
+        }));
+    }
+}
+
+void SocketTransport::Send(UDPSendBuffer * buffer, const udp::endpoint & to)
+{
+    AllocationScope allocationScope(AllocationTag::UdpSocket);
+#ifdef MINISERVER_IO_URING
+    if (udpUring.IsValid())
+    {
+        udpUring->Send(buffer, to); // Goes in with the rest of the tick's sends, see Flush
+        return;
+    }
+#endif
+    udpShards[0]->socket.async_send_to(
+        boost::asio::buffer(buffer->data.data(), buffer->size),
+        to,
+        MakeAllocatingHandler(buffer->sendHandler, boost::bind(&SocketTransport::udpHandleSend, this, buffer, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred))
+    );
+}
+
+void SocketTransport::udpReceive(uint16_t shard)
+{
+    uint16_t slab;
+    if (!receivePool->Acquire(shard, slab))
+    {
+        slab = UDPReceivePool::NoSlab; // The tick is holding every slab, this one gets dropped
+    }
+    udpReceiveInto(shard, slab);
+}
+
+void SocketTransport::udpReceiveInto(uint16_t shard, uint16_t slab)
+{
+    AllocationScope allocationScope(AllocationTag::UdpSocket);
+    UDPShard &receiver = *udpShards[shard];
+    boost::asio::mutable_buffers_1 buffer = slab == UDPReceivePool::NoSlab
+        ? boost::asio::buffer(receiver.dropBuffer)
+        : boost::asio::buffer(&receivePool->Get(slab), sizeof(UDPMessage));
+    receiver.socket.async_receive_from(
+        buffer,
+        receiver.remoteEndpoint,
+        MakeAllocatingHandler(receiver.receiveHandler, boost::bind(&SocketTransport::udpHandleReceive, this, shard, slab, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred))
+    );
+}
+
+void SocketTransport::udpHandleReceive(uint16_t shard, uint16_t slab, const boost::system::error_code & error, std::size_t bytesTransferred)
+{
+    if (error)
+    {
+        std::cout << "Error: " << error.message() << std::endl;
+#ifdef _DEBUG
+        abort();
+#endif
+        udpReceiveInto(shard, slab);
+        return;
+    }
+    if (slab == UDPReceivePool::NoSlab)
+    {
+        handler->OnDatagramDropped();
+        udpReceive(shard);
+        return;
+    }
+    if (!handler->OnDatagram(slab, bytesTransferred, udpShards[shard]->remoteEndpoint))
+    {
+        udpReceiveInto(shard, slab); // Rejected, or copied out, so it can be received over
+        return;
+    }
+    udpReceive(shard); // Back to the grind...
+}
+
+void SocketTransport::udpHandleSend(UDPSendBuffer * buffer, const boost::system::error_code & error, std::size_t bytesTransferred)
+{
+    MINISERVER_TRACE_SPAN("UDP send complete");
+    UDPSendBufferPool::Release(buffer);
+    if (!error)
+    {
+#ifdef _DEBUG
+        std::cout << "UDP batch sent, " << bytesTransferred << " bytes" << std::endl;
+#endif
+    }
+    else
+    {
+        std::cout << "Error: " << error.message() << std::endl;
+    }
+}
@@ -0,0 +1,310 @@
+#include "SpectatorRelay.hpp"
+#include "Clock.hpp"
+#include "AllocationTracker.hpp"
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <iostream>
+
+static const size_t MaxDelayedFrames = 4096; // Far more than any sensible delay needs at the snapshot rate
+static const long UpstreamRetryMs = 1000;
+
+SpectatorRelay::SpectatorRelay(boost::asio::io_service & io_service, const SpectatorRelayConfig & InConfig)
+    : config(InConfig)
+    , ioService(&io_service)
+    , acceptor(io_service)
+    , latest(nullptr)
+    , delayTimer(io_service)
+    , upstream(io_service)
+    , upstreamResolver(io_service)
+    , upstreamRetryTimer(io_service)
+    , framesReceived(0)
+    , framesSent(0)
+    , framesSuperseded(0)
+    , stopped(false)
+{
+}
+
+bool SpectatorRelay::Start()
+{
+    boost::system::error_code error;
+    tcp::endpoint endpoint(tcp::v4(), config.port);
+    acceptor.open(endpoint.protocol(), error);
+    if (!error)
+    {
+        acceptor.set_option(tcp::acceptor::reuse_address(true), error);
+    }
+    if (!error)
+    {
+        acceptor.bind(endpoint, error);
+    }
+    if (!error)
+    {
+        acceptor.listen(boost::asio::socket_base::max_connections, error);
+    }
+    if (error)
+    {
+        std::cout << "Error: spectators can't listen on " << config.port << ", " << error.message() << std::endl;
+        return false;
+    }
+    StartAccepting();
+    if (config.upstreamPort != 0)
+    {
+        ConnectUpstream();
+    }
+    return true;
+}
+
+void SpectatorRelay::Stop()
+{
+    stopped = true;
+    boost::system::error_code ignored;
+    acceptor.close(ignored);
+    upstream.close(ignored);
+    delayTimer.cancel(ignored);
+    upstreamRetryTimer.cancel(ignored);
+    for (auto &subscriber : subscribers)
+    {
+        subscriber->socket.close(ignored);
+    }
+}
+
+void SpectatorRelay::Publish(const TCPMessage & snapshot)
+{
+    AllocationScope allocationScope(AllocationTag::Spectators);
+    Frame bytes;
+    WireEncode(snapshot, bytes.c_array(), bytes.size());
+    ioService->post([this, bytes]() { Enqueue(bytes); });
+}
+
+void SpectatorRelay::StartAccepting()
+{
+    accepting.reset(new Subscriber(*ioService));
+    acceptor.async_accept(
+        accepting->socket,
+        boost::bind(&SpectatorRelay::HandleAccept, this, boost::asio::placeholders::error)
+    );
+}
+
+void SpectatorRelay::HandleAccept(const boost::system::error_code & error)
+{
+    AllocationScope allocationScope(AllocationTag::Spectators);
+    if (stopped)
+    {
+        return;
+    }
+    if (error)
+    {
+        std::cout << "Error: " << error.message() << std::endl;
+    }
+    else if (subscribers.size() >= config.maxSubscribers)
+    {
+        accepting->socket.close(); // Full, they can try a relay further down
+    }
+    else
+    {
+        boost::system::error_code ignored;
+        accepting->socket.set_option(tcp::no_delay(true), ignored);
+        subscribers.push_back(std::move(accepting));
+        Subscriber &subscriber = *subscribers.back();
+        if (latest.IsValid())
+        {
+            subscriber.pending = latest; // Something to look at straight away
+            StartWrite(subscriber);
+        }
+    }
+    StartAccepting();
+}
+
+void SpectatorRelay::Enqueue(const Frame & bytes)
+{
+    AllocationScope allocationScope(AllocationTag::Spectators);
+    if (stopped)
+    {
+        return;
+    }
+    framesReceived++;
+    SharedPtr<Frame> frame = MakeShareable(new Frame(bytes));
+    if (config.delayMs == 0)
+    {
+        Deliver(frame);
+        return;
+    }
+    if (delayed.size() == MaxDelayedFrames)
+    {
+        delayed.pop_front();
+    }
+    delayed.push_back(std::make_pair(MonotonicMicroseconds() + static_cast<uint64_t>(config.delayMs) * 1000, frame));
+    if (delayed.size() == 1)
+    {
+        delayTimer.expires_from_now(boost::posix_time::milliseconds(config.delayMs));
+        delayTimer.async_wait(boost::bind(&SpectatorRelay::ReleaseDelayed, this, boost::asio::placeholders::error));
+    }
+}
+
+void SpectatorRelay::ReleaseDelayed(const boost::system::error_code & error)
+{
+    if (error || stopped)
+    {
+        return;
+    }
+    const uint64_t now = MonotonicMicroseconds();
+    while (!delayed.empty() && delayed.front().first <= now)
+    {
+        Deliver(delayed.front().second);
+        delayed.pop_front();
+    }
+    if (!delayed.empty())
+    {
+        delayTimer.expires_from_now(boost::posix_time::microseconds(static_cast<int64_t>(delayed.front().first - now)));
+        delayTimer.async_wait(boost::bind(&SpectatorRelay::ReleaseDelayed, this, boost::asio::placeholders::error));
+    }
+}
+
+void SpectatorRelay::Deliver(const SharedPtr<Frame> & frame)
+{
+    latest = frame;
+    for (auto &subscriber : subscribers)
+    {
+        if (subscriber->closed)
+        {
+            continue;
+        }
+        if (subscriber->pending.IsValid())
+        {
+            framesSuperseded++;
+        }
+        subscriber->pending = frame;
+        if (!subscriber->sending.IsValid())
+        {
+            StartWrite(*subscriber);
+        }
+    }
+}
+
+void SpectatorRelay::StartWrite(Subscriber & subscriber)
+{
+    subscriber.sending = subscriber.pending;
+    subscriber.pending.Reset();
+    boost::asio::async_write(
+        subscriber.socket,
+        boost::asio::buffer(*subscriber.sending),
+        MakeAllocatingHandler(subscriber.writeHandler, boost::bind(&SpectatorRelay::HandleWrite, this, &subscriber, boost::asio::placeholders::error))
+    );
+}
+
+void SpectatorRelay::HandleWrite(Subscriber * subscriber, const boost::system::error_code & error)
+{
+    AllocationScope allocationScope(AllocationTag::Spectators);
+    subscriber->sending.Reset();
+    if (stopped)
+    {
+        return;
+    }
+    if (error)
+    {
+        // Gone, or not reading at all. Nothing else refers to it with no write in flight
+        boost::system::error_code ignored;
+        subscriber->socket.close(ignored);
+        subscriber->closed = true;
+        RemoveClosed();
+        return;
+    }
+    framesSent++;
+    if (subscriber->pending.IsValid())
+    {
+        StartWrite(*subscriber);
+    }
+}
+
+void SpectatorRelay::RemoveClosed()
+{
+    subscribers.erase(
+        std::remove_if(subscribers.begin(), subscribers.end(), [](const std::unique_ptr<Subscriber> &subscriber) { return subscriber->closed; }),
+        subscribers.end()
+    );
+}
+
+void SpectatorRelay::ConnectUpstream()
+{
+    tcp::resolver::query query(config.upstreamHost, std::to_string(config.upstreamPort));
+    upstreamResolver.async_resolve(
+        query,
+        [this](const boost::system::error_code &error, tcp::resolver::iterator endpoints)
+        {
+            if (stopped)
+            {
+                return;
+            }
+            if (error)
+            {
+                std::cout << "Error: can't resolve " << config.upstreamHost << ", " << error.message() << std::endl;
+                RetryUpstream();
+                return;
+            }
+            boost::asio::async_connect(upstream, endpoints, boost::bind(&SpectatorRelay::HandleUpstreamConnect, this, boost::asio::placeholders::error));
+        }
+    );
+}
+
+void SpectatorRelay::HandleUpstreamConnect(const boost::system::error_code & error)
+{
+    if (stopped)
+    {
+        return;
+    }
+    if (error)
+    {
+        std::cout << "Error: can't reach upstream " << config.upstreamHost << ":" << config.upstreamPort << ", " << error.message() << std::endl;
+        RetryUpstream();
+        return;
+    }
+    std::cout << "Relaying from " << config.upstreamHost << ":" << config.upstreamPort << std::endl;
+    HandleUpstreamRead(boost::system::error_code(), 0); // Nothing read yet, just starts the first read
+}
+
+void SpectatorRelay::HandleUpstreamRead(const boost::system::error_code & error, std::size_t bytesTransferred)
+{
+    AllocationScope allocationScope(AllocationTag::Spectators);
+    if (stopped)
+    {
+        return;
+    }
+    if (error)
+    {
+        std::cout << "Error: upstream " << error.message() << std::endl;
+        RetryUpstream();
+        return;
+    }
+    if (bytesTransferred != 0)
+    {
+        // Passed on as it came, only checked so a bad stream doesn't get fanned out to everyone
+        TCPMessage msg;
+        if (!WireDecode(upstreamBuffer.data(), bytesTransferred, msg) || msg.type != TCPMessageType::Snapshot)
+        {
+            std::cout << "Error: upstream sent something other than a snapshot, reconnecting" << std::endl;
+            RetryUpstream();
+            return;
+        }
+        Enqueue(upstreamBuffer);
+    }
+    // Frames are all the same size, read exactly one at a time
+    boost::asio::async_read(
+        upstream,
+        boost::asio::buffer(upstreamBuffer),
+        boost::bind(&SpectatorRelay::HandleUpstreamRead, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)
+    );
+}
+
+void SpectatorRelay::RetryUpstream()
+{
+    boost::system::error_code ignored;
+    upstream.close(ignored);
+    upstreamRetryTimer.expires_from_now(boost::posix_time::milliseconds(UpstreamRetryMs));
+    upstreamRetryTimer.async_wait([this](const boost::system::error_code &error)
+    {
+        if (!error && !stopped)
+        {
+            ConnectUpstream();
+        }
+    });
+}
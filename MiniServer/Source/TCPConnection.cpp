@@ -2,30 +2,111 @@
 
 void TCPConnection::StartReceive()
 {
-    socket.async_receive(
+    AllocationScope allocationScope(AllocationTag::TcpReceive);
+    // Messages are all the same size, so read exactly one at a time. A plain receive can hand back half a
+    // message, or one and a bit, depending on how the stream was split up on the way
+    boost::asio::async_read(
+        socket,
         boost::asio::buffer(tcpRecvBuffer),
-        boost::bind(&TCPConnection::tcpHandleReceive, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)
+        MakeAllocatingHandler(receiveHandler, boost::bind(&TCPConnection::tcpHandleReceive, SharedThis(this), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred))
     );    
 }
 
-void TCPConnection::Send(TCPMessage &msg)
+TCPConnection::SendResult TCPConnection::Send(TCPMessage &msg)
 {
-    memcpy(tcpSendBuffer.c_array(), reinterpret_cast<uint8_t*>(&msg), sizeof(TCPMessage));
-    socket.async_send(
-        boost::asio::buffer(tcpSendBuffer),
-        boost::bind(&TCPConnection::tcpHandleSend, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)
+    AllocationScope allocationScope(AllocationTag::TcpSend);
+    if (msg.type == TCPMessageType::YouAreConnected)
+    {
+        clientId.store(msg.data.youAreConnectedData.id, std::memory_order_relaxed); // Before the client can know it, let alone use it
+    }
+    std::unique_lock<std::mutex> lock(sendMutex);
+    const bool isSnapshot = msg.type == TCPMessageType::Snapshot;
+    if (isSnapshot && queuedSnapshot != NoSnapshot)
+    {
+        // The client hasn't had the last one yet, so just make sure it gets this one instead
+        WireEncode(msg, sendQueue[queuedSnapshot].c_array(), sizeof(MessageBuffer));
+        return SendResult::Superseded;
+    }
+    if (sendCount == sendQueue.size())
+    {
+        if (isSnapshot)
+        {
+            return SendResult::Dropped;
+        }
+        overflowed = true;
+        return SendResult::Overflow;
+    }
+
+    const size_t slot = (sendHead + sendCount) % sendQueue.size();
+    WireEncode(msg, sendQueue[slot].c_array(), sizeof(MessageBuffer));
+    sendCount++;
+    if (isSnapshot)
+    {
+        queuedSnapshot = slot;
+    }
+    if (backloggedSince == 0 && sendCount > sendQueue.size() / 2)
+    {
+        backloggedSince = MonotonicMicroseconds();
+    }
+    if (!sending)
+    {
+        StartSend();
+    }
+    return SendResult::Queued;
+}
+
+void TCPConnection::StartSend()
+{
+    if (queuedSnapshot == sendHead)
+    {
+        queuedSnapshot = NoSnapshot; // Too late to replace it once it's being written
+    }
+    sending = true;
+    // async_write rather than async_send, a send can go out partially and the rest would be lost
+    boost::asio::async_write(
+        socket,
+        boost::asio::buffer(sendQueue[sendHead]),
+        MakeAllocatingHandler(sendHandler, boost::bind(&TCPConnection::tcpHandleSend, SharedThis(this), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred))
     );
 }
 
+bool TCPConnection::IsSlowConsumer(uint64_t now, uint64_t timeoutUs)
+{
+    std::unique_lock<std::mutex> lock(sendMutex);
+    return overflowed || (backloggedSince != 0 && now - backloggedSince >= timeoutUs);
+}
+
+size_t TCPConnection::GetQueuedBytes()
+{
+    std::unique_lock<std::mutex> lock(sendMutex);
+    return sendCount * sizeof(MessageBuffer);
+}
+
 void TCPConnection::tcpHandleReceive(const boost::system::error_code & error, std::size_t bytesTransferred)
 {
+    MINISERVER_TRACE_SPAN("TCP receive");
+    AllocationScope allocationScope(AllocationTag::TcpReceive);
     if (!error)
     {
-        assert(bytesTransferred == TCPMessageSize); // Check the message we just received is the right size
-        TCPMessage *recvdMsg = reinterpret_cast<TCPMessage*>(tcpRecvBuffer.c_array());
+        TCPMessage recvdMsg;
+        if (!WireDecode(tcpRecvBuffer.data(), bytesTransferred, recvdMsg))
+        {
+            std::cout << "Error: malformed TCP message, dropping connection" << std::endl;
+            socket.close(); // The stream can't be trusted to be in step any more
+            return;
+        }
+        if (recvdMsg.type == TCPMessageType::Pong)
+        {
+            // Stamp the arrival time here rather than in Tick, otherwise the time spent sat in the channel counts as rtt
+            recvdMsg.data.pingPongData.destinationTimestamp = MonotonicMicroseconds();
+        }
         // Send it down the message channel to be handled byt he main loop
-        tcpMessageChannel->Write(*recvdMsg);
+        QueuedTCPMessage queued = MakeQueuedTCPMessage(recvdMsg);
+        StampSender(queued, clientId.load(std::memory_order_relaxed));
+        tcpMessageChannel->Write(queued);
+#ifdef _DEBUG
         std::cout << "TCP Message received" << std::endl;
+#endif
     }
     else
     {
@@ -33,6 +114,7 @@ void TCPConnection::tcpHandleReceive(const boost::system::error_code & error, st
 #ifdef _DEBUG
         //abort();
 #endif
+        return; // Nothing more is coming (e.g. eof), and reading again would only fail again straight away
     }
     if (socket.is_open())
     {
@@ -42,12 +124,29 @@ void TCPConnection::tcpHandleReceive(const boost::system::error_code & error, st
 
 void TCPConnection::tcpHandleSend(const boost::system::error_code & error, std::size_t bytesTransferred)
 {
+    AllocationScope allocationScope(AllocationTag::TcpSend);
+    std::unique_lock<std::mutex> lock(sendMutex);
     if (!error)
     {
+#ifdef _DEBUG
         std::cout << "TCP Message sent! " << std::endl;
+#endif
+        sendHead = (sendHead + 1) % sendQueue.size();
+        sendCount--;
+        if (sendCount <= sendQueue.size() / 2)
+        {
+            backloggedSince = 0; // Caught up enough
+        }
+        if (sendCount > 0)
+        {
+            StartSend();
+            return;
+        }
     }
     else
     {
         std::cout << "Error: " << error.message() << std::endl;
+        // Leave whatever's queued where it is, the connection is going to be dropped anyway
     }
+    sending = false;
 }
@@ -0,0 +1,26 @@
+#include "ThreadAffinity.hpp"
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+bool PinThreadToCore(uint32_t core)
+{
+    if (core >= std::thread::hardware_concurrency())
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core) != 0;
+#elif defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,157 @@
+#include "Trace.hpp"
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<bool> Trace::enabled(false);
+
+namespace
+{
+    const size_t RingSize = 1 << 16; // Per thread, a power of two. 2MB each, plenty for a few seconds of a busy tick
+
+    struct ThreadTrace
+    {
+        uint32_t index;
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> written; // Events ever recorded, the last RingSize of them are still in events
+        TraceEvent events[RingSize];
+    };
+
+    std::mutex registryMutex;
+    std::vector<ThreadTrace*> registry; // Never freed, so a thread's events can still be written out after it's gone
+    thread_local ThreadTrace *threadTrace = nullptr;
+
+    // Where TraceNow was when tracing was last enabled, to turn ticks into microseconds when writing out
+    std::atomic<uint64_t> enabledTicks(0);
+    std::atomic<uint64_t> enabledNs(0);
+
+    uint64_t SteadyNs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    ThreadTrace &ThisThread()
+    {
+        if (threadTrace == nullptr)
+        {
+            // Once per thread, the first time it records anything
+            threadTrace = new ThreadTrace();
+            threadTrace->name.store(nullptr, std::memory_order_relaxed);
+            threadTrace->written.store(0, std::memory_order_relaxed);
+            std::unique_lock<std::mutex> lock(registryMutex);
+            threadTrace->index = static_cast<uint32_t>(registry.size());
+            registry.push_back(threadTrace);
+        }
+        return *threadTrace;
+    }
+
+    void WriteFlowId(std::ofstream &out, uint64_t id)
+    {
+        // As a string, JSON numbers lose anything past 53 bits
+        out << "\"id\":\"0x" << std::hex << id << std::dec << "\"";
+    }
+}
+
+void Trace::Enable(bool enable)
+{
+    if (enable)
+    {
+        enabledTicks.store(TraceNow(), std::memory_order_relaxed);
+        enabledNs.store(SteadyNs(), std::memory_order_relaxed);
+    }
+    enabled.store(enable, std::memory_order_release);
+}
+
+void Trace::SetThreadName(const char * name)
+{
+    ThisThread().name.store(name, std::memory_order_relaxed);
+}
+
+void Trace::Record(TracePhase phase, const char * name, uint64_t time, uint64_t arg)
+{
+    ThreadTrace &thread = ThisThread();
+    const uint64_t count = thread.written.load(std::memory_order_relaxed);
+    TraceEvent &event = thread.events[count & (RingSize - 1)];
+    event.time = time;
+    event.arg = arg;
+    event.name = name;
+    event.phase = phase;
+    thread.written.store(count + 1, std::memory_order_release);
+}
+
+bool Trace::WriteChromeJson(const std::string & path)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open())
+    {
+        return false;
+    }
+
+    // Ticks per microsecond, measured over however long tracing has been on (a moment at least)
+    const uint64_t startTicks = enabledTicks.load(std::memory_order_relaxed);
+    const uint64_t startNs = enabledNs.load(std::memory_order_relaxed);
+    if (SteadyNs() - startNs < 10000000)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const double ticksPerUs = static_cast<double>(TraceNow() - startTicks) * 1000.0 / static_cast<double>(SteadyNs() - startNs);
+
+    std::vector<ThreadTrace*> threads;
+    {
+        std::unique_lock<std::mutex> lock(registryMutex);
+        threads = registry;
+    }
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::fixed << std::setprecision(3);
+    bool first = true;
+    std::vector<TraceEvent> events;
+    for (ThreadTrace *thread : threads)
+    {
+        const char *name = thread->name.load(std::memory_order_relaxed);
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->index
+            << ",\"args\":{\"name\":\"" << (name != nullptr ? name : "Thread ") ;
+        if (name == nullptr)
+        {
+            out << thread->index;
+        }
+        out << "\"}}";
+        first = false;
+
+        // Copied while the thread may still be recording, then anything it could have written over meanwhile is
+        // thrown away, like a seqlock read
+        const uint64_t end = thread->written.load(std::memory_order_acquire);
+        const uint64_t begin = end > RingSize ? end - RingSize : 0;
+        events.clear();
+        for (uint64_t i = begin; i < end; i++)
+        {
+            events.push_back(thread->events[i & (RingSize - 1)]);
+        }
+        const uint64_t after = thread->written.load(std::memory_order_acquire);
+        const uint64_t firstIntact = after >= RingSize ? after - RingSize + 1 : 0;
+
+        for (uint64_t i = begin > firstIntact ? begin : firstIntact; i < end; i++)
+        {
+            const TraceEvent &event = events[i - begin];
+            const double ts = (static_cast<double>(event.time) - static_cast<double>(startTicks)) / ticksPerUs;
+            out << ",\n{\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << thread->index << ",\"ts\":" << ts;
+            switch (event.phase)
+            {
+            case TracePhase::Span:
+                out << ",\"ph\":\"X\",\"dur\":" << static_cast<double>(event.arg) / ticksPerUs;
+                break;
+            case TracePhase::FlowStart:
+            case TracePhase::FlowStep:
+            case TracePhase::FlowEnd:
+                out << ",\"ph\":\"" << (event.phase == TracePhase::FlowStart ? "s" : event.phase == TracePhase::FlowStep ? "t" : "f")
+                    << "\",\"cat\":\"flow\",\"bp\":\"e\",";
+                WriteFlowId(out, event.arg);
+                break;
+            }
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+    return out.good();
+}
@@ -0,0 +1,165 @@
+#include "TransformHistory.hpp"
+#include "GenericMemory.hpp"
+#include <cassert>
+#include <cmath>
+#include <memory>
+
+static const float DegreesToHalfRadians = 3.14159265358979f / 360.f;
+
+void TransformFrame::GetTransform(const uint8_t id, Transform & out) const
+{
+    Vector3 pos(posX[id], posY[id], posZ[id]);
+    Vector3 scale(scaleX[id], scaleY[id], scaleZ[id]);
+    out.SetPosition(pos);
+    out.SetScale(scale);
+
+    // Back to axis and angle, the angle between 0 and 360. No rotation comes back as Rotation's default
+    const float sinHalf = std::sqrt(rotX[id] * rotX[id] + rotY[id] * rotY[id] + rotZ[id] * rotZ[id]);
+    if (sinHalf > 1e-6f)
+    {
+        Vector3 axis(rotX[id] / sinHalf, rotY[id] / sinHalf, rotZ[id] / sinHalf);
+        out.SetRotation(Rotation(std::atan2(sinHalf, rotW[id]) / DegreesToHalfRadians, axis));
+    }
+    else
+    {
+        out.SetRotation(Rotation());
+    }
+}
+
+TransformHistory::TransformHistory(uint32_t InDepth, uint64_t InIntervalUs)
+    : interval(InIntervalUs)
+    , count(0)
+    , nextRecordTime(0)
+{
+    assert(InDepth >= 2 && interval > 0);
+    depth = 1;
+    while (depth < InDepth) depth <<= 1;
+    mask = depth - 1;
+
+    storage.resize(depth * sizeof(TransformFrame) + alignof(TransformFrame));
+    void *ptr = storage.data();
+    size_t space = storage.size();
+    frames = static_cast<TransformFrame*>(std::align(alignof(TransformFrame), depth * sizeof(TransformFrame), ptr, space));
+    assert(frames != nullptr);
+}
+
+void TransformHistory::Record(uint64_t now, uint64_t tick, const std::array<PlayerRecord, 16> &records, const std::array<bool, 16> &active)
+{
+    TransformFrame &frame = FrameAt(count);
+    frame.timestamp = now;
+    frame.tick = tick;
+    frame.activeMask = 0;
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        const Transform &transform = records[i].transform;
+        const Vector3 &pos = transform.GetPosition();
+        const Vector3 &scale = transform.GetScale();
+        const Rotation &rot = transform.GetRotation();
+        frame.posX[i] = pos.x;
+        frame.posY[i] = pos.y;
+        frame.posZ[i] = pos.z;
+        frame.scaleX[i] = scale.x;
+        frame.scaleY[i] = scale.y;
+        frame.scaleZ[i] = scale.z;
+        Vector3 axis = rot.axis;
+        const float axisLength = axis.magnitude(); // Clients don't have to send a unit axis, a zero one is no rotation
+        const float halfAngle = rot.deg * DegreesToHalfRadians;
+        const float sinScale = axisLength > 0.f ? std::sin(halfAngle) / axisLength : 0.f;
+        frame.rotX[i] = axis.x * sinScale;
+        frame.rotY[i] = axis.y * sinScale;
+        frame.rotZ[i] = axis.z * sinScale;
+        frame.rotW[i] = axisLength > 0.f ? std::cos(halfAngle) : 1.f;
+        if (active[i]) frame.activeMask |= static_cast<uint16_t>(1u << i);
+    }
+    count++;
+
+    // Stay on the cadence if we're only a little late, but don't try to catch up after a long stall
+    nextRecordTime += interval;
+    if (nextRecordTime <= now) nextRecordTime = now + interval;
+}
+
+static inline void LerpComponent(float *__restrict out, const float *__restrict a, const float *__restrict b, const float alpha)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        out[i] = a[i] + (b[i] - a[i]) * alpha;
+    }
+}
+
+// q and -q are the same rotation, so b is flipped onto a's side first for the blend to take the shorter arc,
+// then renormalised. That's nlerp, which is as good as slerp for frames a tick apart and stays straight-line loops
+static inline void NlerpRotations(TransformFrame &out, const TransformFrame &a, const TransformFrame &b, const float alpha)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        const float dot = a.rotX[i] * b.rotX[i] + a.rotY[i] * b.rotY[i] + a.rotZ[i] * b.rotZ[i] + a.rotW[i] * b.rotW[i];
+        const float sign = dot < 0.f ? -1.f : 1.f;
+        const float x = a.rotX[i] + (b.rotX[i] * sign - a.rotX[i]) * alpha;
+        const float y = a.rotY[i] + (b.rotY[i] * sign - a.rotY[i]) * alpha;
+        const float z = a.rotZ[i] + (b.rotZ[i] * sign - a.rotZ[i]) * alpha;
+        const float w = a.rotW[i] + (b.rotW[i] * sign - a.rotW[i]) * alpha;
+        const float scale = 1.f / std::sqrt(x * x + y * y + z * z + w * w); // At least 1/sqrt(2) long, after the flip
+        out.rotX[i] = x * scale;
+        out.rotY[i] = y * scale;
+        out.rotZ[i] = z * scale;
+        out.rotW[i] = w * scale;
+    }
+}
+
+bool TransformHistory::Sample(uint64_t time, TransformFrame & out) const
+{
+    if (count == 0)
+    {
+        return false;
+    }
+
+    const uint64_t newest = count - 1;
+    const uint64_t oldest = OldestIndex();
+    const TransformFrame &newestFrame = FrameAt(newest);
+    if (time >= newestFrame.timestamp)
+    {
+        out = newestFrame;
+        return true;
+    }
+    if (time < FrameAt(oldest).timestamp)
+    {
+        return false; // Further back than we keep
+    }
+
+    // Frames are (nearly) evenly spaced, so guess the frame at or before time directly and then nudge
+    // it to account for ticks that recorded a little late
+    uint64_t stepsBack = (newestFrame.timestamp - time + interval - 1) / interval;
+    uint64_t index = stepsBack > newest - oldest ? oldest : newest - stepsBack;
+    while (index > oldest && FrameAt(index).timestamp > time) index--;
+    while (index + 1 < newest && FrameAt(index + 1).timestamp <= time) index++;
+
+    const TransformFrame &a = FrameAt(index);
+    const TransformFrame &b = FrameAt(index + 1);
+    const uint64_t span = b.timestamp - a.timestamp;
+    const float alpha = span == 0 ? 0.f : static_cast<float>(time - a.timestamp) / static_cast<float>(span);
+
+    LerpComponent(out.posX, a.posX, b.posX, alpha);
+    LerpComponent(out.posY, a.posY, b.posY, alpha);
+    LerpComponent(out.posZ, a.posZ, b.posZ, alpha);
+    LerpComponent(out.scaleX, a.scaleX, b.scaleX, alpha);
+    LerpComponent(out.scaleY, a.scaleY, b.scaleY, alpha);
+    LerpComponent(out.scaleZ, a.scaleZ, b.scaleZ, alpha);
+    NlerpRotations(out, a, b, alpha);
+    out.timestamp = time;
+    out.tick = alpha < 0.5f ? a.tick : b.tick;
+
+    // Anyone who joined or left between the two frames has nothing sensible to blend with, so snap them to
+    // whichever frame is nearer in time
+    uint16_t changed = a.activeMask ^ b.activeMask;
+    const TransformFrame &nearest = alpha < 0.5f ? a : b;
+    out.activeMask = (a.activeMask & b.activeMask) | (changed & nearest.activeMask);
+    while (changed)
+    {
+        const uint32_t i = CountTrailingZeros(changed);
+        out.posX[i] = nearest.posX[i]; out.posY[i] = nearest.posY[i]; out.posZ[i] = nearest.posZ[i];
+        out.scaleX[i] = nearest.scaleX[i]; out.scaleY[i] = nearest.scaleY[i]; out.scaleZ[i] = nearest.scaleZ[i];
+        out.rotX[i] = nearest.rotX[i]; out.rotY[i] = nearest.rotY[i]; out.rotZ[i] = nearest.rotZ[i]; out.rotW[i] = nearest.rotW[i];
+        changed &= changed - 1;
+    }
+    return true;
+}
@@ -0,0 +1,15 @@
+#include "UDPReceivePool.hpp"
+
+UDPReceivePool::UDPReceivePool(uint16_t ShardCount)
+{
+    ShardCount = ShardCount < 1 ? 1 : (ShardCount > MaxShards ? MaxShards : ShardCount);
+    slabs.resize(static_cast<size_t>(ShardCount) * SlabCount);
+    for (uint16_t shard = 0; shard < ShardCount; shard++)
+    {
+        shards.push_back(std::unique_ptr<Shard>(new Shard()));
+        for (uint16_t slot = 0; slot < SlabCount; slot++)
+        {
+            shards.back()->freeSlabs.TryPush(static_cast<uint16_t>(shard * SlabCount + slot));
+        }
+    }
+}
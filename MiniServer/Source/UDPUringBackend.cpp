@@ -0,0 +1,134 @@
+#include "UDPUringBackend.hpp"
+#ifdef MINISERVER_IO_URING
+#include <vector>
+#include <unistd.h>
+
+UDPUringBackend::UDPUringBackend()
+    : socketFd(-1)
+    , receivePool(nullptr)
+    , registeredBuffers(0)
+    , receiveArmed(false)
+    , datagramsReceived(0)
+    , datagramsSent(0)
+    , receiveErrors(0)
+    , sendErrors(0)
+{
+    memset(&receiveHeader, 0, sizeof(receiveHeader));
+    receiveHeader.msg_namelen = NameLength;
+}
+
+UDPUringBackend::~UDPUringBackend()
+{
+    ring.Close();
+    if (socketFd >= 0)
+    {
+        close(socketFd);
+    }
+}
+
+bool UDPUringBackend::Open(uint16_t port, UDPReceivePool & InReceivePool, UDPSendBufferPool & sendPool)
+{
+    receivePool = &InReceivePool;
+    socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socketFd < 0)
+    {
+        return false;
+    }
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        return false;
+    }
+
+    // Plenty of completion slots for every slab to come back at once, plus the sends
+    if (!ring.Init(256, UDPReceivePool::SlabCount * 2) || !ring.SetupBufferRing(BufferGroup, UDPReceivePool::SlabCount))
+    {
+        return false;
+    }
+
+    std::vector<iovec> buffers(sendPool.GetCount());
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        buffers[i].iov_base = sendPool.Get(i)->data.data();
+        buffers[i].iov_len = sendPool.Get(i)->data.size();
+    }
+    if (ring.RegisterBuffers(buffers.data(), static_cast<unsigned>(buffers.size())))
+    {
+        registeredBuffers = static_cast<uint32_t>(buffers.size());
+    }
+
+    ProvideFreeSlabs();
+    ArmReceive();
+    Submit();
+    return true;
+}
+
+void UDPUringBackend::Send(UDPSendBuffer * buffer, const boost::asio::ip::udp::endpoint & to)
+{
+    io_uring_sqe *sqe = ring.GetSqe();
+    if (sqe == nullptr)
+    {
+        Submit(); // Full, which only happens on a tick with a lot going out
+        sqe = ring.GetSqe();
+    }
+    sqe->opcode = IORING_OP_SEND_ZC;
+    sqe->fd = socketFd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer->data.data());
+    sqe->len = static_cast<uint32_t>(buffer->size);
+    sqe->addr2 = reinterpret_cast<uint64_t>(to.data());
+    sqe->addr_len = static_cast<uint16_t>(to.size());
+    if (buffer->index < registeredBuffers)
+    {
+        sqe->ioprio |= IORING_RECVSEND_FIXED_BUF;
+        sqe->buf_index = static_cast<uint16_t>(buffer->index);
+    }
+    sqe->user_data = reinterpret_cast<uint64_t>(buffer);
+    datagramsSent++;
+}
+
+void UDPUringBackend::Submit()
+{
+    if (ring.Submit() < 0)
+    {
+        sendErrors++;
+    }
+}
+
+void UDPUringBackend::ProvideFreeSlabs()
+{
+    // In this mode the tick thread is both ends of the pool's free ring
+    uint16_t slab;
+    bool added = false;
+    while (receivePool->Acquire(0, slab))
+    {
+        ring.AddBuffer(receivePool->GetWithHeadroom(slab) + HeaderOffset, static_cast<uint32_t>(UDPReceivePool::SlabHeadroom - HeaderOffset + sizeof(UDPMessage)), slab);
+        added = true;
+    }
+    if (added)
+    {
+        ring.CommitBuffers();
+    }
+}
+
+void UDPUringBackend::ArmReceive()
+{
+    io_uring_sqe *sqe = ring.GetSqe();
+    if (sqe == nullptr)
+    {
+        return; // Try again next tick
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = socketFd;
+    sqe->addr = reinterpret_cast<uint64_t>(&receiveHeader);
+    sqe->len = 1;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BufferGroup;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = ReceiveTag;
+    receiveArmed = true;
+}
+#endif
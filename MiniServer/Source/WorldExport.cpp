@@ -0,0 +1,127 @@
+#include "WorldExport.hpp"
+#include <new>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Both ends read and write the header's atomics from different processes
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "The world export needs lock free atomics");
+
+WorldExportWriter::WorldExportWriter()
+    : region(nullptr)
+{
+}
+
+WorldExportWriter::~WorldExportWriter()
+{
+    Close();
+}
+
+bool WorldExportWriter::Open(const std::string & InName)
+{
+    Close();
+#ifdef __linux__
+    shm_unlink(InName.c_str()); // Left behind by a server that crashed
+    const int fd = shm_open(InName.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    void *memory = MAP_FAILED;
+    if (ftruncate(fd, sizeof(WorldExportRegion)) == 0)
+    {
+        memory = mmap(nullptr, sizeof(WorldExportRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        shm_unlink(InName.c_str());
+        return false;
+    }
+    name = InName;
+    region = new (memory) WorldExportRegion();
+    region->version = WorldExportRegion::CurrentVersion;
+    region->regionSize = sizeof(WorldExportRegion);
+    region->playerCount = WorldExportFrame::PlayerCount;
+    region->live.store(1, std::memory_order_relaxed);
+    region->magic.store(WorldExportRegion::Magic, std::memory_order_release);
+    return true;
+#else
+    (void)InName;
+    return false;
+#endif
+}
+
+void WorldExportWriter::Close()
+{
+#ifdef __linux__
+    if (region == nullptr)
+    {
+        return;
+    }
+    region->live.store(0, std::memory_order_release);
+    munmap(region, sizeof(WorldExportRegion));
+    shm_unlink(name.c_str()); // Readers keep what they've mapped until they close it
+    region = nullptr;
+#endif
+}
+
+WorldExportReader::WorldExportReader()
+    : region(nullptr)
+{
+}
+
+WorldExportReader::~WorldExportReader()
+{
+    Close();
+}
+
+bool WorldExportReader::Open(const std::string & name)
+{
+    Close();
+#ifdef __linux__
+    const int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    void *memory = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size == static_cast<off_t>(sizeof(WorldExportRegion)))
+    {
+        memory = mmap(nullptr, sizeof(WorldExportRegion), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        return false;
+    }
+    const WorldExportRegion *mapped = static_cast<const WorldExportRegion*>(memory);
+    if (mapped->magic.load(std::memory_order_acquire) != WorldExportRegion::Magic
+        || mapped->version != WorldExportRegion::CurrentVersion
+        || mapped->regionSize != sizeof(WorldExportRegion))
+    {
+        munmap(memory, sizeof(WorldExportRegion)); // Not set up yet, or not a layout we know
+        return false;
+    }
+    region = mapped;
+    return true;
+#else
+    (void)name;
+    return false;
+#endif
+}
+
+void WorldExportReader::Close()
+{
+#ifdef __linux__
+    if (region != nullptr)
+    {
+        munmap(const_cast<WorldExportRegion*>(region), sizeof(WorldExportRegion));
+        region = nullptr;
+    }
+#endif
+}
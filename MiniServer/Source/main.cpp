@@ -1,15 +1,124 @@
 #include <iostream>
+#include <string>
+#include <csignal>
 #include "Server.hpp"
+#include "RoomHost.hpp"
 
 using pThread = UniquePtr<std::thread>;
 
-int main()
+// Usage: MiniServer [--record <capture file>] [--replay <capture file>] [--rooms <count>] [--export-world <shm name>] [--spectators <port>] [--spectator-delay <ms>]
+//                   [--trace <json file>]
+// --rooms runs that many rooms with a lobby on 4443 instead of a single server, see RoomHost.hpp
+// --export-world publishes each tick's players for local processes to read, see WorldExport.hpp
+// --spectators serves snapshots read only on that port, for viewers and MiniServerRelay, see SpectatorRelay.hpp
+// --trace records spans and flows from the start, written out as Chrome trace JSON on SIGUSR1 (or when a replay
+// finishes), see Trace.hpp
+static volatile std::sig_atomic_t traceRequested = 0;
+
+static void RequestTrace(int)
+{
+    traceRequested = 1; // Written out by the main loop, nothing much is safe in a signal handler
+}
+
+static void WriteTraceIfRequested(const std::string &tracePath)
 {
+    if (traceRequested != 0)
+    {
+        traceRequested = 0;
+        std::cout << (Trace::WriteChromeJson(tracePath) ? "Trace written to " : "Error: couldn't write trace to ") << tracePath << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ServerConfig config;
+    std::string replayPath;
+    std::string tracePath;
+    uint32_t roomCount = 0;
+    for (int i = 1; i < argc - 1; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--record")
+        {
+            config.capturePath = argv[++i];
+        }
+        else if (arg == "--replay")
+        {
+            replayPath = argv[++i];
+        }
+        else if (arg == "--rooms")
+        {
+            roomCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--export-world")
+        {
+            config.worldExportName = argv[++i];
+        }
+        else if (arg == "--trace")
+        {
+            tracePath = argv[++i];
+        }
+        else if (arg == "--spectators")
+        {
+            config.spectatorPort = static_cast<uint16_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--spectator-delay")
+        {
+            config.spectatorDelayMs = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+    }
+
+    if (!tracePath.empty())
+    {
+        Trace::Enable(true);
+#ifdef SIGUSR1
+        std::signal(SIGUSR1, RequestTrace);
+#endif
+    }
+    Trace::SetThreadName("Tick");
+
+    if (roomCount > 0)
+    {
+        RoomHostConfig hostConfig;
+        hostConfig.roomCount = roomCount;
+        hostConfig.roomConfig = config;
+        RoomHost host(hostConfig);
+        host.Start();
+        while (true)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            WriteTraceIfRequested(tracePath);
+        }
+    }
+
     boost::asio::io_service io_service; // Odd design choice to declare io_service here, but it works
-    pServer server = MakeUnique<Server>(io_service);
+
+    if (!replayPath.empty())
+    {
+        // No sockets, just push the capture through Tick as fast as possible and report how long it took
+        CaptureReader reader;
+        if (!reader.Open(replayPath))
+        {
+            return 1;
+        }
+        config.offline = true;
+        pServer server = MakeUnique<Server>(io_service, config);
+        uint64_t start = MonotonicMicroseconds();
+        uint64_t replayed;
+        const bool replayedAll = server->Replay(reader, replayed);
+        uint64_t elapsed = MonotonicMicroseconds() - start;
+        std::cout << "Replayed " << replayed << " records in " << elapsed << "us ("
+            << (elapsed > 0 ? replayed * 1000000 / elapsed : 0) << " records/s)" << std::endl;
+        traceRequested = tracePath.empty() ? 0 : 1;
+        WriteTraceIfRequested(tracePath);
+        return replayedAll ? 0 : 1;
+    }
+
+    pServer server = MakeUnique<Server>(io_service, config);
     while (true)
     {
         server->Tick();
+        WriteTraceIfRequested(tracePath);
         //boost::asio::deadline_timer t(io_service, boost::posix_time::millisec(50)); // There has to be a better way to do this
     }
     return 0;
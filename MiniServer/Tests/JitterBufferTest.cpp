@@ -0,0 +1,167 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include "JitterBuffer.hpp"
+
+// Plays a client's stream of updates through a simulated network into a JitterBuffer and checks what comes out:
+// every release in sequence order, nothing released twice, nothing made up, and each update released within a
+// bounded time of being sent. Seeded, so a failure always fails the same way.
+// Usage: JitterBufferTest (exits non-zero if any scenario fails)
+
+struct Update
+{
+    uint16_t sequence;
+    uint64_t sentAt;
+};
+
+struct Network
+{
+    uint32_t lossPercent;
+    uint32_t duplicatePercent;
+    uint64_t baseDelayUs;
+    uint64_t jitterUs; // Each copy is delayed by baseDelayUs plus up to this much, which is what reorders them
+};
+
+struct Scenario
+{
+    const char *name;
+    Network network;
+    uint16_t targetDepth;
+    uint16_t firstSequence;
+    uint32_t updates;
+    bool expectNoLoss;
+};
+
+static const uint64_t IntervalUs = 16000; // One update a tick from the client, played out at the same rate
+static const uint64_t StepUs = 1000; // How often the simulated server ticks
+
+struct InFlight
+{
+    uint64_t arrival;
+    Update update;
+};
+
+static bool Check(bool condition, const char *scenario, const char *what)
+{
+    if (!condition)
+    {
+        std::cout << scenario << ": " << what << std::endl;
+    }
+    return condition;
+}
+
+static bool Run(const Scenario &scenario)
+{
+    std::mt19937 random(12345); // Raw output only, the distributions aren't the same everywhere
+    auto percent = [&random]() { return static_cast<uint32_t>(random() % 100); };
+    auto upTo = [&random](uint64_t limit) { return limit > 0 ? static_cast<uint64_t>(random()) % (limit + 1) : 0; };
+
+    std::vector<InFlight> inFlight;
+    uint32_t duplicated = 0;
+    for (uint32_t i = 0; i < scenario.updates; i++)
+    {
+        const Update update = { static_cast<uint16_t>(scenario.firstSequence + i), i * IntervalUs };
+        if (i > 0 && percent() < scenario.network.lossPercent) // The first one starts the stream, keep it simple
+        {
+            continue;
+        }
+        inFlight.push_back({ update.sentAt + scenario.network.baseDelayUs + upTo(scenario.network.jitterUs), update });
+        if (percent() < scenario.network.duplicatePercent)
+        {
+            inFlight.push_back({ update.sentAt + scenario.network.baseDelayUs + upTo(scenario.network.jitterUs), update });
+            duplicated++;
+        }
+    }
+    std::stable_sort(inFlight.begin(), inFlight.end(), [](const InFlight &a, const InFlight &b) { return a.arrival < b.arrival; });
+
+    JitterBuffer<Update> buffer;
+    buffer.Configure(scenario.targetDepth, IntervalUs);
+    std::vector<bool> releasedAlready(scenario.updates, false);
+    uint32_t releasedCount = 0;
+    bool inOrder = true;
+    bool noRepeats = true;
+    bool allReal = true;
+    bool firstRelease = true;
+    uint16_t lastReleased = 0;
+    uint64_t worstLatency = 0;
+
+    // Whatever is still playing out once everything has arrived, then a little more
+    const uint64_t end = inFlight.back().arrival + (scenario.targetDepth * 2 + 2) * IntervalUs;
+    size_t next = 0;
+    for (uint64_t now = 0; now <= end; now += StepUs)
+    {
+        for (; next < inFlight.size() && inFlight[next].arrival <= now; next++)
+        {
+            buffer.Insert(inFlight[next].update.sequence, inFlight[next].update);
+        }
+        buffer.Release(now, [&](const Update &update)
+        {
+            const uint16_t index = static_cast<uint16_t>(update.sequence - scenario.firstSequence);
+            if (index >= scenario.updates)
+            {
+                allReal = false;
+                return;
+            }
+            if (!firstRelease && !SequenceGreaterThan(update.sequence, lastReleased))
+            {
+                inOrder = false;
+            }
+            if (releasedAlready[index])
+            {
+                noRepeats = false;
+            }
+            releasedAlready[index] = true;
+            releasedCount++;
+            firstRelease = false;
+            lastReleased = update.sequence;
+            worstLatency = std::max(worstLatency, now - update.sentAt);
+        });
+    }
+
+    // The buffer holds at most twice targetDepth before it catches up, so nothing should wait longer than the
+    // network's worst plus that many intervals, plus the tick it was due in
+    const uint64_t latencyBound = scenario.network.baseDelayUs + scenario.network.jitterUs
+        + (scenario.targetDepth * 2u + 1u) * IntervalUs + StepUs;
+
+    bool passed = true;
+    passed &= Check(allReal, scenario.name, "released a sequence that was never sent");
+    passed &= Check(inOrder, scenario.name, "released out of sequence order");
+    passed &= Check(noRepeats, scenario.name, "released the same sequence twice");
+    passed &= Check(worstLatency <= latencyBound, scenario.name, "an update waited longer than the latency bound");
+    passed &= Check(buffer.GetReleasedCount() == releasedCount, scenario.name, "released count doesn't match what came out");
+    passed &= Check(releasedCount + buffer.GetLostCount() + buffer.GetDepth() <= scenario.updates, scenario.name,
+        "accounted for more updates than were sent");
+    passed &= Check(buffer.GetDuplicateCount() + buffer.GetLateCount() >= duplicated, scenario.name, "let a duplicate through");
+    if (scenario.expectNoLoss)
+    {
+        passed &= Check(releasedCount + buffer.GetDepth() == scenario.updates && buffer.GetLostCount() == 0, scenario.name,
+            "lost updates the network delivered in time");
+        passed &= Check(buffer.GetUnderrunCount() <= 1, scenario.name, "ran dry before the stream ended"); // The once at the end
+    }
+
+    std::cout << scenario.name << ": " << releasedCount << " released, " << buffer.GetLostCount() << " lost, "
+        << buffer.GetLateCount() << " late, " << buffer.GetDuplicateCount() << " duplicates, " << buffer.GetUnderrunCount()
+        << " underruns, worst latency " << worstLatency << "us (bound " << latencyBound << "us)" << (passed ? "" : " FAILED") << std::endl;
+    return passed;
+}
+
+int main()
+{
+    const Scenario scenarios[] =
+    {
+        // name, { loss %, duplicate %, base delay, jitter }, target depth, first sequence, updates, expect no loss
+        { "clean", { 0, 0, 20000, 0 }, 2, 0, 2000, true },
+        { "jitter within the buffer", { 0, 0, 20000, 30000 }, 3, 100, 2000, true },
+        { "duplicates and reordering", { 0, 20, 20000, 30000 }, 3, 65000, 2000, true }, // Wraps the sequence too
+        { "loss", { 10, 0, 20000, 30000 }, 3, 0, 2000, false },
+        { "loss, duplicates and jitter past the buffer", { 5, 10, 20000, 80000 }, 2, 65500, 5000, false }
+    };
+
+    bool passed = true;
+    for (const Scenario &scenario : scenarios)
+    {
+        passed &= Run(scenario);
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#include <iostream>
+#include <cmath>
+#include "TransformHistory.hpp"
+
+// Records two frames a tick apart and checks what a rewind between them gives back, mostly for rotations:
+// they have to blend the shorter way round and come out as a proper axis and angle.
+// Usage: TransformHistoryTest (exits non-zero if any case fails)
+
+static const uint64_t IntervalUs = 16000;
+
+struct Case
+{
+    const char *name;
+    Rotation from;
+    Rotation to;
+    float alpha; // How far between the two frames to sample
+    Rotation expected;
+};
+
+// Whether two axis and angle rotations are the same orientation, which they are if their quaternions are equal
+// or opposite
+static bool SameRotation(const Rotation &a, const Rotation &b)
+{
+    const float halfA = a.deg * 3.14159265358979f / 360.f;
+    const float halfB = b.deg * 3.14159265358979f / 360.f;
+    Vector3 axisA = a.axis;
+    Vector3 axisB = b.axis;
+    axisA.normalise();
+    axisB.normalise();
+    const float dot = std::sin(halfA) * std::sin(halfB) * axisA.dot(axisB) + std::cos(halfA) * std::cos(halfB);
+    return std::fabs(dot) > 0.9999f;
+}
+
+static bool Run(const Case &test)
+{
+    TransformHistory history(4, IntervalUs);
+    std::array<PlayerRecord, 16> records;
+    std::array<bool, 16> active;
+    active.fill(false);
+    active[0] = true;
+    records[0].transform.SetPosition(Vector3(0.f, 0.f, 0.f));
+    records[0].transform.SetScale(Vector3(1.f, 1.f, 1.f));
+    records[0].transform.SetRotation(test.from);
+    history.Record(IntervalUs, 1, records, active);
+    records[0].transform.SetPosition(Vector3(10.f, 0.f, 0.f));
+    records[0].transform.SetRotation(test.to);
+    history.Record(2 * IntervalUs, 2, records, active);
+
+    TransformFrame frame;
+    Transform sampled;
+    const bool found = history.Sample(IntervalUs + static_cast<uint64_t>(test.alpha * IntervalUs), frame);
+    frame.GetTransform(0, sampled);
+    Rotation rotation = sampled.GetRotation();
+
+    const bool unitAxis = rotation.deg == 0.f || std::fabs(rotation.axis.magnitude() - 1.f) < 1e-4f;
+    const bool inRange = rotation.deg >= 0.f && rotation.deg <= 360.f;
+    const bool passed = found && unitAxis && inRange && SameRotation(rotation, test.expected)
+        && std::fabs(sampled.GetPosition().x - 10.f * test.alpha) < 1e-3f;
+    std::cout << test.name << ": " << rotation.deg << " degrees about (" << rotation.axis.x << ", " << rotation.axis.y
+        << ", " << rotation.axis.z << ")" << (passed ? "" : " FAILED") << std::endl;
+    return passed;
+}
+
+int main()
+{
+    const Vector3 x(1.f, 0.f, 0.f);
+    const Vector3 y(0.f, 1.f, 0.f);
+    const Vector3 z(0.f, 0.f, 1.f);
+    const float blendedAngle = 2.f * std::acos(std::sqrt(2.f / 3.f)) * 180.f / 3.14159265358979f; // Halfway from 90 about x to 90 about z
+    const Case cases[] =
+    {
+        // name, from, to, alpha, expected
+        { "recorded frame", Rotation(350.f, y), Rotation(350.f, y), 1.f, Rotation(350.f, y) },
+        { "same axis", Rotation(0.f, y), Rotation(90.f, y), 0.5f, Rotation(45.f, y) },
+        { "across 0", Rotation(350.f, y), Rotation(10.f, y), 0.5f, Rotation(0.f, y) },
+        { "across 0, a quarter of the way", Rotation(350.f, y), Rotation(10.f, y), 0.25f, Rotation(355.f, y) },
+        { "negative angle", Rotation(-10.f, y), Rotation(10.f, y), 0.75f, Rotation(5.f, y) },
+        { "unnormalised axis", Rotation(0.f, y), Rotation(90.f, Vector3(0.f, 5.f, 0.f)), 0.5f, Rotation(45.f, y) },
+        { "different axes", Rotation(90.f, x), Rotation(90.f, z), 0.5f, Rotation(blendedAngle, Vector3(1.f, 0.f, 1.f)) }
+    };
+
+    bool passed = true;
+    for (const Case &test : cases)
+    {
+        passed &= Run(test);
+    }
+    return passed ? 0 : 1;
+}